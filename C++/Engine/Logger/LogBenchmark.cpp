@@ -0,0 +1,578 @@
+#include "Engine/Logger/LogBenchmark.hpp"
+#include "Engine/Logger/Logger.hpp"
+#include "Engine/Logger/LogBinary.hpp"
+#include "Engine/Logger/LogFileSink.hpp"
+
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Engine/Core/EngineCommon.h"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/Time.hpp"
+#include "Engine/FileSystem/FileUtils.hpp"
+
+#include "Engine/Async/Threading.hpp"
+
+#include "Engine/Commands/Command.hpp"
+#include "Engine/Commands/DevConsole.hpp"
+extern DevConsole* g_theDevConsole;
+
+
+
+//-------------------------------------------------------------------------------------------------------
+// Counts of values in buckets ~6% wide, adding is a few shifts so it can sit on the logger thread
+//	Values under 32 get a bucket each, past that every power of two is split into 16
+class LogBenchmarkHistogram
+{
+public:
+	void Add(uint64_t value)
+	{
+		uint64_t scaled = value;
+		uint32_t shift = 0;
+		while (scaled >= 32)
+		{
+			scaled >>= 1;
+			++shift;
+		}
+
+		++m_counts[shift * 16 + scaled];
+		++m_numValues;
+		m_maxValue = (value > m_maxValue) ? value : m_maxValue;
+	}
+
+	void Merge(const LogBenchmarkHistogram& other)
+	{
+		for (int i = 0; i < NUM_BUCKETS; ++i)
+		{
+			m_counts[i] += other.m_counts[i];
+		}
+		m_numValues += other.m_numValues;
+		m_maxValue = (other.m_maxValue > m_maxValue) ? other.m_maxValue : m_maxValue;
+	}
+
+	// The top of the bucket the percentile falls in
+	uint64_t GetPercentile(double percentile) const
+	{
+		uint64_t rank = (uint64_t)(percentile / 100.0 * (double)m_numValues + 0.5);
+		rank = (rank == 0) ? 1 : rank;
+
+		uint64_t numSeen = 0;
+		for (int i = 0; i < NUM_BUCKETS; ++i)
+		{
+			numSeen += m_counts[i];
+			if (numSeen >= rank)
+			{
+				uint64_t bucketMax = GetBucketMax(i);
+				return (bucketMax < m_maxValue) ? bucketMax : m_maxValue;
+			}
+		}
+
+		return m_maxValue;
+	}
+
+	uint64_t	GetNumValues() const	{ return m_numValues; }
+	uint64_t	GetMaxValue() const		{ return m_maxValue; }
+
+private:
+	static uint64_t GetBucketMax(int bucket)
+	{
+		if (bucket < 32)
+		{
+			return (uint64_t)bucket;
+		}
+
+		uint32_t shift = (uint32_t)(bucket - 16) / 16;
+		uint64_t scaled = (uint64_t)bucket - shift * 16;
+		return ((scaled + 1) << shift) - 1;
+	}
+
+	static const int	NUM_BUCKETS = 61 * 16;		// Enough for any 64 bit value
+
+	uint64_t			m_counts[NUM_BUCKETS] = {};
+	uint64_t			m_numValues = 0;
+	uint64_t			m_maxValue = 0;
+};
+
+
+enum eLogBenchmarkSink
+{
+	LOG_BENCHMARK_SINK_NONE = 0,
+	LOG_BENCHMARK_SINK_TEXT_FILE,
+	LOG_BENCHMARK_SINK_BINARY_FILE,
+	LOG_BENCHMARK_SINK_QUEUED_HOOK,
+
+	LOG_BENCHMARK_SINK_COUNT
+};
+
+
+// Only touched by the hook while it's hooked
+struct LogBenchmarkSink
+{
+	eLogBenchmarkSink		m_type = LOG_BENCHMARK_SINK_NONE;
+	LogFileSink				m_fileSink;
+	LogBinaryWriter			m_binaryWriter;
+
+	LogBenchmarkHistogram	m_latencyHPC;
+	uint64_t				m_numLines = 0;
+	uint64_t				m_numBytes = 0;
+};
+
+
+struct LogBenchmarkThread
+{
+	ThreadHandle					m_handle = nullptr;
+	uint32_t						m_threadNumber = 0;
+	uint64_t						m_numLines = 0;
+	const char*						m_tag = nullptr;
+	const std::vector<std::string>*	m_lines = nullptr;
+
+	uint64_t						m_finishHPC = 0;
+	LogBenchmarkHistogram			m_callHPC;			// Every LOG_BENCHMARK_CALL_SAMPLE_RATE'th call
+};
+
+
+struct LogBenchmarkPercentiles
+{
+	bool	m_hasValues = false;
+	double	m_p50 = 0.0;
+	double	m_p90 = 0.0;
+	double	m_p99 = 0.0;
+	double	m_p999 = 0.0;
+	double	m_max = 0.0;
+};
+
+
+struct LogBenchmarkResult
+{
+	const char*					m_sinkName = "";
+	bool						m_isFiltered = false;
+	int							m_numThreads = 0;
+
+	uint64_t					m_numCalls = 0;
+	uint64_t					m_numDelivered = 0;
+	uint64_t					m_numDropped = 0;
+	uint64_t					m_numBytes = 0;
+	uint64_t					m_numWriteErrors = 0;	// File sinks only
+	uint64_t					m_numLostBytes = 0;
+	double						m_loggedSeconds = 0.0;	// Until every thread had logged
+	double						m_writtenSeconds = 0.0;	// Until the sink had it all, and had handed it to the OS
+
+	double						m_producerNsPerCall = 0.0;
+	LogBenchmarkPercentiles		m_producerCallNs;
+	LogBenchmarkPercentiles		m_latencyNs;
+};
+
+
+
+// Runs
+constexpr int							LOG_BENCHMARK_NUM_LINES				= 256;		// Power of two, replayed by every thread
+constexpr uint64_t						LOG_BENCHMARK_CALL_SAMPLE_RATE		= 64;		// Power of two, timing every call would time the clock instead
+static const char*						LOG_BENCHMARK_SHOWN_TAG				= "BENCHMARK";
+static const char*						LOG_BENCHMARK_HIDDEN_TAG			= "BENCHMARK_HIDDEN";
+static const char*						s_sinkNames[LOG_BENCHMARK_SINK_COUNT] = {"none", "text_file", "binary_file", "queued_hook"};
+
+// State
+static std::atomic<bool>				s_isBenchmarkRunning(false);
+static std::atomic<int>					s_numBenchmarkThreadsReady(0);
+static std::atomic<bool>				s_hasBenchmarkRunStarted(false);
+
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBenchmark_Sink_Hook(const Log_LogEntry& entry, void* userData)
+{
+	LogBenchmarkSink* sink = (LogBenchmarkSink*)userData;
+
+	if (sink->m_type == LOG_BENCHMARK_SINK_TEXT_FILE)
+	{
+		sink->m_fileSink.Write(entry.m_tag, entry.m_text);
+	}
+	else if (sink->m_type == LOG_BENCHMARK_SINK_BINARY_FILE)
+	{
+		sink->m_binaryWriter.Write(entry);
+	}
+
+	uint64_t nowHPC = GetCurrentTimeInHPC();
+	sink->m_latencyHPC.Add((nowHPC > entry.m_timeHPC) ? nowHPC - entry.m_timeHPC : 0);
+	sink->m_numLines += 1;
+	sink->m_numBytes += entry.m_tag.size() + 2 + entry.m_text.size() + 1;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBenchmark_ThreadFunction(void* data)
+{
+	LogBenchmarkThread* thread = (LogBenchmarkThread*)data;
+	const std::vector<std::string>& lines = *thread->m_lines;
+
+	// Everyone starts together
+	s_numBenchmarkThreadsReady.fetch_add(1);
+	while (!s_hasBenchmarkRunStarted.load())
+	{
+		std::this_thread::yield();
+	}
+
+	for (uint64_t lineNumber = 0; lineNumber < thread->m_numLines; ++lineNumber)
+	{
+		const char* text = lines[(lineNumber + thread->m_threadNumber) & (LOG_BENCHMARK_NUM_LINES - 1)].c_str();
+
+		if ((lineNumber & (LOG_BENCHMARK_CALL_SAMPLE_RATE - 1)) == 0)
+		{
+			uint64_t callStartHPC = GetCurrentTimeInHPC();
+			LogTagged(thread->m_tag, "[%u:%llu] %s", thread->m_threadNumber, (unsigned long long)lineNumber, text);
+			thread->m_callHPC.Add(GetCurrentTimeInHPC() - callStartHPC);
+		}
+		else
+		{
+			LogTagged(thread->m_tag, "[%u:%llu] %s", thread->m_threadNumber, (unsigned long long)lineNumber, text);
+		}
+	}
+
+	thread->m_finishHPC = GetCurrentTimeInHPC();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// Made up but the same every time so runs compare, 24 to 223 characters
+void LogBenchmark_MakeLines(std::vector<std::string>& outLines)
+{
+	outLines.resize(LOG_BENCHMARK_NUM_LINES);
+
+	for (int i = 0; i < LOG_BENCHMARK_NUM_LINES; ++i)
+	{
+		size_t length = 24 + (size_t)((i * 37) % 200);
+		outLines[i].resize(length);
+
+		for (size_t j = 0; j < length; ++j)
+		{
+			outLines[i][j] = ((j + i) % 7 == 6) ? ' ' : (char)('a' + (i * 7 + j * 3) % 26);
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+LogBenchmarkPercentiles LogBenchmark_GetPercentilesNs(const LogBenchmarkHistogram& histogram)
+{
+	LogBenchmarkPercentiles percentiles;
+	if (histogram.GetNumValues() == 0)
+	{
+		return percentiles;
+	}
+
+	percentiles.m_hasValues = true;
+	percentiles.m_p50 = ConvertHPCtoSeconds(histogram.GetPercentile(50.0)) * 1.0e9;
+	percentiles.m_p90 = ConvertHPCtoSeconds(histogram.GetPercentile(90.0)) * 1.0e9;
+	percentiles.m_p99 = ConvertHPCtoSeconds(histogram.GetPercentile(99.0)) * 1.0e9;
+	percentiles.m_p999 = ConvertHPCtoSeconds(histogram.GetPercentile(99.9)) * 1.0e9;
+	percentiles.m_max = ConvertHPCtoSeconds(histogram.GetMaxValue()) * 1.0e9;
+	return percentiles;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// "Log/Benchmark/benchmark.json" keeps its sinks' files in "Log/Benchmark/benchmark.txt" and ".binlog", not timestamped
+std::string LogBenchmark_GetSinkFilepath(const LogBenchmarkOptions& options)
+{
+	const std::string& outputFilepath = options.m_outputFilepath;
+
+	size_t extensionStart = outputFilepath.find_last_of('.');
+	size_t filenameStart = outputFilepath.find_last_of("/\\");
+	if (extensionStart == std::string::npos || (filenameStart != std::string::npos && extensionStart < filenameStart))
+	{
+		return outputFilepath;
+	}
+
+	return outputFilepath.substr(0, extensionStart);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// Started over every run so the files stay one run long
+bool LogBenchmark_OpenSink(LogBenchmarkSink& sink, const std::string& sinkFilepath)
+{
+	if (sink.m_type == LOG_BENCHMARK_SINK_TEXT_FILE)
+	{
+		std::vector<std::string> filepaths;
+		filepaths.push_back(sinkFilepath + ".txt");
+
+		sink.m_fileSink.SetRotation(0, 0.0, 0);
+		return sink.m_fileSink.Open(filepaths);
+	}
+	else if (sink.m_type == LOG_BENCHMARK_SINK_BINARY_FILE)
+	{
+		// Converted through a big count, one tick on its own rounds badly
+		const uint64_t TICKS_FOR_RATE = 1000000000ULL;
+		double secondsPerTick = ConvertHPCtoSeconds(TICKS_FOR_RATE) / (double)TICKS_FOR_RATE;
+		return sink.m_binaryWriter.Open(sinkFilepath + ".binlog", secondsPerTick, GetCurrentTimeInHPC());
+	}
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogBenchmark_Run(eLogBenchmarkSink sinkType, bool isFiltered, int numThreads, const LogBenchmarkOptions& options, const std::vector<std::string>& lines, LogBenchmarkResult& outResult)
+{
+	// On the heap, the histogram is big
+	LogBenchmarkSink* sinkStorage = new LogBenchmarkSink();
+	LogBenchmarkSink& sink = *sinkStorage;
+	sink.m_type = sinkType;
+	if (!LogBenchmark_OpenSink(sink, LogBenchmark_GetSinkFilepath(options)))
+	{
+		delete sinkStorage;
+		return false;
+	}
+
+	LogBenchmarkResult& result = outResult;
+	result.m_sinkName = s_sinkNames[sink.m_type];
+	result.m_isFiltered = isFiltered;
+	result.m_numThreads = numThreads;
+
+	// Only the benchmark's lines, and only to it, the game's own hooks keep everything else
+	eLogHookPolicy policy = (sink.m_type == LOG_BENCHMARK_SINK_QUEUED_HOOK) ? LOG_HOOK_POLICY_BLOCK : LOG_HOOK_POLICY_INLINE;
+	if (!Log_HookTag(LOG_BENCHMARK_SHOWN_TAG, LogBenchmark_Sink_Hook, (void*)&sink, policy))
+	{
+		delete sinkStorage;
+		return false;
+	}
+
+	// Threads are started and waiting before the clock starts
+	uint64_t linesPerThread = options.m_linesPerRun / (uint64_t)numThreads;
+	linesPerThread = (linesPerThread == 0) ? 1 : linesPerThread;
+
+	std::vector<LogBenchmarkThread> threads(numThreads);
+	s_numBenchmarkThreadsReady.store(0);
+	s_hasBenchmarkRunStarted.store(false);
+	for (int i = 0; i < numThreads; ++i)
+	{
+		threads[i].m_threadNumber = (uint32_t)i;
+		threads[i].m_numLines = linesPerThread;
+		threads[i].m_tag = isFiltered ? LOG_BENCHMARK_HIDDEN_TAG : LOG_BENCHMARK_SHOWN_TAG;
+		threads[i].m_lines = &lines;
+		threads[i].m_handle = Thread_Create(LogBenchmark_ThreadFunction, (void*)&threads[i]);
+	}
+	while (s_numBenchmarkThreadsReady.load() < numThreads)
+	{
+		std::this_thread::yield();
+	}
+
+	uint64_t numDroppedBefore = Log_GetNumDroppedLines();
+	uint64_t startHPC = GetCurrentTimeInHPC();
+	s_hasBenchmarkRunStarted.store(true);
+
+	uint64_t finishHPC = startHPC;
+	uint64_t threadsHPC = 0;
+	LogBenchmarkHistogram callHPC;
+	for (int i = 0; i < numThreads; ++i)
+	{
+		Thread_Join(threads[i].m_handle);
+		finishHPC = (threads[i].m_finishHPC > finishHPC) ? threads[i].m_finishHPC : finishHPC;
+		threadsHPC += threads[i].m_finishHPC - startHPC;
+		callHPC.Merge(threads[i].m_callHPC);
+	}
+
+	// Unhooked before its files are flushed, the logger thread is done with it once it's off the list
+	Log_Flush();
+	Log_Unhook(LogBenchmark_Sink_Hook, (void*)&sink);
+	sink.m_fileSink.Flush();
+	sink.m_binaryWriter.Flush();
+	uint64_t writtenHPC = GetCurrentTimeInHPC();
+
+	result.m_numCalls = linesPerThread * (uint64_t)numThreads;
+	result.m_numDelivered = sink.m_numLines;
+	result.m_numDropped = Log_GetNumDroppedLines() - numDroppedBefore;
+	result.m_numBytes = sink.m_numBytes;
+	result.m_numWriteErrors = sink.m_fileSink.GetNumWriteErrors() + sink.m_binaryWriter.GetNumWriteErrors();
+	result.m_numLostBytes = sink.m_fileSink.GetNumLostBytes() + sink.m_binaryWriter.GetNumLostBytes();
+	result.m_loggedSeconds = ConvertHPCtoSeconds(finishHPC - startHPC);
+	result.m_writtenSeconds = ConvertHPCtoSeconds(writtenHPC - startHPC);
+	result.m_producerNsPerCall = (ConvertHPCtoSeconds(threadsHPC) * 1.0e9) / (double)result.m_numCalls;
+	result.m_producerCallNs = LogBenchmark_GetPercentilesNs(callHPC);
+	result.m_latencyNs = LogBenchmark_GetPercentilesNs(sink.m_latencyHPC);
+
+	sink.m_fileSink.Close();
+	sink.m_binaryWriter.Close();
+	delete sinkStorage;
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBenchmark_WritePercentiles(FILE* file, const char* name, const LogBenchmarkPercentiles& percentiles)
+{
+	if (!percentiles.m_hasValues)
+	{
+		fprintf(file, "\"%s\": null", name);
+		return;
+	}
+
+	fprintf(file, "\"%s\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p99_9\": %.1f, \"max\": %.1f}",
+		name, percentiles.m_p50, percentiles.m_p90, percentiles.m_p99, percentiles.m_p999, percentiles.m_max);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogBenchmark_WriteResults(const std::string& filepath, const LogBenchmarkOptions& options, const std::vector<LogBenchmarkResult>& results)
+{
+	FILE* file = fopen(filepath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+#if defined( _WIN32 )
+	const char* platformName = "windows";
+#elif defined( __APPLE__ )
+	const char* platformName = "macos";
+#else
+	const char* platformName = "linux";
+#endif
+#if defined( _DEBUG )
+	const char* configurationName = "debug";
+#else
+	const char* configurationName = "release";
+#endif
+	const char* policyNames[LOG_OVERFLOW_POLICY_COUNT] = {"block", "drop_newest", "drop_oldest"};
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"version\": 1,\n");
+	fprintf(file, "\t\"platform\": \"%s\",\n", platformName);
+	fprintf(file, "\t\"configuration\": \"%s\",\n", configurationName);
+	fprintf(file, "\t\"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+	fprintf(file, "\t\"overflow_policy\": \"%s\",\n", policyNames[Log_GetOverflowPolicy()]);
+	fprintf(file, "\t\"lines_per_run\": %llu,\n", (unsigned long long)options.m_linesPerRun);
+	fprintf(file, "\t\"call_sample_rate\": %llu,\n", (unsigned long long)LOG_BENCHMARK_CALL_SAMPLE_RATE);
+	fprintf(file, "\t\"runs\": [\n");
+
+	for (int i = 0; i < (int)results.size(); ++i)
+	{
+		const LogBenchmarkResult& result = results[i];
+		double linesPerSecond = (double)result.m_numCalls / result.m_loggedSeconds;
+		double writtenLinesPerSecond = (double)result.m_numDelivered / result.m_writtenSeconds;
+		double writtenBytesPerSecond = (double)result.m_numBytes / result.m_writtenSeconds;
+
+		fprintf(file, "\t\t{\"sink\": \"%s\", \"tag\": \"%s\", \"threads\": %d, ", result.m_sinkName, result.m_isFiltered ? "hidden" : "shown", result.m_numThreads);
+		fprintf(file, "\"calls\": %llu, \"delivered\": %llu, \"dropped\": %llu, \"bytes\": %llu, ",
+			(unsigned long long)result.m_numCalls, (unsigned long long)result.m_numDelivered, (unsigned long long)result.m_numDropped, (unsigned long long)result.m_numBytes);
+		fprintf(file, "\"write_errors\": %llu, \"lost_bytes\": %llu, ", (unsigned long long)result.m_numWriteErrors, (unsigned long long)result.m_numLostBytes);
+		fprintf(file, "\"logged_seconds\": %.6f, \"written_seconds\": %.6f, ", result.m_loggedSeconds, result.m_writtenSeconds);
+		fprintf(file, "\"logged_lines_per_second\": %.0f, \"written_lines_per_second\": %.0f, \"written_bytes_per_second\": %.0f, ",
+			linesPerSecond, writtenLinesPerSecond, writtenBytesPerSecond);
+		fprintf(file, "\"producer_ns_per_call\": %.1f, ", result.m_producerNsPerCall);
+		LogBenchmark_WritePercentiles(file, "producer_call_ns", result.m_producerCallNs);
+		fprintf(file, ", ");
+		LogBenchmark_WritePercentiles(file, "latency_ns", result.m_latencyNs);
+		fprintf(file, "}%s\n", (i + 1 < (int)results.size()) ? "," : "");
+	}
+
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+
+	bool wasWritten = (ferror(file) == 0);
+	wasWritten = (fclose(file) == 0) && wasWritten;
+	return wasWritten;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool Log_Benchmark(const LogBenchmarkOptions& options)
+{
+	bool isRunning = false;
+	if (!s_isBenchmarkRunning.compare_exchange_strong(isRunning, true))
+	{
+		return false;
+	}
+
+	std::string outputFilepath = AppendTimestamp(options.m_outputFilepath);
+	if (!GetFolderPath(outputFilepath).empty() && !DoesFolderExist(GetFolderPath(outputFilepath)))
+	{
+		CreateFolder(GetFolderPath(outputFilepath));
+	}
+
+	// The benchmark's tags are shown and hidden whatever the filter says, and put back after
+	bool wasShownTagShown = Log_IsTagShown(LOG_BENCHMARK_SHOWN_TAG);
+	bool wasHiddenTagShown = Log_IsTagShown(LOG_BENCHMARK_HIDDEN_TAG);
+	Log_ShowTag(LOG_BENCHMARK_SHOWN_TAG);
+	Log_HideTag(LOG_BENCHMARK_HIDDEN_TAG);
+
+	std::vector<std::string> lines;
+	LogBenchmark_MakeLines(lines);
+
+	std::vector<LogBenchmarkResult> results;
+	int maxThreads = (options.m_maxThreads > 0) ? options.m_maxThreads : 1;
+	for (int sinkType = 0; sinkType < LOG_BENCHMARK_SINK_COUNT; ++sinkType)
+	{
+		for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+		{
+			// Hidden lines never reach a sink, once is enough
+			LogBenchmarkResult result;
+			if (sinkType == LOG_BENCHMARK_SINK_NONE && LogBenchmark_Run((eLogBenchmarkSink)sinkType, true, numThreads, options, lines, result))
+			{
+				results.push_back(result);
+			}
+			if (LogBenchmark_Run((eLogBenchmarkSink)sinkType, false, numThreads, options, lines, result))
+			{
+				results.push_back(result);
+			}
+		}
+	}
+
+	wasShownTagShown ? Log_ShowTag(LOG_BENCHMARK_SHOWN_TAG) : Log_HideTag(LOG_BENCHMARK_SHOWN_TAG);
+	wasHiddenTagShown ? Log_ShowTag(LOG_BENCHMARK_HIDDEN_TAG) : Log_HideTag(LOG_BENCHMARK_HIDDEN_TAG);
+
+	bool wasWritten = LogBenchmark_WriteResults(outputFilepath, options, results);
+	if (wasWritten)
+	{
+		LogTagged("LOG_BENCHMARK", "%d runs written to %s", (int)results.size(), outputFilepath.c_str());
+	}
+	else
+	{
+		LogTagged("LOG_BENCHMARK", "Couldn't write %s", outputFilepath.c_str());
+	}
+
+	s_isBenchmarkRunning.store(false);
+	return wasWritten;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool Log_IsBenchmarkRunning()
+{
+	return s_isBenchmarkRunning.load();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBenchmark_ThreadEntry(void* data)
+{
+	LogBenchmarkOptions* options = (LogBenchmarkOptions*)data;
+
+	Log_Benchmark(*options);
+
+	delete options;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void Log_Benchmark_Command(Command& cmd)
+{
+	std::string maxThreads = cmd.GetNextString();
+	std::string linesPerRun = cmd.GetNextString();
+
+	LogBenchmarkOptions* options = new LogBenchmarkOptions();
+	options->m_maxThreads = maxThreads.empty() ? options->m_maxThreads : StringToInt(maxThreads.c_str());
+	options->m_linesPerRun = linesPerRun.empty() ? options->m_linesPerRun : (uint64_t)StringToInt(linesPerRun.c_str());
+
+	if (Log_IsBenchmarkRunning() || options->m_maxThreads <= 0 || options->m_linesPerRun == 0)
+	{
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), Log_IsBenchmarkRunning() ? "A benchmark is already running" : "Usage: Log_Benchmark [maxThreads] [linesPerRun]");
+		delete options;
+		return;
+	}
+
+	// Off the console's thread, the runs take a while
+	Thread_CreateAndDetach(LogBenchmark_ThreadEntry, (void*)options);
+}
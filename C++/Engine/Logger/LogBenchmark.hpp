@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class Command;
+
+
+
+// Throughput and latency of the logger, written out as JSON so runs can be compared between builds
+//	Every run logs a fixed number of lines split between 1, 2, 4 ... up to the max threads, through one sink at a time:
+//		none			An inline hook that only counts, the queue and the logger thread on their own
+//		text_file		A LogFileSink, like log.txt
+//		binary_file		A LogBinaryWriter, like Log_OpenBinaryFile
+//		queued_hook		A hook on its own thread (LOG_HOOK_POLICY_BLOCK) that only counts
+//	and once more per thread count with the tag hidden, which is only the cost of the filter on the calling thread
+//
+//	Each run reports
+//		Producer		Mean ns per call from the calling threads' loops, and percentiles from timing every 64th call
+//		Latency			From the log call to the sink getting the line, percentiles ~6% wide
+//		Throughput		Lines and bytes ("TAG: text\n") per second, once every thread has logged and again once the sink has it all
+//		Write errors	Failed writes and the bytes they lost, for the file sinks
+//
+//	Its sinks only get the benchmark's tag (see Log_HookTag) and log.txt never does, the game keeps logging to its own hooks meanwhile
+//	and shares the queue with it, so dropped lines are the whole logger's
+
+
+
+struct LogBenchmarkOptions
+{
+	std::string		m_outputFilepath	= "Log/Benchmark/benchmark.json";	// Timestamped, the sinks write next to it ("benchmark.txt", "benchmark.binlog") starting over every run
+	int				m_maxThreads		= 64;
+	uint64_t		m_linesPerRun		= 200000;
+};
+
+
+
+// Blocks until every run is done, not from a hook
+//	False if it couldn't start (one is already running) or the results couldn't be written
+bool Log_Benchmark(const LogBenchmarkOptions& options = LogBenchmarkOptions());
+bool Log_IsBenchmarkRunning();
+
+// Log_Benchmark [maxThreads] [linesPerRun], runs on its own thread and logs where the results went
+void Log_Benchmark_Command(Command& cmd);
@@ -0,0 +1,576 @@
+#include "Engine/Logger/LogBinary.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <string.h>
+#include <algorithm>
+
+#include "Engine/Logger/LogFormat.hpp"
+
+
+
+static const char		LOG_BINARY_MAGIC[8]		= {'L', 'O', 'G', 'B', 'I', 'N', '\0', '\0'};
+static const uint32_t	LOG_BINARY_VERSION		= 1;
+static const size_t		LOG_BINARY_BUFFER_SIZE	= 64 * 1024;		// Written out once it's this full
+static const uint8_t	LOG_BINARY_ARGUMENT_FLOAT = 16;				// A double that survives the trip through a float, most of them started as one
+
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBinary_AppendVarint(std::vector<uint8_t>& bytes, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		bytes.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	bytes.push_back((uint8_t)value);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogBinary_ReadVarint(const uint8_t*& cursor, const uint8_t* end, uint64_t& outValue)
+{
+	outValue = 0;
+	for (int shift = 0; shift < 64 && cursor < end; shift += 7)
+	{
+		uint8_t byte = *cursor++;
+		outValue |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// Captured arguments are fixed size for speed on the calling thread, the file gets varints and floats instead
+void LogBinary_PackArguments(const std::string& arguments, std::vector<uint8_t>& outPacked)
+{
+	outPacked.clear();
+
+	const char* cursor = arguments.data();
+	const char* end = cursor + arguments.size();
+	while (cursor < end)
+	{
+		uint8_t type = (uint8_t)*cursor++;
+		if (type == LOG_ARGUMENT_STRING)
+		{
+			uint32_t length = 0;
+			memcpy(&length, cursor, sizeof(length));
+			cursor += sizeof(length);
+
+			outPacked.push_back(type);
+			LogBinary_AppendVarint(outPacked, length);
+			outPacked.insert(outPacked.end(), (const uint8_t*)cursor, (const uint8_t*)cursor + length);
+			cursor += length;
+			continue;
+		}
+
+		uint64_t bits = 0;
+		memcpy(&bits, cursor, sizeof(bits));
+		cursor += sizeof(bits);
+
+		if (type == LOG_ARGUMENT_DOUBLE)
+		{
+			double value;
+			memcpy(&value, &bits, sizeof(value));
+			float asFloat = (float)value;
+			if ((double)asFloat == value)
+			{
+				outPacked.push_back(LOG_BINARY_ARGUMENT_FLOAT);
+				outPacked.insert(outPacked.end(), (const uint8_t*)&asFloat, (const uint8_t*)&asFloat + sizeof(asFloat));
+			}
+			else
+			{
+				outPacked.push_back(type);
+				outPacked.insert(outPacked.end(), (const uint8_t*)&bits, (const uint8_t*)&bits + sizeof(bits));
+			}
+		}
+		else if (type == LOG_ARGUMENT_INT)
+		{
+			outPacked.push_back(type);
+			LogBinary_AppendVarint(outPacked, (bits << 1) ^ (uint64_t)((int64_t)bits >> 63));
+		}
+		else
+		{
+			outPacked.push_back(type);
+			LogBinary_AppendVarint(outPacked, bits);
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogBinary_UnpackArguments(const std::string& packed, std::string& outArguments)
+{
+	outArguments.clear();
+
+	const uint8_t* cursor = (const uint8_t*)packed.data();
+	const uint8_t* end = cursor + packed.size();
+	while (cursor < end)
+	{
+		uint8_t type = *cursor++;
+		uint64_t value = 0;
+
+		if (type == LOG_ARGUMENT_STRING)
+		{
+			if (!LogBinary_ReadVarint(cursor, end, value) || value > (uint64_t)(end - cursor))
+			{
+				return false;
+			}
+
+			uint32_t length = (uint32_t)value;
+			outArguments.push_back((char)type);
+			outArguments.append((const char*)&length, sizeof(length));
+			outArguments.append((const char*)cursor, length);
+			cursor += length;
+			continue;
+		}
+
+		if (type == LOG_BINARY_ARGUMENT_FLOAT)
+		{
+			float asFloat;
+			if ((size_t)(end - cursor) < sizeof(asFloat))
+			{
+				return false;
+			}
+			memcpy(&asFloat, cursor, sizeof(asFloat));
+			cursor += sizeof(asFloat);
+
+			double asDouble = (double)asFloat;
+			memcpy(&value, &asDouble, sizeof(value));
+			type = LOG_ARGUMENT_DOUBLE;
+		}
+		else if (type == LOG_ARGUMENT_DOUBLE)
+		{
+			if ((size_t)(end - cursor) < sizeof(value))
+			{
+				return false;
+			}
+			memcpy(&value, cursor, sizeof(value));
+			cursor += sizeof(value);
+		}
+		else if (!LogBinary_ReadVarint(cursor, end, value))
+		{
+			return false;
+		}
+		else if (type == LOG_ARGUMENT_INT)
+		{
+			value = (value >> 1) ^ (uint64_t)-(int64_t)(value & 1);
+		}
+
+		outArguments.push_back((char)type);
+		outArguments.append((const char*)&value, sizeof(value));
+	}
+
+	return true;
+}
+
+
+
+//-------------------------------------------------------------------------------------------------------
+LogBinaryWriter::~LogBinaryWriter()
+{
+	Close();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogBinaryWriter::Open(const std::string& filepath, double secondsPerTick, uint64_t startTick)
+{
+	if (m_file != nullptr)
+	{
+		return false;
+	}
+
+	m_file = fopen(filepath.c_str(), "wb");
+	if (m_file == nullptr)
+	{
+		return false;
+	}
+
+	// Already buffered here, unbuffered fwrites say exactly how much reached the OS
+	setvbuf(m_file, nullptr, _IONBF, 0);
+
+	m_filepath = filepath;
+	m_buffer.clear();
+	m_buffer.reserve(LOG_BINARY_BUFFER_SIZE * 2);
+	m_previousTick = startTick;
+	m_isTagWritten.assign(LOG_MAX_TAGS, false);
+	m_overflowTagIDs.clear();
+	m_formatIDs.clear();
+
+	uint32_t unused = 0;
+	WriteBytes(LOG_BINARY_MAGIC, sizeof(LOG_BINARY_MAGIC));
+	WriteBytes(&LOG_BINARY_VERSION, sizeof(LOG_BINARY_VERSION));
+	WriteBytes(&unused, sizeof(unused));
+	WriteBytes(&secondsPerTick, sizeof(secondsPerTick));
+	WriteBytes(&startTick, sizeof(startTick));
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBinaryWriter::Close()
+{
+	if (m_file == nullptr)
+	{
+		return;
+	}
+
+	Flush();
+	fclose(m_file);
+	m_file = nullptr;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBinaryWriter::Write(const Log_LogEntry& entry)
+{
+	if (m_file == nullptr)
+	{
+		return;
+	}
+
+	uint32_t tagID = GetTagID(entry);
+	uint32_t formatID = (entry.m_format != nullptr) ? GetFormatID(entry.m_format) + 1 : 0;
+
+	// Lines come out in queue order, which isn't quite time order across threads
+	int64_t tickDelta = (int64_t)(entry.m_timeHPC - m_previousTick);
+	m_previousTick = entry.m_timeHPC;
+
+	m_buffer.push_back('L');
+	WriteVarint(((uint64_t)tickDelta << 1) ^ (uint64_t)(tickDelta >> 63));
+	WriteVarint(entry.m_threadID);
+	WriteVarint(tagID);
+	WriteVarint(formatID);
+	if (entry.m_format != nullptr)
+	{
+		LogBinary_PackArguments(entry.m_arguments, m_packedArguments);
+		WriteVarint(m_packedArguments.size());
+		WriteBytes(m_packedArguments.data(), m_packedArguments.size());
+	}
+	else
+	{
+		WriteVarint(entry.m_text.size());
+		WriteBytes(entry.m_text.data(), entry.m_text.size());
+	}
+
+	if (m_buffer.size() >= LOG_BINARY_BUFFER_SIZE)
+	{
+		WriteOut();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBinaryWriter::Flush()
+{
+	if (m_file == nullptr)
+	{
+		return;
+	}
+
+	if (!m_buffer.empty())
+	{
+		WriteOut();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBinaryWriter::Sync()
+{
+	if (m_file == nullptr)
+	{
+		return;
+	}
+
+	Flush();
+#ifdef _WIN32
+	_commit(_fileno(m_file));
+#else
+	fsync(fileno(m_file));
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBinaryWriter::WriteOut()
+{
+	// Not kept to try again, the records after a gap can't be decoded either way
+	size_t numWritten = fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+	if (numWritten != m_buffer.size())
+	{
+		m_numWriteErrors.fetch_add(1, std::memory_order_relaxed);
+		m_numLostBytes.fetch_add(m_buffer.size() - numWritten, std::memory_order_relaxed);
+		clearerr(m_file);
+	}
+	m_buffer.clear();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBinaryWriter::WriteVarint(uint64_t value)
+{
+	LogBinary_AppendVarint(m_buffer, value);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBinaryWriter::WriteBytes(const void* bytes, size_t numBytes)
+{
+	const uint8_t* byteData = (const uint8_t*)bytes;
+	m_buffer.insert(m_buffer.end(), byteData, byteData + numBytes);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+uint32_t LogBinaryWriter::GetTagID(const Log_LogEntry& entry)
+{
+	uint32_t tagID = entry.m_tagID;
+	bool isNew = false;
+
+	if (entry.m_tagID != LOG_OVERFLOW_TAG_ID)
+	{
+		isNew = !m_isTagWritten[tagID];
+		m_isTagWritten[tagID] = true;
+	}
+	else
+	{
+		// Overflow tags all share one LogTagID, they're told apart by name
+		auto found = m_overflowTagIDs.find(entry.m_tag);
+		if (found != m_overflowTagIDs.end())
+		{
+			tagID = found->second;
+		}
+		else
+		{
+			tagID = LOG_MAX_TAGS + (uint32_t)m_overflowTagIDs.size();
+			m_overflowTagIDs.emplace(entry.m_tag, tagID);
+			isNew = true;
+		}
+	}
+
+	if (isNew)
+	{
+		m_buffer.push_back('T');
+		WriteVarint(tagID);
+		WriteVarint(entry.m_tag.size());
+		WriteBytes(entry.m_tag.data(), entry.m_tag.size());
+	}
+
+	return tagID;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+uint32_t LogBinaryWriter::GetFormatID(const char* format)
+{
+	auto found = m_formatIDs.find(format);
+	if (found != m_formatIDs.end())
+	{
+		return found->second;
+	}
+
+	uint32_t formatID = (uint32_t)m_formatIDs.size();
+	m_formatIDs.emplace(format, formatID);
+
+	size_t formatLength = strlen(format);
+	m_buffer.push_back('F');
+	WriteVarint(formatID);
+	WriteVarint(formatLength);
+	WriteBytes(format, formatLength);
+
+	return formatID;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+LogBinaryReader::~LogBinaryReader()
+{
+	Close();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogBinaryReader::Open(const std::string& filepath)
+{
+	Close();
+
+	m_file = fopen(filepath.c_str(), "rb");
+	if (m_file == nullptr)
+	{
+		return false;
+	}
+
+	char magic[8];
+	uint32_t version = 0;
+	uint32_t unused = 0;
+	bool isValid = fread(magic, sizeof(magic), 1, m_file) == 1
+		&& fread(&version, sizeof(version), 1, m_file) == 1
+		&& fread(&unused, sizeof(unused), 1, m_file) == 1
+		&& fread(&m_secondsPerTick, sizeof(m_secondsPerTick), 1, m_file) == 1
+		&& fread(&m_startTick, sizeof(m_startTick), 1, m_file) == 1
+		&& memcmp(magic, LOG_BINARY_MAGIC, sizeof(magic)) == 0
+		&& version == LOG_BINARY_VERSION;
+
+	if (!isValid)
+	{
+		Close();
+		return false;
+	}
+
+	m_previousTick = m_startTick;
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogBinaryReader::Close()
+{
+	if (m_file != nullptr)
+	{
+		fclose(m_file);
+		m_file = nullptr;
+	}
+
+	m_tags.clear();
+	m_formats.clear();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogBinaryReader::ReadNext(Log_LogEntry& outEntry)
+{
+	if (m_file == nullptr)
+	{
+		return false;
+	}
+
+	int kind;
+	while ((kind = fgetc(m_file)) != EOF)
+	{
+		uint64_t id = 0;
+		if (kind == 'T')
+		{
+			// Interned tags come in any order below LOG_MAX_TAGS, overflow tags one after another above it
+			//	Anything further out is a damaged file, not a reason to allocate
+			std::string tag;
+			if (!ReadVarint(id) || !ReadString(tag) || id > std::max(m_tags.size(), (size_t)LOG_MAX_TAGS))
+			{
+				return false;
+			}
+
+			if (id >= m_tags.size())
+			{
+				m_tags.resize((size_t)id + 1);
+			}
+			m_tags[(size_t)id] = tag;
+		}
+		else if (kind == 'F')
+		{
+			std::string format;
+			if (!ReadVarint(id) || !ReadString(format) || id != m_formats.size())
+			{
+				return false;
+			}
+
+			m_formats.push_back(format);
+		}
+		else if (kind == 'L')
+		{
+			uint64_t zigzagDelta, threadID, tagID, formatID;
+			if (!ReadVarint(zigzagDelta) || !ReadVarint(threadID) || !ReadVarint(tagID) || !ReadVarint(formatID)
+				|| tagID >= m_tags.size() || formatID > m_formats.size())
+			{
+				return false;
+			}
+
+			std::string& payload = (formatID != 0) ? m_packedArguments : outEntry.m_text;
+			if (!ReadString(payload) || (formatID != 0 && !LogBinary_UnpackArguments(m_packedArguments, outEntry.m_arguments)))
+			{
+				return false;
+			}
+
+			int64_t tickDelta = (int64_t)(zigzagDelta >> 1) ^ -(int64_t)(zigzagDelta & 1);
+			m_previousTick += (uint64_t)tickDelta;
+
+			outEntry.m_tag = m_tags[(size_t)tagID];
+			outEntry.m_timeHPC = m_previousTick;
+			outEntry.m_threadID = (uint32_t)threadID;
+			outEntry.m_tagID = (LogTagID)tagID;
+			if (formatID != 0)
+			{
+				outEntry.m_format = m_formats[(size_t)formatID - 1].c_str();
+				FormatCapturedArguments(outEntry.m_format, outEntry.m_arguments.data(), outEntry.m_arguments.size(), outEntry.m_text);
+			}
+			else
+			{
+				outEntry.m_format = nullptr;
+				outEntry.m_arguments.clear();
+			}
+
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+double LogBinaryReader::GetSecondsSinceOpen(uint64_t timeHPC) const
+{
+	return (double)(int64_t)(timeHPC - m_startTick) * m_secondsPerTick;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogBinaryReader::ReadVarint(uint64_t& outValue)
+{
+	outValue = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int byte = fgetc(m_file);
+		if (byte == EOF)
+		{
+			return false;
+		}
+
+		outValue |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogBinaryReader::ReadString(std::string& outString)
+{
+	uint64_t length = 0;
+	if (!ReadVarint(length) || length > (1ULL << 30))
+	{
+		return false;
+	}
+
+	outString.resize((size_t)length);
+	return length == 0 || fread(&outString[0], 1, (size_t)length, m_file) == (size_t)length;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdio.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Engine/Logger/Logger.hpp"
+
+
+
+// Compact log records, written by the logger's binary file hook and read back by Tools/LogDecoder
+//	Only needs the standard library (and LogFormat.cpp) so the decoder builds without the engine
+//
+//	Header		"LOGBIN\0\0", uint32 version, uint32 unused, double seconds per tick, uint64 tick the file was opened on
+//	Records		A kind byte followed by varints
+//		'T'		Tag ID, name length, name
+//		'F'		Format ID, length, format
+//		'L'		Zigzag tick delta from the previous line, thread ID, tag ID, format ID + 1 (0 for plain text), payload length, payload
+//				The payload is the text, or for deferred lines their captured arguments repacked smaller
+//				(integers as varints, doubles that are really floats as 4 bytes)
+//	Tags and formats are written the first time a line uses them
+//	A write that fails loses what was buffered, the decoder stops at the gap
+
+
+
+//-------------------------------------------------------------------------------------------------------
+class LogBinaryWriter
+{
+public:
+	LogBinaryWriter() {};
+	~LogBinaryWriter();
+
+	bool				Open(const std::string& filepath, double secondsPerTick, uint64_t startTick);
+	void				Close();
+	bool				IsOpen() const { return m_file != nullptr; }
+	const std::string&	GetFilepath() const { return m_filepath; }
+
+	void				Write(const Log_LogEntry& entry);
+	void				Flush(); // Hands everything buffered to the OS
+	void				Sync();  // Flush, then waits for the disk
+
+	// Any thread
+	uint64_t			GetNumWriteErrors() const	{ return m_numWriteErrors.load(std::memory_order_relaxed); }
+	uint64_t			GetNumLostBytes() const		{ return m_numLostBytes.load(std::memory_order_relaxed); }
+
+private:
+	void				WriteOut();
+	void				WriteVarint(uint64_t value);
+	void				WriteBytes(const void* bytes, size_t numBytes);
+	uint32_t			GetTagID(const Log_LogEntry& entry);
+	uint32_t			GetFormatID(const char* format);
+
+	FILE*										m_file = nullptr;
+	std::string									m_filepath;
+	std::vector<uint8_t>						m_buffer;
+	std::vector<uint8_t>						m_packedArguments;
+	uint64_t									m_previousTick = 0;
+	std::atomic<uint64_t>						m_numWriteErrors{0};
+	std::atomic<uint64_t>						m_numLostBytes{0};
+
+	std::vector<bool>							m_isTagWritten;			// By LogTagID
+	std::unordered_map<std::string, uint32_t>	m_overflowTagIDs;		// Tags past LOG_MAX_TAGS get IDs after it
+	std::unordered_map<const char*, uint32_t>	m_formatIDs;			// Formats are string literals, their address is enough
+
+	// No copying, the file would be closed twice
+	LogBinaryWriter(const LogBinaryWriter&) = delete;
+	LogBinaryWriter& operator=(const LogBinaryWriter&) = delete;
+};
+
+
+
+//-------------------------------------------------------------------------------------------------------
+class LogBinaryReader
+{
+public:
+	LogBinaryReader() {};
+	~LogBinaryReader();
+
+	bool				Open(const std::string& filepath); // False if it isn't a binary log
+	void				Close();
+
+	// False at the end of the file, or where a crash cut it short
+	//	Deferred lines are formatted into m_text, m_format stays valid until the reader is closed
+	bool				ReadNext(Log_LogEntry& outEntry);
+	double				GetSecondsSinceOpen(uint64_t timeHPC) const;
+
+private:
+	bool				ReadVarint(uint64_t& outValue);
+	bool				ReadString(std::string& outString);
+
+	FILE*						m_file = nullptr;
+	double						m_secondsPerTick = 0.0;
+	uint64_t					m_startTick = 0;
+	uint64_t					m_previousTick = 0;
+
+	std::string					m_packedArguments;
+	std::vector<std::string>	m_tags;
+	std::deque<std::string>		m_formats;		// Deque so the c_str()s never move
+
+	// No copying, the file would be closed twice
+	LogBinaryReader(const LogBinaryReader&) = delete;
+	LogBinaryReader& operator=(const LogBinaryReader&) = delete;
+};
@@ -0,0 +1,709 @@
+#include "Engine/Logger/LogFileSink.hpp"
+
+//#define LOG_FILES_USE_ZSTD	// Compresses rotated segments, needs zstd.h and libzstd
+
+#ifdef _WIN32
+#define PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined( LOG_FILES_USE_ZSTD )
+#include <zstd.h>
+#endif
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+
+
+static const size_t		LOG_FILE_BUFFER_CAPACITY	= 256 * 1024;	// Written out once full, and whenever the logger goes idle
+static const size_t		LOG_FILE_BLOCK_SIZE			= 4096;			// Direct IO alignment, a multiple of every common sector size
+static const int		LOG_FILE_MAX_WRITE_ATTEMPTS	= 10;			// Before buffered lines that won't write are given up on, the logger retries every 10 ms
+#if defined( LOG_FILES_USE_ZSTD )
+static const int		LOG_FILE_ZSTD_LEVEL			= 3;			// Fast, and still shrinks text logs several times over
+#endif
+
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogFileSink_RenameFile(const std::string& filepath, const std::string& newFilepath)
+{
+#if defined( PLATFORM_WINDOWS )
+	return MoveFileExA(filepath.c_str(), newFilepath.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(filepath.c_str(), newFilepath.c_str()) == 0;
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// The N of every "<filepath>.<N>" and "<filepath>.<N>.zst" next to it, from this run or earlier ones
+std::vector<int> LogFileSink_FindSegmentNumbers(const std::string& filepath)
+{
+	size_t lastSlash = filepath.find_last_of("/\\");
+	std::string folderPath = (lastSlash != std::string::npos) ? filepath.substr(0, lastSlash) : ".";
+	std::string segmentPrefix = ((lastSlash != std::string::npos) ? filepath.substr(lastSlash + 1) : filepath) + ".";
+
+	std::vector<std::string> filenames;
+#if defined( PLATFORM_WINDOWS )
+	WIN32_FIND_DATAA findData;
+	HANDLE findHandle = FindFirstFileA((folderPath + "\\" + segmentPrefix + "*").c_str(), &findData);
+	if (findHandle != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			filenames.push_back(findData.cFileName);
+		} while (FindNextFileA(findHandle, &findData));
+		FindClose(findHandle);
+	}
+#else
+	DIR* folder = opendir(folderPath.c_str());
+	if (folder != nullptr)
+	{
+		for (dirent* entry = readdir(folder); entry != nullptr; entry = readdir(folder))
+		{
+			filenames.push_back(entry->d_name);
+		}
+		closedir(folder);
+	}
+#endif
+
+	std::vector<int> segmentNumbers;
+	for (int i = 0; i < (int)filenames.size(); ++i)
+	{
+		const std::string& filename = filenames[i];
+		if (filename.compare(0, segmentPrefix.size(), segmentPrefix) != 0 || !isdigit((unsigned char)filename[segmentPrefix.size()]))
+		{
+			continue;
+		}
+
+		char* suffix = nullptr;
+		long segmentNumber = strtol(filename.c_str() + segmentPrefix.size(), &suffix, 10);
+		if ((*suffix == '\0' || strcmp(suffix, ".zst") == 0) && segmentNumber > 0 && segmentNumber < INT_MAX)
+		{
+			segmentNumbers.push_back((int)segmentNumber);
+		}
+	}
+
+	return segmentNumbers;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// Writes "<filepath>.zst" and removes the original, leaves the original alone if anything fails
+bool LogFileSink_CompressFile(const std::string& filepath)
+{
+#if defined( LOG_FILES_USE_ZSTD )
+	FILE* input = fopen(filepath.c_str(), "rb");
+	if (input == nullptr)
+	{
+		return false;
+	}
+
+	std::string compressedFilepath = filepath + ".zst";
+	FILE* output = fopen(compressedFilepath.c_str(), "wb");
+	if (output == nullptr)
+	{
+		fclose(input);
+		return false;
+	}
+
+	ZSTD_CCtx* context = ZSTD_createCCtx();
+	ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, LOG_FILE_ZSTD_LEVEL);
+	std::vector<char> inputBuffer(ZSTD_CStreamInSize());
+	std::vector<char> outputBuffer(ZSTD_CStreamOutSize());
+
+	bool didSucceed = true;
+	bool isLastChunk = false;
+	while (didSucceed && !isLastChunk)
+	{
+		size_t numRead = fread(inputBuffer.data(), 1, inputBuffer.size(), input);
+		isLastChunk = (numRead < inputBuffer.size());
+		ZSTD_EndDirective mode = isLastChunk ? ZSTD_e_end : ZSTD_e_continue;
+		ZSTD_inBuffer inBuffer = {inputBuffer.data(), numRead, 0};
+
+		// Until this chunk is used up, or for the last one until the frame is finished
+		bool isChunkDone = false;
+		while (didSucceed && !isChunkDone)
+		{
+			ZSTD_outBuffer outBuffer = {outputBuffer.data(), outputBuffer.size(), 0};
+			size_t numRemaining = ZSTD_compressStream2(context, &outBuffer, &inBuffer, mode);
+			didSucceed = !ZSTD_isError(numRemaining) && (fwrite(outputBuffer.data(), 1, outBuffer.pos, output) == outBuffer.pos);
+			isChunkDone = isLastChunk ? (numRemaining == 0) : (inBuffer.pos == inBuffer.size);
+		}
+	}
+	didSucceed = didSucceed && !ferror(input);
+
+	ZSTD_freeCCtx(context);
+	fclose(input);
+	didSucceed = (fclose(output) == 0) && didSucceed;
+
+	remove(didSucceed ? filepath.c_str() : compressedFilepath.c_str());
+	return didSucceed;
+#else
+	(void)filepath;
+	return false;
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogFileSink_LowerThreadPriority()
+{
+#if defined( PLATFORM_WINDOWS )
+	// Background mode lowers the IO priority along with the CPU one
+	SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined( __linux__ )
+	// Nice values are per thread on Linux, and the IO priority follows the nice value unless it was set
+	int result = setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+	(void)result;
+#endif
+}
+
+
+
+//-------------------------------------------------------------------------------------------------------
+LogFileSink::~LogFileSink()
+{
+	Close();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogFileSink::Open(const std::vector<std::string>& filepaths, bool shouldUseDirectIO)
+{
+	Close();
+
+	// Carries on after the newest segment earlier runs left, rotating would overwrite it otherwise
+	m_segmentNumber = 0;
+	for (int i = 0; i < (int)filepaths.size(); ++i)
+	{
+		std::vector<int> segmentNumbers = LogFileSink_FindSegmentNumbers(filepaths[i]);
+		for (int j = 0; j < (int)segmentNumbers.size(); ++j)
+		{
+			m_segmentNumber = (segmentNumbers[j] > m_segmentNumber) ? segmentNumbers[j] : m_segmentNumber;
+		}
+	}
+
+	m_segmentStartTime = std::chrono::steady_clock::now();
+	m_bufferStorage.resize(LOG_FILE_BUFFER_CAPACITY + LOG_FILE_BLOCK_SIZE);
+	m_buffer = (char*)(((uintptr_t)m_bufferStorage.data() + LOG_FILE_BLOCK_SIZE - 1) & ~(uintptr_t)(LOG_FILE_BLOCK_SIZE - 1));
+	m_bufferSize = 0;
+	m_fileOffset = 0;
+	m_numFailedAttempts = 0;
+	m_numFlushedBytes = 0;
+
+#if defined( PLATFORM_WINDOWS )
+	shouldUseDirectIO = false;
+#elif !defined( O_DIRECT )
+	shouldUseDirectIO = false;
+#endif
+
+	// Twice at most, a second time without direct IO if some file wouldn't take it
+	for (int attempt = 0; attempt < 2; ++attempt)
+	{
+		m_isUsingDirectIO = shouldUseDirectIO;
+		bool didAllOpen = true;
+
+		for (int i = 0; i < (int)filepaths.size(); ++i)
+		{
+			LogFile file;
+			file.m_filepath = filepaths[i];
+			file.m_handle = OpenFile(filepaths[i], m_isUsingDirectIO);
+
+			if (file.m_handle != -1)
+			{
+				m_files.push_back(file);
+			}
+			else
+			{
+				didAllOpen = false;
+			}
+		}
+
+		if (didAllOpen || !m_isUsingDirectIO)
+		{
+			break;
+		}
+
+		CloseFiles();
+		shouldUseDirectIO = false;
+	}
+
+	return IsOpen();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogFileSink::Close()
+{
+	if (IsOpen())
+	{
+		if (!WriteOut(true))
+		{
+			DropBuffer();
+		}
+		CloseFiles();
+	}
+
+	StopCompressor();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogFileSink::Write(const std::string& tag, const std::string& text)
+{
+	if (!IsOpen())
+	{
+		return;
+	}
+
+	// Lines never straddle two segments, and a full buffer is a good time to check the age
+	size_t lineLength = tag.size() + 2 + text.size() + 1;
+	uint64_t segmentLength = m_fileOffset + m_bufferSize;
+	uint64_t maxSegmentBytes = m_maxSegmentBytes.load(std::memory_order_relaxed);
+	bool isSegmentFull = (maxSegmentBytes > 0) && (segmentLength > 0) && (segmentLength + lineLength > maxSegmentBytes);
+	if (isSegmentFull || ((m_bufferSize + lineLength > LOG_FILE_BUFFER_CAPACITY) && IsSegmentTooOld()))
+	{
+		Rotate();
+	}
+
+	// Usually all one copy, only a line longer than the space left splits
+	if (m_bufferSize + lineLength <= LOG_FILE_BUFFER_CAPACITY)
+	{
+		char* destination = m_buffer + m_bufferSize;
+		memcpy(destination, tag.data(), tag.size());
+		destination += tag.size();
+		*destination++ = ':';
+		*destination++ = ' ';
+		memcpy(destination, text.data(), text.size());
+		destination += text.size();
+		*destination = '\n';
+		m_bufferSize += lineLength;
+		return;
+	}
+
+	Append(tag.data(), tag.size());
+	Append(": ", 2);
+	Append(text.data(), text.size());
+	Append("\n", 1);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogFileSink::Flush()
+{
+	if (!IsOpen())
+	{
+		return true;
+	}
+
+	if (IsSegmentTooOld())
+	{
+		return Rotate();
+	}
+
+	return WriteOut(true);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogFileSink::Sync()
+{
+	bool didFlush = Flush();
+
+	// Only counted, the kernel has already let go of whatever didn't make it and asking again won't bring it back
+	for (int i = 0; i < (int)m_files.size(); ++i)
+	{
+#if defined( PLATFORM_WINDOWS )
+		bool didSync = (FlushFileBuffers((HANDLE)m_files[i].m_handle) != 0);
+#else
+		bool didSync = (fsync((int)m_files[i].m_handle) == 0);
+#endif
+		if (!didSync)
+		{
+			m_numWriteErrors.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	return didFlush;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogFileSink::SetRotation(uint64_t maxSegmentBytes, double maxSegmentSeconds, int maxSegmentsKept)
+{
+	m_maxSegmentBytes.store(maxSegmentBytes, std::memory_order_relaxed);
+	m_maxSegmentSeconds.store(maxSegmentSeconds, std::memory_order_relaxed);
+	m_maxSegmentsKept.store(maxSegmentsKept, std::memory_order_relaxed);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+intptr_t LogFileSink::OpenFile(const std::string& filepath, bool shouldUseDirectIO)
+{
+#if defined( PLATFORM_WINDOWS )
+	// Shared for delete so rotation can rename it while it's open
+	(void)shouldUseDirectIO;
+	HANDLE handle = CreateFileA(filepath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	return (handle != INVALID_HANDLE_VALUE) ? (intptr_t)handle : -1;
+#else
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	#if defined( O_DIRECT )
+	flags |= shouldUseDirectIO ? O_DIRECT : 0;
+	#else
+	(void)shouldUseDirectIO;
+	#endif
+	return open(filepath.c_str(), flags, 0644);
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogFileSink::Append(const char* bytes, size_t numBytes)
+{
+	while (numBytes > 0)
+	{
+		if (m_bufferSize == LOG_FILE_BUFFER_CAPACITY)
+		{
+			// New lines need the room more than ones that already failed
+			WriteOut(false);
+			if (m_bufferSize == LOG_FILE_BUFFER_CAPACITY)
+			{
+				DropBuffer();
+			}
+		}
+
+		size_t numCopied = LOG_FILE_BUFFER_CAPACITY - m_bufferSize;
+		numCopied = (numCopied < numBytes) ? numCopied : numBytes;
+		memcpy(m_buffer + m_bufferSize, bytes, numCopied);
+		m_bufferSize += numCopied;
+		bytes += numCopied;
+		numBytes -= numCopied;
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogFileSink::WriteOut(bool isFlushing)
+{
+	if (m_bufferSize == 0)
+	{
+		return true;
+	}
+
+	// Every file is tried even after one fails, the ones that took it are written again at the same offset next time
+	bool didWrite = true;
+	if (!m_isUsingDirectIO)
+	{
+		for (int i = 0; i < (int)m_files.size(); ++i)
+		{
+			didWrite = WriteToFile(m_files[i], m_buffer, m_bufferSize, m_fileOffset) && didWrite;
+		}
+		if (!didWrite)
+		{
+			return HandleFailedWrite();
+		}
+
+		m_fileOffset += m_bufferSize;
+		m_bufferSize = 0;
+		m_numFailedAttempts = 0;
+		return true;
+	}
+
+	// Whole blocks go out for good, the partial one left over moves to the front of the buffer
+	size_t numWholeBytes = m_bufferSize & ~(LOG_FILE_BLOCK_SIZE - 1);
+	if (numWholeBytes > 0)
+	{
+		for (int i = 0; i < (int)m_files.size(); ++i)
+		{
+			didWrite = WriteToFile(m_files[i], m_buffer, numWholeBytes, m_fileOffset) && didWrite;
+		}
+		if (!didWrite)
+		{
+			return HandleFailedWrite();
+		}
+
+		m_fileOffset += numWholeBytes;
+		m_bufferSize -= numWholeBytes;
+		m_numFlushedBytes = 0;
+		memmove(m_buffer, m_buffer + numWholeBytes, m_bufferSize);
+	}
+
+	// A flush can't wait for the block to fill, write it padded and cut the file back to the real length
+	//	It stays in the buffer and is written again, whole, once more lines fill it
+	if (isFlushing && m_bufferSize > 0)
+	{
+		memset(m_buffer + m_bufferSize, 0, LOG_FILE_BLOCK_SIZE - m_bufferSize);
+		for (int i = 0; i < (int)m_files.size(); ++i)
+		{
+			didWrite = WriteToFile(m_files[i], m_buffer, LOG_FILE_BLOCK_SIZE, m_fileOffset) && didWrite;
+#if !defined( PLATFORM_WINDOWS )
+			didWrite = (ftruncate((int)m_files[i].m_handle, (off_t)(m_files[i].m_baseOffset + m_fileOffset + m_bufferSize)) == 0) && didWrite;
+#endif
+		}
+		if (!didWrite)
+		{
+			return HandleFailedWrite();
+		}
+		m_numFlushedBytes = m_bufferSize;
+	}
+
+	m_numFailedAttempts = 0;
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// The lines stay buffered at the same offset for the next write out, until they've failed too many times in a row
+//	True once they've been given up on, there's nothing left to try again
+bool LogFileSink::HandleFailedWrite()
+{
+	m_numWriteErrors.fetch_add(1, std::memory_order_relaxed);
+
+	++m_numFailedAttempts;
+	if (m_numFailedAttempts < LOG_FILE_MAX_WRITE_ATTEMPTS)
+	{
+		return false;
+	}
+
+	DropBuffer();
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// The file carries on from the same offset without these lines, after any a direct IO flush already got out
+void LogFileSink::DropBuffer()
+{
+	m_numLostBytes.fetch_add(m_bufferSize - m_numFlushedBytes, std::memory_order_relaxed);
+	m_bufferSize = m_numFlushedBytes;
+	m_numFailedAttempts = 0;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogFileSink::WriteToFile(const LogFile& file, const char* bytes, size_t numBytes, uint64_t offset)
+{
+	// Always at an offset, direct IO rewrites the last block, a failed write is tried again in place, and a file that missed a rotation carries on past its base
+	offset += file.m_baseOffset;
+
+#if defined( PLATFORM_WINDOWS )
+	while (numBytes > 0)
+	{
+		OVERLAPPED position = {};
+		position.Offset = (DWORD)offset;
+		position.OffsetHigh = (DWORD)(offset >> 32);
+
+		DWORD numWritten = 0;
+		DWORD numToWrite = (numBytes > 0x40000000) ? 0x40000000 : (DWORD)numBytes;
+		if (!WriteFile((HANDLE)file.m_handle, bytes, numToWrite, &numWritten, &position) || numWritten == 0)
+		{
+			return false;
+		}
+
+		bytes += numWritten;
+		numBytes -= numWritten;
+		offset += numWritten;
+	}
+#else
+	while (numBytes > 0)
+	{
+		ssize_t numWritten = pwrite((int)file.m_handle, bytes, numBytes, (off_t)offset);
+		if (numWritten < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (numWritten <= 0)
+		{
+			return false;
+		}
+
+		bytes += numWritten;
+		numBytes -= (size_t)numWritten;
+		offset += (uint64_t)numWritten;
+	}
+#endif
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogFileSink::CloseFiles()
+{
+	for (int i = 0; i < (int)m_files.size(); ++i)
+	{
+#if defined( PLATFORM_WINDOWS )
+		CloseHandle((HANDLE)m_files[i].m_handle);
+#else
+		close((int)m_files[i].m_handle);
+#endif
+	}
+
+	m_files.clear();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogFileSink::IsSegmentTooOld() const
+{
+	double maxSegmentSeconds = m_maxSegmentSeconds.load(std::memory_order_relaxed);
+	if (maxSegmentSeconds <= 0.0 || (m_fileOffset + m_bufferSize) == 0)
+	{
+		return false;
+	}
+
+	std::chrono::duration<double> segmentAge = std::chrono::steady_clock::now() - m_segmentStartTime;
+	return segmentAge.count() >= maxSegmentSeconds;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool LogFileSink::Rotate()
+{
+	if (!WriteOut(true))
+	{
+		return false;
+	}
+
+	uint64_t segmentLength = m_fileOffset + m_bufferSize;
+	++m_segmentNumber;
+	std::string segmentSuffix = "." + std::to_string(m_segmentNumber);
+
+	int maxSegmentsKept = m_maxSegmentsKept.load(std::memory_order_relaxed);
+	int oldestKeptNumber = (maxSegmentsKept > 0 && m_segmentNumber > maxSegmentsKept) ? m_segmentNumber - maxSegmentsKept + 1 : 0;
+
+	// Renamed while still open, if that fails (another program holding it on Windows) the file just keeps growing until the next rotation
+	std::vector<LogSegment> closedSegments;
+	for (int i = 0; i < (int)m_files.size(); ++i)
+	{
+		LogFile& file = m_files[i];
+		std::string segmentFilepath = file.m_filepath + segmentSuffix;
+
+		if (!LogFileSink_RenameFile(file.m_filepath, segmentFilepath))
+		{
+			file.m_baseOffset += segmentLength;
+#if !defined( PLATFORM_WINDOWS ) && defined( O_DIRECT )
+			// Its writes are no longer block aligned
+			int flags = fcntl((int)file.m_handle, F_GETFL);
+			fcntl((int)file.m_handle, F_SETFL, flags & ~O_DIRECT);
+#endif
+			continue;
+		}
+
+#if defined( PLATFORM_WINDOWS )
+		CloseHandle((HANDLE)file.m_handle);
+#else
+		close((int)file.m_handle);
+#endif
+		file.m_handle = OpenFile(file.m_filepath, m_isUsingDirectIO);
+		file.m_baseOffset = 0;
+
+		LogSegment segment;
+		segment.m_filepath = segmentFilepath;
+		segment.m_baseFilepath = file.m_filepath;
+		segment.m_oldestKeptNumber = oldestKeptNumber;
+		closedSegments.push_back(segment);
+	}
+
+	// Anything that couldn't be opened again is gone for good
+	m_files.erase(std::remove_if(m_files.begin(), m_files.end(), [](const LogFile& file) { return file.m_handle == -1; }), m_files.end());
+
+	m_fileOffset = 0;
+	m_bufferSize = 0;
+	m_numFlushedBytes = 0;
+	m_segmentStartTime = std::chrono::steady_clock::now();
+
+
+	// Hand the closed segments off
+	if (!closedSegments.empty())
+	{
+		{
+			std::lock_guard<std::mutex> compressorLock(m_compressorMutex);
+			m_closedSegments.insert(m_closedSegments.end(), closedSegments.begin(), closedSegments.end());
+		}
+
+		if (m_compressorThread == nullptr)
+		{
+			m_isCompressorStopping = false;
+			m_compressorThread = Thread_Create(CompressorThread_Callback, (void*)this);
+		}
+		m_compressorCondition.notify_one();
+	}
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogFileSink::StopCompressor()
+{
+	if (m_compressorThread == nullptr)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> compressorLock(m_compressorMutex);
+		m_isCompressorStopping = true;
+	}
+	m_compressorCondition.notify_one();
+
+	// Finishes what's queued first
+	Thread_Join(m_compressorThread);
+	m_compressorThread = nullptr;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogFileSink::CompressorThread_Callback(void* data)
+{
+	LogFileSink* fileSink = (LogFileSink*)data;
+	LogFileSink_LowerThreadPriority();
+
+	std::unique_lock<std::mutex> compressorLock(fileSink->m_compressorMutex);
+	while (true)
+	{
+		fileSink->m_compressorCondition.wait(compressorLock, [fileSink]() { return !fileSink->m_closedSegments.empty() || fileSink->m_isCompressorStopping; });
+		if (fileSink->m_closedSegments.empty())
+		{
+			break;
+		}
+
+		LogSegment segment = fileSink->m_closedSegments.front();
+		fileSink->m_closedSegments.pop_front();
+		compressorLock.unlock();
+
+		// Segments go in order, so an expired one was already compressed (or tried)
+		//	Whatever is on disk is trimmed, earlier runs' segments and ones a smaller limit left behind included
+		LogFileSink_CompressFile(segment.m_filepath);
+		if (segment.m_oldestKeptNumber > 0)
+		{
+			std::vector<int> segmentNumbers = LogFileSink_FindSegmentNumbers(segment.m_baseFilepath);
+			for (int i = 0; i < (int)segmentNumbers.size(); ++i)
+			{
+				if (segmentNumbers[i] < segment.m_oldestKeptNumber)
+				{
+					std::string expiredFilepath = segment.m_baseFilepath + "." + std::to_string(segmentNumbers[i]);
+					remove(expiredFilepath.c_str());
+					remove((expiredFilepath + ".zst").c_str());
+				}
+			}
+		}
+
+		compressorLock.lock();
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Engine/Async/Threading.hpp"
+
+
+
+// The logger's text files, every line is formatted once into one buffer and the buffer is written to every file in batches
+//	Only the logger thread uses it once the logger is running
+//	Direct IO (O_DIRECT, Linux only) keeps logs out of the page cache, if any file can't take it they all fall back to buffered writes
+//
+// Rotation
+//	Once the current segment passes its size or age limit every file is renamed to "<filepath>.<N>" and started again empty
+//	N carries on from the segments already on disk, so a new run never overwrites the last one's
+//	Closed segments are compressed to "<filepath>.<N>.zst" (with LOG_FILES_USE_ZSTD) and trimmed to the newest few on a low priority thread,
+//	the logger thread only renames and reopens
+//
+// Errors
+//	A write that fails leaves the lines in the buffer for the next one, which writes them again at the same offset
+//	After LOG_FILE_MAX_WRITE_ATTEMPTS failures in a row, or once new lines need the room, they're thrown away and counted
+
+
+
+//-------------------------------------------------------------------------------------------------------
+class LogFileSink
+{
+public:
+	LogFileSink() {};
+	~LogFileSink();
+
+	bool		Open(const std::vector<std::string>& filepaths, bool shouldUseDirectIO = false); // True if any file opened
+	void		Close();	// Waits for closed segments to finish compressing
+	bool		IsOpen() const { return !m_files.empty(); }
+	bool		IsUsingDirectIO() const { return m_isUsingDirectIO; }
+
+	void		Write(const std::string& tag, const std::string& text);	// "TAG: text\n", like the old stream hooks
+	bool		Flush();	// Hands everything buffered to the OS, false if a write failed and its lines are still waiting to be tried again
+	bool		Sync();		// Flush, then waits for the disk
+
+	// Any thread
+	uint64_t	GetNumWriteErrors() const	{ return m_numWriteErrors.load(std::memory_order_relaxed); }
+	uint64_t	GetNumLostBytes() const		{ return m_numLostBytes.load(std::memory_order_relaxed); }
+
+	// Any thread, 0 turns a limit off
+	//	The age is checked whenever the buffer fills or the logger goes idle, so an idle log isn't rotated until its next line
+	void		SetRotation(uint64_t maxSegmentBytes, double maxSegmentSeconds, int maxSegmentsKept);
+
+private:
+	struct LogFile
+	{
+		std::string		m_filepath;
+		intptr_t		m_handle;
+		uint64_t		m_baseOffset = 0;	// Bytes kept from earlier segments when renaming it failed
+	};
+
+	struct LogSegment
+	{
+		std::string		m_filepath;				// Closed, waiting to be compressed
+		std::string		m_baseFilepath;			// The file it was rotated out of
+		int				m_oldestKeptNumber = 0;	// Every older segment of that file on disk is deleted, 0 keeps them all
+	};
+
+	intptr_t	OpenFile(const std::string& filepath, bool shouldUseDirectIO);	// Truncates, -1 if it couldn't
+	void		Append(const char* bytes, size_t numBytes);
+	bool		WriteOut(bool isFlushing);	// False if the lines were kept for another try
+	bool		WriteToFile(const LogFile& file, const char* bytes, size_t numBytes, uint64_t offset);
+	bool		HandleFailedWrite();
+	void		DropBuffer();
+	void		CloseFiles();
+
+	bool		IsSegmentTooOld() const;
+	bool		Rotate();	// False if writing out the last of the segment failed, it isn't rotated until that goes through
+	void		StopCompressor();
+	static void	CompressorThread_Callback(void* data);
+
+	std::vector<LogFile>	m_files;
+	std::vector<char>		m_bufferStorage;
+	char*					m_buffer = nullptr;		// Aligned for direct IO
+	size_t					m_bufferSize = 0;
+
+	// Direct IO only writes whole blocks, a flushed partial block is padded, cut back with a truncate, and rewritten next time
+	bool					m_isUsingDirectIO = false;
+	uint64_t				m_fileOffset = 0;		// Of m_buffer[0] in the current segment
+
+	// Errors
+	int						m_numFailedAttempts = 0;	// In a row, for what's in the buffer now
+	size_t					m_numFlushedBytes = 0;		// Front of the partial block a direct IO flush already wrote, never dropped
+	std::atomic<uint64_t>	m_numWriteErrors{0};
+	std::atomic<uint64_t>	m_numLostBytes{0};
+
+	// Rotation
+	std::atomic<uint64_t>						m_maxSegmentBytes{0};
+	std::atomic<double>							m_maxSegmentSeconds{0.0};
+	std::atomic<int>							m_maxSegmentsKept{0};
+	int											m_segmentNumber = 0;
+	std::chrono::steady_clock::time_point		m_segmentStartTime;
+
+	// Compressor, started by the first rotation
+	ThreadHandle				m_compressorThread = nullptr;
+	std::mutex					m_compressorMutex;
+	std::condition_variable		m_compressorCondition;
+	std::deque<LogSegment>		m_closedSegments;
+	bool						m_isCompressorStopping = false;
+
+	// No copying, the files would be closed twice
+	LogFileSink(const LogFileSink&) = delete;
+	LogFileSink& operator=(const LogFileSink&) = delete;
+};
@@ -0,0 +1,300 @@
+#include "Engine/Logger/LogFormat.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <climits>
+#include <cmath>
+
+#include "Engine/Logger/Logger.hpp"
+
+
+
+//-------------------------------------------------------------------------------------------------------
+// Casting a double the integer can't hold is undefined, a mismatched argument clamps instead and NaN is 0
+int64_t ClampToInt64(double value)
+{
+	if (std::isnan(value))
+	{
+		return 0;
+	}
+	if (value >= (double)INT64_MAX)
+	{
+		return INT64_MAX;
+	}
+	if (value <= (double)INT64_MIN)
+	{
+		return INT64_MIN;
+	}
+
+	return (int64_t)value;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+int ClampToInt(int64_t value)
+{
+	return (value > INT_MAX) ? INT_MAX : (value < INT_MIN) ? INT_MIN : (int)value;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+class CapturedArgumentReader
+{
+public:
+	CapturedArgumentReader(const char* arguments, size_t argumentsSize)
+		: m_cursor(arguments)
+		, m_end(arguments + argumentsSize)
+	{}
+
+	// False once the arguments run out, the format asked for more than it was given
+	//	A blob cut short stops the same way, whatever was left of it is never read
+	bool Read(eLogArgumentType& outType, uint64_t& outBits, std::string& outString)
+	{
+		if (m_cursor >= m_end)
+		{
+			return false;
+		}
+
+		outType = (eLogArgumentType)*m_cursor++;
+		if (outType == LOG_ARGUMENT_STRING)
+		{
+			uint32_t length = 0;
+			if ((size_t)(m_end - m_cursor) < sizeof(length))
+			{
+				m_cursor = m_end;
+				return false;
+			}
+			memcpy(&length, m_cursor, sizeof(length));
+			m_cursor += sizeof(length);
+
+			if ((size_t)(m_end - m_cursor) < length)
+			{
+				m_cursor = m_end;
+				return false;
+			}
+			outString.assign(m_cursor, length);
+			m_cursor += length;
+		}
+		else
+		{
+			if ((size_t)(m_end - m_cursor) < sizeof(outBits))
+			{
+				m_cursor = m_end;
+				return false;
+			}
+			memcpy(&outBits, m_cursor, sizeof(outBits));
+			m_cursor += sizeof(outBits);
+		}
+
+		return true;
+	}
+
+	// For * widths and precisions
+	bool ReadInt(int& outValue)
+	{
+		eLogArgumentType type;
+		uint64_t bits = 0;
+		std::string unused;
+		if (!Read(type, bits, unused))
+		{
+			return false;
+		}
+
+		double asDouble;
+		memcpy(&asDouble, &bits, sizeof(asDouble));
+		outValue = ClampToInt((type == LOG_ARGUMENT_DOUBLE) ? ClampToInt64(asDouble) : (int64_t)bits);
+		return true;
+	}
+
+private:
+	const char*	m_cursor;
+	const char*	m_end;
+};
+
+
+//-------------------------------------------------------------------------------------------------------
+template <typename T>
+void AppendFormatted(std::string& outText, const char* specifier, T value)
+{
+	char formatted[128];
+	int length = snprintf(formatted, sizeof(formatted), specifier, value);
+	if (length < 0)
+	{
+		return;
+	}
+
+	if ((size_t)length < sizeof(formatted))
+	{
+		outText.append(formatted, (size_t)length);
+	}
+	else
+	{
+		size_t oldSize = outText.size();
+		outText.resize(oldSize + (size_t)length + 1);
+		snprintf(&outText[oldSize], (size_t)length + 1, specifier, value);
+		outText.resize(oldSize + (size_t)length);
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// Walks the printf format, each conversion is redone with the length modifier the captured type needs
+//	so a mismatched argument is converted instead of being undefined behaviour
+void FormatCapturedArguments(const char* format, const char* arguments, size_t argumentsSize, std::string& outText)
+{
+	outText.clear();
+	CapturedArgumentReader reader(arguments, argumentsSize);
+
+	std::string specifier;
+	std::string stringValue;
+	const char* cursor = format;
+	while (*cursor != '\0')
+	{
+		// Plain text up to the next conversion
+		const char* percent = strchr(cursor, '%');
+		if (percent == nullptr)
+		{
+			outText.append(cursor);
+			break;
+		}
+		outText.append(cursor, percent - cursor);
+		cursor = percent + 1;
+
+		if (*cursor == '%')
+		{
+			outText.push_back('%');
+			++cursor;
+			continue;
+		}
+
+		// Flags, width and precision are kept, * is replaced by its argument
+		specifier = "%";
+		bool isMissingArgument = false;
+		while (*cursor != '\0' && strchr("-+ #0", *cursor) != nullptr)
+		{
+			specifier.push_back(*cursor++);
+		}
+		for (int part = 0; part < 2; ++part)
+		{
+			if (part == 1)
+			{
+				if (*cursor != '.')
+				{
+					break;
+				}
+				specifier.push_back(*cursor++);
+			}
+
+			if (*cursor == '*')
+			{
+				int starValue = 0;
+				isMissingArgument |= !reader.ReadInt(starValue);
+				specifier += std::to_string(starValue);
+				++cursor;
+			}
+			while (*cursor >= '0' && *cursor <= '9')
+			{
+				specifier.push_back(*cursor++);
+			}
+		}
+
+		// Length modifiers are replaced by the captured type's own
+		while (*cursor != '\0' && strchr("hljztLq", *cursor) != nullptr)
+		{
+			++cursor;
+		}
+
+		char conversion = *cursor;
+		if (conversion == '\0')
+		{
+			outText.append(specifier);
+			break;
+		}
+		++cursor;
+
+		eLogArgumentType type = LOG_ARGUMENT_INT;
+		uint64_t bits = 0;
+		if (isMissingArgument || !reader.Read(type, bits, stringValue))
+		{
+			outText.append("<missing>");
+			continue;
+		}
+
+		double doubleValue;
+		memcpy(&doubleValue, &bits, sizeof(doubleValue));
+		int64_t intValue = (type == LOG_ARGUMENT_DOUBLE) ? ClampToInt64(doubleValue) : (int64_t)bits;
+		if (type != LOG_ARGUMENT_DOUBLE)
+		{
+			doubleValue = (type == LOG_ARGUMENT_INT) ? (double)(int64_t)bits : (double)bits;
+		}
+		if (type == LOG_ARGUMENT_STRING)
+		{
+			intValue = 0;
+			doubleValue = 0.0;
+		}
+
+		switch (conversion)
+		{
+			case 'd':
+			case 'i':
+				specifier += "lld";
+				AppendFormatted(outText, specifier.c_str(), (long long)intValue);
+				break;
+
+			case 'u':
+			case 'o':
+			case 'x':
+			case 'X':
+				specifier += "ll";
+				specifier.push_back(conversion);
+				AppendFormatted(outText, specifier.c_str(), (unsigned long long)intValue);
+				break;
+
+			case 'c':
+				specifier += "c";
+				AppendFormatted(outText, specifier.c_str(), (int)intValue);
+				break;
+
+			case 'f':
+			case 'F':
+			case 'e':
+			case 'E':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+				specifier.push_back(conversion);
+				AppendFormatted(outText, specifier.c_str(), doubleValue);
+				break;
+
+			case 'p':
+				specifier += "p";
+				AppendFormatted(outText, specifier.c_str(), (void*)(uintptr_t)bits);
+				break;
+
+			case 's':
+				// Whatever was passed, print it as text
+				if (type == LOG_ARGUMENT_INT)
+				{
+					stringValue = std::to_string((long long)(int64_t)bits);
+				}
+				else if (type == LOG_ARGUMENT_UINT || type == LOG_ARGUMENT_POINTER)
+				{
+					stringValue = std::to_string((unsigned long long)bits);
+				}
+				else if (type == LOG_ARGUMENT_DOUBLE)
+				{
+					stringValue = std::to_string(doubleValue);
+				}
+				specifier += "s";
+				AppendFormatted(outText, specifier.c_str(), stringValue.c_str());
+				break;
+
+			default:
+				// Includes %n, which is never honoured
+				outText.append(specifier);
+				outText.push_back(conversion);
+				break;
+		}
+	}
+}
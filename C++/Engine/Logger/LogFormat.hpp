@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+
+
+// Turns a deferred line's captured arguments (see LogArgumentBuffer) back into text
+//	Only needs the standard library so the log decoder tool can build it without the engine
+void FormatCapturedArguments(const char* format, const char* arguments, size_t argumentsSize, std::string& outText);
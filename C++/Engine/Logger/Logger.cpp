@@ -1,4 +1,8 @@
 #include "Engine/Logger/Logger.hpp"
+#include "Engine/Logger/LogBenchmark.hpp"
+#include "Engine/Logger/LogBinary.hpp"
+#include "Engine/Logger/LogFileSink.hpp"
+#include "Engine/Logger/LogFormat.hpp"
 
 #ifdef _WIN32
 #define PLATFORM_WINDOWS
@@ -7,18 +11,25 @@
 #endif
 
 #include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "Engine/Core/ErrorWarningAssert.hpp"
 
 #include "Engine/Core/EngineCommon.h"
 #include "Engine/Core/StringUtils.hpp"
+#include "Engine/Core/Time.hpp"
 #include "Engine/FileSystem/FileUtils.hpp"
 #include "Engine/Math/MathUtils.hpp"
 
 #include "Engine/Async/Threading.hpp"
-#include "Engine/Async/ThreadSafeQueue.hpp"
-#include "Engine/Async/ReaderWriterMutex.hpp"
 
 #include "Engine/Commands/Command.hpp"
 #include "Engine/Commands/DevConsole.hpp"
@@ -26,27 +37,590 @@ extern DevConsole* g_theDevConsole;
 
 
 
+//-------------------------------------------------------------------------------------------------------
+// Bounded multi producer ring of fixed size slots (Vyukov's bounded queue)
+//	Each slot's sequence number says whose turn it is, so producers only ever contend on the enqueue position
+//	and never on each other's slots. Lines are copied in whole, a line that doesn't fit a slot spills to the heap
+constexpr uint64_t	LOG_RING_CAPACITY		= 4096;		// Power of two
+constexpr size_t	LOG_SLOT_SIZE			= 512;
+constexpr size_t	LOG_SLOT_TAG_CAPACITY	= 32;		// Longer tags are cut
+constexpr size_t	LOG_SLOT_TEXT_CAPACITY	= LOG_SLOT_SIZE - sizeof(std::atomic<uint64_t>) - 2 * sizeof(char*) - sizeof(uint64_t) - 2 * sizeof(uint32_t) - 2 * sizeof(uint16_t) - LOG_SLOT_TAG_CAPACITY;
+
+// Everything the calling thread knows about a line besides its text
+struct LogLineInfo
+{
+	const char*		m_tag;
+	LogTagID		m_tagID;
+	const char*		m_format;		// Deferred lines only
+	uint64_t		m_timeHPC;
+	uint32_t		m_threadID;
+};
+
+struct alignas(64) LogSlot
+{
+	std::atomic<uint64_t>	m_sequence;
+	const char*				m_format;		// Set for deferred lines, the text is then their captured arguments
+	char*					m_longText;		// Only for lines longer than m_text
+	uint64_t				m_timeHPC;
+	uint32_t				m_threadID;
+	uint32_t				m_textLength;
+	uint16_t				m_tagID;
+	uint16_t				m_tagLength;
+	char					m_tag[LOG_SLOT_TAG_CAPACITY];
+	char					m_text[LOG_SLOT_TEXT_CAPACITY];
+};
+static_assert(sizeof(LogSlot) == LOG_SLOT_SIZE, "Log slots should stay a whole number of cache lines");
+
+class LogRing
+{
+public:
+	LogRing()
+	{
+		for (uint64_t i = 0; i < LOG_RING_CAPACITY; ++i)
+		{
+			m_slots[i].m_sequence.store(i, std::memory_order_relaxed);
+			m_slots[i].m_longText = nullptr;
+		}
+	}
+
+	// False if the ring is full
+	bool TryEnqueue(const LogLineInfo& info, const char* text, size_t textLength)
+	{
+		uint64_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+		while (true)
+		{
+			LogSlot& slot = m_slots[position & (LOG_RING_CAPACITY - 1)];
+			int64_t difference = (int64_t)slot.m_sequence.load(std::memory_order_acquire) - (int64_t)position;
+
+			if (difference == 0)
+			{
+				// Our turn, claim it
+				if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					FillSlot(slot, info, text, textLength);
+					slot.m_sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0)
+			{
+				// The consumer hasn't freed this slot from the last lap
+				return false;
+			}
+			else
+			{
+				// Another producer got it first
+				position = m_enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// False if the ring is empty, a null entry just throws the line away
+	bool TryDequeue(Log_LogEntry* outEntry)
+	{
+		uint64_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+		while (true)
+		{
+			LogSlot& slot = m_slots[position & (LOG_RING_CAPACITY - 1)];
+			int64_t difference = (int64_t)slot.m_sequence.load(std::memory_order_acquire) - (int64_t)(position + 1);
+
+			if (difference == 0)
+			{
+				// Producers dropping the oldest line dequeue too, so this can race
+				if (m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					EmptySlot(slot, outEntry);
+					slot.m_sequence.store(position + LOG_RING_CAPACITY, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = m_dequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	uint64_t GetNumEnqueued() const
+	{
+		return m_enqueuePosition.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetNumDequeued() const
+	{
+		return m_dequeuePosition.load(std::memory_order_relaxed);
+	}
+
+	// Whether the next slot to dequeue has a line in it, stale positions err on the side of true
+	bool HasPending() const
+	{
+		uint64_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+		const LogSlot& slot = m_slots[position & (LOG_RING_CAPACITY - 1)];
+		return (int64_t)slot.m_sequence.load(std::memory_order_acquire) - (int64_t)(position + 1) >= 0;
+	}
+
+private:
+	static void FillSlot(LogSlot& slot, const LogLineInfo& info, const char* text, size_t textLength)
+	{
+		slot.m_format = info.m_format;
+		slot.m_timeHPC = info.m_timeHPC;
+		slot.m_threadID = info.m_threadID;
+		slot.m_tagID = info.m_tagID;
+
+		size_t tagLength = strlen(info.m_tag);
+		tagLength = (tagLength < LOG_SLOT_TAG_CAPACITY) ? tagLength : LOG_SLOT_TAG_CAPACITY;
+		memcpy(slot.m_tag, info.m_tag, tagLength);
+		slot.m_tagLength = (uint16_t)tagLength;
+
+		char* textDestination = slot.m_text;
+		if (textLength > LOG_SLOT_TEXT_CAPACITY)
+		{
+			slot.m_longText = new char[textLength];
+			textDestination = slot.m_longText;
+		}
+		memcpy(textDestination, text, textLength);
+		slot.m_textLength = (uint32_t)textLength;
+	}
+
+	static void EmptySlot(LogSlot& slot, Log_LogEntry* outEntry)
+	{
+		const char* text = (slot.m_longText != nullptr) ? slot.m_longText : slot.m_text;
+		if (outEntry != nullptr)
+		{
+			// The entry's strings keep their capacity, so after the first few lines this doesn't allocate
+			outEntry->m_tag.assign(slot.m_tag, slot.m_tagLength);
+			outEntry->m_timeHPC = slot.m_timeHPC;
+			outEntry->m_threadID = slot.m_threadID;
+			outEntry->m_tagID = slot.m_tagID;
+			outEntry->m_format = slot.m_format;
+			if (slot.m_format != nullptr)
+			{
+				outEntry->m_arguments.assign(text, slot.m_textLength);
+				FormatCapturedArguments(slot.m_format, text, slot.m_textLength, outEntry->m_text);
+			}
+			else
+			{
+				outEntry->m_arguments.clear();
+				outEntry->m_text.assign(text, slot.m_textLength);
+			}
+		}
+
+		delete[] slot.m_longText;
+		slot.m_longText = nullptr;
+	}
+
+	alignas(64) std::atomic<uint64_t>	m_enqueuePosition{0};
+	alignas(64) std::atomic<uint64_t>	m_dequeuePosition{0};
+	LogSlot								m_slots[LOG_RING_CAPACITY];
+};
+
+
+
+//-------------------------------------------------------------------------------------------------------
+// A queued hook's own bounded queue and thread, so a slow hook only ever holds up itself
+//	The logger thread copies entries in and the hook's thread swaps them out, so the entries keep their strings' capacity
+constexpr uint32_t	LOG_HOOK_QUEUE_CAPACITY		= 1024;
+constexpr uint32_t	LOG_HOOK_QUEUE_BATCH_SIZE	= 64;		// Lines taken out per lock
+
+class LogHookQueue
+{
+public:
+	explicit LogHookQueue(const LogHook& hook)
+		: m_callback(hook.m_callback)
+		, m_userData(hook.m_userData)
+		, m_policy(hook.m_policy)
+		, m_entries(LOG_HOOK_QUEUE_CAPACITY)
+	{
+		m_thread = Thread_Create(ConsumerThread_Callback, (void*)this);
+	}
+
+	// Logger thread only
+	//	It owns the slots past the published ones, so lines are copied in without the lock and published a batch at a time by Wake
+	void Push(const Log_LogEntry& entry)
+	{
+		if (m_numKnownQueued + m_numStaged == LOG_HOOK_QUEUE_CAPACITY && !MakeRoom())
+		{
+			return;
+		}
+
+		m_entries[m_tail] = entry;
+		m_tail = (m_tail + 1) % LOG_HOOK_QUEUE_CAPACITY;
+		++m_numStaged;
+	}
+
+	// Logger thread only, once a batch so a hook that keeps up isn't woken for every line
+	void Wake()
+	{
+		std::unique_lock<std::mutex> queueLock(m_mutex);
+		Publish_Locked();
+		bool shouldWake = m_isConsumerWaiting && (m_numQueued > 0);
+		queueLock.unlock();
+
+		if (shouldWake)
+		{
+			m_hasEntriesCondition.notify_one();
+		}
+	}
+
+	// Delivers everything already queued before returning, nothing can be pushed after
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> queueLock(m_mutex);
+			Publish_Locked();
+			m_isStopping = true;
+		}
+		m_hasEntriesCondition.notify_one();
+
+		Thread_Join(m_thread);
+		m_thread = nullptr;
+	}
+
+	// Until the hook has been called with every line queued so far, dropped lines count as delivered
+	void WaitForDelivery()
+	{
+		std::unique_lock<std::mutex> queueLock(m_mutex);
+		uint64_t numPushed = m_numPushed;
+
+		++m_numDeliveryWaiters;
+		m_deliveredCondition.wait(queueLock, [&]() { return m_numDelivered + m_numDropped >= numPushed; });
+		--m_numDeliveryWaiters;
+	}
+
+	void GetStats(LogHookStats& outStats)
+	{
+		std::lock_guard<std::mutex> queueLock(m_mutex);
+		outStats.m_policy = m_policy;
+		outStats.m_numDelivered = m_numDelivered;
+		outStats.m_numDropped = m_numDropped;
+		outStats.m_numQueued = m_numQueued;
+		outStats.m_maxQueued = m_maxQueued;
+		outStats.m_lastLagSeconds = ConvertHPCtoSeconds(m_lastLagHPC);
+		outStats.m_maxLagSeconds = ConvertHPCtoSeconds(m_maxLagHPC);
+	}
+
+	eLogHookPolicy GetPolicy() const { return m_policy; }
+
+	// Log_Flush waits on a queue after letting go of the hook list, so whoever is done with it last deletes it
+	void AddRef()	{ m_numRefs.fetch_add(1, std::memory_order_relaxed); }
+	void Release()
+	{
+		if (m_numRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			delete this;
+		}
+	}
+
+private:
+	static void ConsumerThread_Callback(void* data);
+
+	void Publish_Locked()
+	{
+		m_numQueued += m_numStaged;
+		m_numPushed += m_numStaged;
+		m_numStaged = 0;
+		m_numKnownQueued = m_numQueued;
+		m_maxQueued = (m_numQueued > m_maxQueued) ? m_numQueued : m_maxQueued;
+	}
+
+	// The queue looked full, false if the line should be dropped
+	bool MakeRoom()
+	{
+		std::unique_lock<std::mutex> queueLock(m_mutex);
+		Publish_Locked();
+		if (m_numQueued < LOG_HOOK_QUEUE_CAPACITY)
+		{
+			return true;
+		}
+
+		if (m_isConsumerWaiting)
+		{
+			m_hasEntriesCondition.notify_one();
+		}
+
+		if (m_policy == LOG_HOOK_POLICY_BLOCK)
+		{
+			m_hasRoomCondition.wait(queueLock, [this]() { return m_numQueued < LOG_HOOK_QUEUE_CAPACITY; });
+		}
+		else if (m_policy == LOG_HOOK_POLICY_DROP_NEWEST)
+		{
+			++m_numDropped;
+			return false;
+		}
+		else
+		{
+			m_head = (m_head + 1) % LOG_HOOK_QUEUE_CAPACITY;
+			--m_numQueued;
+			++m_numDropped;
+		}
+
+		m_numKnownQueued = m_numQueued;
+		return true;
+	}
+
+	Log_Callback					m_callback;
+	void*							m_userData;
+	eLogHookPolicy					m_policy;
+	ThreadHandle					m_thread = nullptr;
+	std::atomic<int>				m_numRefs{1};			// The hook list's, and one for each Log_Flush waiting on it
+	std::vector<Log_LogEntry>		m_entries;				// Queued slots belong to the hook's thread, the rest to the logger thread
+
+	// Logger thread only
+	uint32_t						m_tail = 0;
+	uint32_t						m_numStaged = 0;		// Copied in, not published yet
+	uint32_t						m_numKnownQueued = 0;	// m_numQueued when last published, only ever too high
+
+	// Under m_mutex
+	std::mutex						m_mutex;
+	std::condition_variable			m_hasEntriesCondition;
+	std::condition_variable			m_hasRoomCondition;
+	std::condition_variable			m_deliveredCondition;
+	uint32_t						m_head = 0;
+	uint32_t						m_numQueued = 0;
+	uint32_t						m_maxQueued = 0;
+	bool							m_isConsumerWaiting = false;
+	bool							m_isStopping = false;
+	int								m_numDeliveryWaiters = 0;
+
+	// Stats, lag is from the log call to the hook being called with the line
+	uint64_t						m_numPushed = 0;
+	uint64_t						m_numDelivered = 0;
+	uint64_t						m_numDropped = 0;
+	uint64_t						m_lastLagHPC = 0;
+	uint64_t						m_maxLagHPC = 0;
+};
+
+
+
+//-------------------------------------------------------------------------------------------------------
+// Read mostly state published as immutable copies behind an atomic pointer, RCU style
+//	Readers pin the current copy with an add on a reader count and never wait. Writers swap a new copy in and retire the old one
+//	Readers count themselves under one of two epochs, the epoch only moves on once nobody is left counted under the one before it,
+//	so two moves past a copy's retirement means no reader can still be on it. Publish frees whatever got there without waiting,
+//	Synchronize blocks (on a condition variable, readers wake it) until nothing published before it can still be read
+//	Writers must be serialized by the caller
+template <typename T>
+class LogSnapshot
+{
+public:
+	class Reader
+	{
+	public:
+		explicit Reader(LogSnapshot& snapshot)
+			: m_snapshot(snapshot)
+		{
+			m_epoch = snapshot.m_epoch.load(std::memory_order_seq_cst) & 1;
+			snapshot.m_numReaders[m_epoch].fetch_add(1, std::memory_order_seq_cst);
+			m_value = snapshot.m_value.load(std::memory_order_seq_cst);
+		}
+
+		~Reader()
+		{
+			// Pairs with the writer setting m_isWriterWaiting before checking the count, one of the two sees the other
+			if (m_snapshot.m_numReaders[m_epoch].fetch_sub(1, std::memory_order_seq_cst) == 1 && m_snapshot.m_isWriterWaiting.load(std::memory_order_seq_cst))
+			{
+				std::lock_guard<std::mutex> waitLock(m_snapshot.m_waitMutex);
+				m_snapshot.m_waitCondition.notify_all();
+			}
+		}
+
+		const T& operator*() const	{ return *m_value; }
+		const T* operator->() const	{ return m_value; }
+
+	private:
+		LogSnapshot&	m_snapshot;
+		const T*		m_value;
+		uint32_t		m_epoch;
+
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+	};
+
+	LogSnapshot() : m_value(new T()) {}
+	~LogSnapshot()
+	{
+		for (int i = 0; i < (int)m_retired.size(); ++i)
+		{
+			delete m_retired[i].m_value;
+		}
+		delete m_value.load(std::memory_order_relaxed);
+	}
+
+	// Writers only
+	const T& GetForWriter() const { return *m_value.load(std::memory_order_relaxed); }
+
+	// Writers only, takes ownership and never waits, the old copy is freed by a later Publish or Synchronize once readers have left it
+	void Publish(T* value)
+	{
+		T* oldValue = m_value.exchange(value, std::memory_order_seq_cst);
+		m_retired.push_back({oldValue, m_epoch.load(std::memory_order_relaxed)});
+
+		TryAdvanceEpoch();
+		TryAdvanceEpoch();
+		FreeRetired();
+	}
+
+	// Writers only, returns once no reader can still be on a copy published before the call
+	void Synchronize()
+	{
+		uint32_t targetEpoch = m_epoch.load(std::memory_order_relaxed) + 2;
+		while (m_epoch.load(std::memory_order_relaxed) != targetEpoch)
+		{
+			if (!TryAdvanceEpoch())
+			{
+				WaitForReaders((m_epoch.load(std::memory_order_relaxed) + 1) & 1);
+			}
+		}
+
+		FreeRetired();
+	}
+
+private:
+	struct RetiredValue
+	{
+		T*			m_value;
+		uint32_t	m_epoch;	// When it was swapped out, no reader can have it two epochs on
+	};
+
+	// Only past the epoch before this one, the readers still counted under it could be on the copy it replaced
+	bool TryAdvanceEpoch()
+	{
+		uint32_t epoch = m_epoch.load(std::memory_order_relaxed);
+		if (m_numReaders[(epoch + 1) & 1].load(std::memory_order_seq_cst) != 0)
+		{
+			return false;
+		}
+
+		m_epoch.store(epoch + 1, std::memory_order_seq_cst);
+		return true;
+	}
+
+	void WaitForReaders(uint32_t epochParity)
+	{
+		std::unique_lock<std::mutex> waitLock(m_waitMutex);
+		m_isWriterWaiting.store(true, std::memory_order_seq_cst);
+		m_waitCondition.wait(waitLock, [&]() { return m_numReaders[epochParity].load(std::memory_order_seq_cst) == 0; });
+		m_isWriterWaiting.store(false, std::memory_order_relaxed);
+	}
+
+	void FreeRetired()
+	{
+		uint32_t epoch = m_epoch.load(std::memory_order_relaxed);
+		int numKept = 0;
+		for (int i = 0; i < (int)m_retired.size(); ++i)
+		{
+			if (epoch - m_retired[i].m_epoch >= 2)
+			{
+				delete m_retired[i].m_value;
+			}
+			else
+			{
+				m_retired[numKept++] = m_retired[i];
+			}
+		}
+		m_retired.resize(numKept);
+	}
+
+	std::atomic<T*>				m_value;
+	std::atomic<uint32_t>		m_epoch{0};
+	std::atomic<uint32_t>		m_numReaders[2] = {{0}, {0}};
+	std::vector<RetiredValue>	m_retired;					// Writers only
+
+	// Synchronize sleeps here, the last reader out of an epoch wakes it
+	std::mutex					m_waitMutex;
+	std::condition_variable		m_waitCondition;
+	std::atomic<bool>			m_isWriterWaiting{false};
+
+	LogSnapshot(const LogSnapshot&) = delete;
+	LogSnapshot& operator=(const LogSnapshot&) = delete;
+};
+
+typedef LogSnapshot<std::vector<LogHook>> LogHookList;
+
+struct LogTagFilter
+{
+	std::vector<std::string>	m_tags;						// default empty
+	bool						m_isWhiteList = false;		// default false
+};
+
+
+
 // State
-static bool								s_isRunning		= true;
-volatile static bool					s_shouldFlush    = true;
+static std::atomic<bool>				s_isRunning(true);
+
+// Flush tickets
+//	A line's ticket is its position in the ring, everything before the dequeue position has been handed to the hooks or dropped
+//	so the worker publishes that position once the files have been flushed (or synced) and Log_Flush waits for its ticket
+static std::atomic<uint64_t>			s_requestedFlushPosition(0);
+static std::atomic<uint64_t>			s_requestedSyncPosition(0);
+static std::atomic<uint64_t>			s_flushedPosition(0);		// Handed to the OS
+static std::atomic<uint64_t>			s_syncedPosition(0);		// On disk
+static uint64_t							s_lastSeenFlushRequest = 0;	// Worker only
+static uint64_t							s_lastSeenSyncRequest = 0;	// Worker only
+static std::mutex						s_flushMutex;
+static std::condition_variable			s_flushCondition;
+
+// Worker wakeup
+constexpr int							LOG_WORKER_BATCH_SIZE	= 256;	// Lines processed per lock of the hook list
+constexpr int							LOG_WORKER_MIN_SPINS	= 16;
+constexpr std::chrono::milliseconds		LOG_FILE_RETRY_INTERVAL(10);	// Between tries at a failed write while a flush waits on it
+static std::mutex						s_wakeMutex;
+static std::condition_variable			s_wakeCondition;
+static std::atomic<bool>				s_isWorkerWaiting(false);
+static std::atomic<int>					s_maxWorkerSpins(1024);
 
 // Log
 static ThreadHandle						s_workerThread	= nullptr;
-static ThreadSafeQueue<Log_LogEntry*>	s_logQueue;
+static LogRing							s_logRing;
+static std::atomic<int>					s_overflowPolicy(LOG_OVERFLOW_POLICY_BLOCK);
+static std::atomic<uint64_t>			s_numDroppedLines(0);
+static thread_local bool				t_isLoggerThread = false;	// Blocking on the thread that empties the ring would never return
+static thread_local bool				t_isHookThread = false;		// A queued hook's thread, the logger thread may be waiting on it
+static std::atomic<uint32_t>			s_numLogThreads(0);
+static thread_local uint32_t			t_logThreadID = 0;			// 0 until the thread first logs
+
+// Log_Test
+static std::atomic<int>					s_numLogTestThreadsRunning(0);
+static std::atomic<int>					s_numLogTestThreadsReady(0);
+static std::atomic<bool>				s_hasLogTestStarted(false);
+static std::atomic<uint64_t>			s_numLogTestLines(0);
+static uint64_t							s_logTestStartHPC = 0;
+static int								s_numLogTestThreads = 0;
 
 // Hooks
-static ReaderWriterMutex				s_hookListMutex;
-static std::vector<LogHook>				s_hookList;
+static LogHookList						s_hookList;
+static std::mutex						s_hookListMutex;			// Writers only
 
 // Tags
-static std::vector<std::string>			s_tags;						// default empty
-static bool								s_isWhiteList = false;		// default false
-static ReaderWriterMutex				s_tagMutex;
+static LogSnapshot<LogTagFilter>		s_tagFilter;
+static std::mutex						s_tagMutex;					// Writers, and interning
+
+// Tag IDs
+//	Every interned tag has a bit in g_logShownTags, rebuilt from s_tagFilter whenever it changes
+//	The lookup table is only ever added to so finding a tag's ID doesn't lock
+constexpr uint32_t						LOG_TAG_TABLE_SIZE = 2 * LOG_MAX_TAGS;		// Power of two, never more than half full
+static std::atomic<uint32_t>			s_tagTable[LOG_TAG_TABLE_SIZE];				// Tag ID + 1, 0 is empty
+static std::string						s_tagNames[LOG_MAX_TAGS];
+static int								s_numTags = 0;								// Under s_tagMutex
+static_assert(LOG_MAX_TAGS == 256, "g_logShownTags' initializer assumes 4 words");
+std::atomic<uint64_t>					g_logShownTags[LOG_MAX_TAGS / 64] = {{0}, {0}, {0}, {1ULL << 63}};	// The overflow ID is always shown
 
 // File Writing
+//#define LOG_FILES_USE_DIRECT_IO											// Keeps the text logs out of the page cache, Linux only
 static std::string						s_logFilepath = "Log/log.txt";
-static std::ofstream					s_logFile;
-static std::ofstream					s_logFile_Timestamped;
+static LogFileSink						s_fileSink;							// log.txt and its timestamped copy
+static std::atomic<uint64_t>			s_maxLogSegmentBytes(64 * 1024 * 1024);	// Rotation, see Log_SetFileRotation
+static std::atomic<double>				s_maxLogSegmentSeconds(0.0);
+static std::atomic<int>					s_maxLogSegmentsKept(32);
+
+// Binary File
+static std::string						s_binaryLogFilepath = "Log/log.binlog";
+static LogBinaryWriter					s_binaryWriter;
+static std::mutex						s_binaryWriterMutex;		// The hook and the flushes run on the worker, opening and closing don't
 
 
 
@@ -107,9 +681,9 @@ void Log_HideTag_Command(Command& cmd)
 //-------------------------------------------------------------------------------------------------------
 void Logger_FileWrite_Hook(const Log_LogEntry& entry, void* userData)
 {
-	std::ofstream* fileWriter = (std::ofstream*)userData;
+	LogFileSink* fileSink = (LogFileSink*)userData;
 
-	*fileWriter << Stringf("%s: %s\n", entry.m_tag.c_str(), entry.m_text.c_str());
+	fileSink->Write(entry.m_tag, entry.m_text);
 }
 
 
@@ -122,16 +696,21 @@ void FileWrite_Hook_Initialize()
 		CreateFolder(GetFolderPath(s_logFilepath));
 	}
 
-	s_logFile.open(s_logFilepath);
-	if (s_logFile.is_open())
-	{
-		Log_Hook(Logger_FileWrite_Hook, (void*)&s_logFile);
-	}
+	// One hook for both files, each line is formatted once
+	std::vector<std::string> filepaths;
+	filepaths.push_back(s_logFilepath);
+	filepaths.push_back(AppendTimestamp(s_logFilepath));
+
+#if defined( LOG_FILES_USE_DIRECT_IO )
+	bool shouldUseDirectIO = true;
+#else
+	bool shouldUseDirectIO = false;
+#endif
 
-	s_logFile_Timestamped.open(AppendTimestamp(s_logFilepath));
-	if (s_logFile_Timestamped.is_open())
+	s_fileSink.SetRotation(s_maxLogSegmentBytes.load(), s_maxLogSegmentSeconds.load(), s_maxLogSegmentsKept.load());
+	if (s_fileSink.Open(filepaths, shouldUseDirectIO))
 	{
-		Log_Hook(Logger_FileWrite_Hook, (void*)&s_logFile_Timestamped);
+		Log_Hook(Logger_FileWrite_Hook, (void*)&s_fileSink, LOG_HOOK_POLICY_INLINE);
 	}
 }
 
@@ -139,15 +718,18 @@ void FileWrite_Hook_Initialize()
 //-------------------------------------------------------------------------------------------------------
 void FileWrite_Hook_Destroy()
 {
-	if (s_logFile.is_open())
-	{
-		s_logFile.close();
-	}
+	Log_Unhook(Logger_FileWrite_Hook, (void*)&s_fileSink);
+	s_fileSink.Close();
+}
 
-	if (s_logFile_Timestamped.is_open())
-	{
-		s_logFile_Timestamped.close();
-	}
+
+//-------------------------------------------------------------------------------------------------------
+void Logger_BinaryWrite_Hook(const Log_LogEntry& entry, void* userData)
+{
+	LogBinaryWriter* binaryWriter = (LogBinaryWriter*)userData;
+
+	std::lock_guard<std::mutex> binaryWriterLock(s_binaryWriterMutex);
+	binaryWriter->Write(entry);
 }
 
 
@@ -179,23 +761,53 @@ void LogTest_ThreadFunction(void* data)
 {
 	int* threadNumber = (int*)data;
 
-	bool success = false;
+	// Read the whole file up front so only logging is timed
+	std::vector<std::string> lines;
 	std::string line;
 	std::ifstream bigFile;
 	bigFile.open("Data/BuiltIns/Big.txt");
 	if (bigFile.is_open())
 	{
-		int lineNumber = 0;
 		while ( getline (bigFile, line) )
 		{
-			Log( "[%u:%u] %s", *threadNumber, lineNumber, line.c_str()); 
-
-			++lineNumber;	
+			lines.push_back(line);
 		}
 
 		bigFile.close();
-		success = true;
+	}
+
+
+	// Everyone starts together, the last one in starts the clock
+	if (s_numLogTestThreadsReady.fetch_add(1) + 1 == s_numLogTestThreads)
+	{
+		s_logTestStartHPC = GetCurrentTimeInHPC();
+		s_hasLogTestStarted.store(true);
+	}
+	while (!s_hasLogTestStarted.load())
+	{
+		std::this_thread::yield();
+	}
+
+	for (int lineNumber = 0; lineNumber < (int)lines.size(); ++lineNumber)
+	{
+		Log( "[%u:%u] %s", *threadNumber, lineNumber, lines[lineNumber].c_str()); 
+	}
+	s_numLogTestLines.fetch_add(lines.size());
+
 
+	// The last one out reports, once when every thread is done logging and again once the logger has written it all
+	if (s_numLogTestThreadsRunning.fetch_sub(1) == 1)
+	{
+		uint64_t numLines = s_numLogTestLines.load();
+		double loggedSeconds = ConvertHPCtoSeconds(GetCurrentTimeInHPC() - s_logTestStartHPC);
+		Log_Flush();
+		double writtenSeconds = ConvertHPCtoSeconds(GetCurrentTimeInHPC() - s_logTestStartHPC);
+
+		LogTagged("LOG_TEST", "%d threads, %llu lines: %.0f lines/s logged (%.3f s), %.0f lines/s written (%.3f s), %llu dropped", 
+			s_numLogTestThreads, (unsigned long long)numLines, 
+			(double)numLines / loggedSeconds, loggedSeconds, 
+			(double)numLines / writtenSeconds, writtenSeconds,
+			(unsigned long long)Log_GetNumDroppedLines());
 	}
 
 	delete threadNumber;
@@ -205,6 +817,18 @@ void LogTest_ThreadFunction(void* data)
 //-------------------------------------------------------------------------------------------------------
 void Log_Test(unsigned int numThreads)
 {
+	// One test at a time, they share the counters
+	int numRunning = 0;
+	if (numThreads == 0 || !s_numLogTestThreadsRunning.compare_exchange_strong(numRunning, (int)numThreads))
+	{
+		return;
+	}
+
+	s_numLogTestThreads = (int)numThreads;
+	s_numLogTestThreadsReady.store(0);
+	s_numLogTestLines.store(0);
+	s_hasLogTestStarted.store(false);
+
 	for (int i = 0; i < (int)numThreads; ++i)
 	{
 		int* threadNumber = new int;
@@ -239,17 +863,230 @@ void Log_FlushTest_Command(Command& cmd)
 }
 
 
+//-------------------------------------------------------------------------------------------------------
+void Log_OverflowPolicy_Command(Command& cmd)
+{
+	std::string policyName = cmd.GetNextString();
+
+	if (policyName == "block")
+	{
+		Log_SetOverflowPolicy(LOG_OVERFLOW_POLICY_BLOCK);
+	}
+	else if (policyName == "drop_newest")
+	{
+		Log_SetOverflowPolicy(LOG_OVERFLOW_POLICY_DROP_NEWEST);
+	}
+	else if (policyName == "drop_oldest")
+	{
+		Log_SetOverflowPolicy(LOG_OVERFLOW_POLICY_DROP_OLDEST);
+	}
+	else if (!policyName.empty())
+	{
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), "Usage: Log_OverflowPolicy block|drop_newest|drop_oldest");
+		return;
+	}
+
+	const char* policyNames[LOG_OVERFLOW_POLICY_COUNT] = {"block", "drop_newest", "drop_oldest"};
+	g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Overflow policy: %s, %llu lines logged, %llu dropped", policyNames[Log_GetOverflowPolicy()], (unsigned long long)Log_GetNumLoggedLines(), (unsigned long long)Log_GetNumDroppedLines()));
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void Log_Binary_Command(Command& cmd)
+{
+	std::string action = cmd.GetNextString();
+
+	if (action == "start")
+	{
+		std::string filepath = cmd.GetNextString();
+		filepath = filepath.empty() ? AppendTimestamp(s_binaryLogFilepath) : filepath;
+
+		if (Log_OpenBinaryFile(filepath))
+		{
+			g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Binary log: %s", filepath.c_str()));
+		}
+		else
+		{
+			g_theDevConsole->PrintToLog(RGBA(255,0,0), Stringf("Couldn't open %s, or a binary log is already open", filepath.c_str()));
+		}
+	}
+	else if (action == "stop")
+	{
+		Log_CloseBinaryFile();
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Binary log closed, %llu write errors, %llu bytes lost", 
+			(unsigned long long)Log_GetNumBinaryWriteErrors(), (unsigned long long)Log_GetNumLostBinaryBytes()));
+	}
+	else if (action == "status")
+	{
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Binary log %s, %llu write errors, %llu bytes lost", Log_IsBinaryFileOpen() ? "open" : "closed", 
+			(unsigned long long)Log_GetNumBinaryWriteErrors(), (unsigned long long)Log_GetNumLostBinaryBytes()));
+	}
+	else
+	{
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), "Usage: Log_Binary start [filepath] | stop | status");
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void Log_Rotation_Command(Command& cmd)
+{
+	std::string maxMegabytes = cmd.GetNextString();
+	std::string maxMinutes = cmd.GetNextString();
+	std::string maxSegmentsKept = cmd.GetNextString();
+
+	if (!maxMegabytes.empty())
+	{
+		uint64_t maxSegmentBytes = (uint64_t)(StringToFloat(maxMegabytes.c_str()) * 1024.0 * 1024.0);
+		double maxSegmentSeconds = maxMinutes.empty() ? s_maxLogSegmentSeconds.load() : (double)StringToFloat(maxMinutes.c_str()) * 60.0;
+		int numSegmentsKept = maxSegmentsKept.empty() ? s_maxLogSegmentsKept.load() : StringToInt(maxSegmentsKept.c_str());
+		Log_SetFileRotation(maxSegmentBytes, maxSegmentSeconds, numSegmentsKept);
+	}
+
+	g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Log rotation: %.1f MB, %.1f minutes, %d segments kept (0 is no limit)", 
+		(double)s_maxLogSegmentBytes.load() / (1024.0 * 1024.0), s_maxLogSegmentSeconds.load() / 60.0, s_maxLogSegmentsKept.load()));
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void Log_Hooks_Command(Command& cmd)
+{
+	UNUSED(cmd);
+
+	const char* policyNames[LOG_HOOK_POLICY_COUNT] = {"inline", "block", "drop_newest", "drop_oldest"};
+
+	LogHookList::Reader hooks(s_hookList);
+	for (int i = 0; i < (int)hooks->size(); ++i)
+	{
+		const LogHook& hook = (*hooks)[i];
+		std::string tagName = (hook.m_tagID != LOG_HOOK_ALL_TAGS) ? Stringf(" (%s only)", Log_GetTagName(hook.m_tagID)) : "";
+		if (hook.m_queue == nullptr)
+		{
+			g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Hook %d%s: %s", i, tagName.c_str(), policyNames[LOG_HOOK_POLICY_INLINE]));
+			continue;
+		}
+
+		LogHookStats stats;
+		hook.m_queue->GetStats(stats);
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Hook %d%s: %s, %llu delivered, %llu dropped, %u queued (max %u), lag %.3f ms (max %.3f ms)", 
+			i, tagName.c_str(), policyNames[stats.m_policy], (unsigned long long)stats.m_numDelivered, (unsigned long long)stats.m_numDropped, 
+			stats.m_numQueued, stats.m_maxQueued, stats.m_lastLagSeconds * 1000.0, stats.m_maxLagSeconds * 1000.0));
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// False if the text files are holding lines back to try writing them again
+bool FlushLogFiles()
+{
+	bool didFlush = s_fileSink.Flush();
+
+	std::lock_guard<std::mutex> binaryWriterLock(s_binaryWriterMutex);
+	s_binaryWriter.Flush();
+	return didFlush;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool SyncLogFiles()
+{
+	bool didSync = s_fileSink.Sync();
+
+	std::lock_guard<std::mutex> binaryWriterLock(s_binaryWriterMutex);
+	s_binaryWriter.Sync();
+	return didSync;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void WakeLoggerThread()
+{
+	// Taken so the notify can't land between the worker checking for work and starting to wait
+	std::lock_guard<std::mutex> wakeLock(s_wakeMutex);
+	s_wakeCondition.notify_one();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool SpinForWork(int& spinLimit)
+{
+	int maxSpins = s_maxWorkerSpins.load(std::memory_order_relaxed);
+	if (maxSpins <= 0)
+	{
+		return false;
+	}
+
+	// Lines come in bursts, grow the spin while it keeps catching the next one and shrink it while it doesn't
+	for (int i = 0; i < spinLimit; ++i)
+	{
+		if (s_logRing.HasPending())
+		{
+			spinLimit = (spinLimit * 2 < maxSpins) ? spinLimit * 2 : maxSpins;
+			return true;
+		}
+
+		std::this_thread::yield();
+	}
+
+	spinLimit = (spinLimit / 2 > LOG_WORKER_MIN_SPINS) ? spinLimit / 2 : LOG_WORKER_MIN_SPINS;
+	return false;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// A failed write is tried again after LOG_FILE_RETRY_INTERVAL even if nothing else comes in
+void WaitForWork(bool shouldRetryWrite)
+{
+	// Pairs with the fence in EnqueueLine, either we see the new line or its producer sees us waiting
+	s_isWorkerWaiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	{
+		auto hasWork = []()
+		{
+			return s_logRing.HasPending() || !Log_IsRunning() 
+				|| s_requestedFlushPosition.load(std::memory_order_relaxed) != s_lastSeenFlushRequest 
+				|| s_requestedSyncPosition.load(std::memory_order_relaxed) != s_lastSeenSyncRequest;
+		};
+
+		std::unique_lock<std::mutex> wakeLock(s_wakeMutex);
+		if (shouldRetryWrite)
+		{
+			s_wakeCondition.wait_for(wakeLock, LOG_FILE_RETRY_INTERVAL, hasWork);
+		}
+		else
+		{
+			s_wakeCondition.wait(wakeLock, hasWork);
+		}
+	}
+
+	s_isWorkerWaiting.store(false, std::memory_order_relaxed);
+}
+
+
 //-------------------------------------------------------------------------------------------------------
 void LoggerWorkerThread_Callback(void* data)
 {
 	UNUSED(data);
+	t_isLoggerThread = true;
+	int spinLimit = LOG_WORKER_MIN_SPINS;
 
 
 	// While the logger is running
 	while(Log_IsRunning())
 	{
 		Log_DoAllWork();
-		Thread_Sleep(10);
+
+		if (SpinForWork(spinLimit))
+		{
+			continue;
+		}
+
+		// Going idle, get everything onto disk before sleeping until the next line
+		//	Log_DoAllWork leaves a flush ticket unpublished while its lines are waiting to be written again, and has just tried
+		bool isTicketWaiting = (s_flushedPosition.load(std::memory_order_relaxed) < s_lastSeenFlushRequest) || (s_syncedPosition.load(std::memory_order_relaxed) < s_lastSeenSyncRequest);
+		bool didFlush = isTicketWaiting ? false : FlushLogFiles();
+		WaitForWork(!didFlush);
 	}
 
 
@@ -258,12 +1095,64 @@ void LoggerWorkerThread_Callback(void* data)
 }
 
 
+//-------------------------------------------------------------------------------------------------------
+// Hooks queued before the worker started ran inline until now
+void StartHookQueues()
+{
+	s_hookListMutex.lock();
+
+	std::vector<LogHook>* hooks = new std::vector<LogHook>(s_hookList.GetForWriter());
+	for (int i = 0; i < (int)hooks->size(); ++i)
+	{
+		if ((*hooks)[i].m_policy != LOG_HOOK_POLICY_INLINE && (*hooks)[i].m_queue == nullptr)
+		{
+			(*hooks)[i].m_queue = new LogHookQueue((*hooks)[i]);
+		}
+	}
+	s_hookList.Publish(hooks);
+
+	s_hookListMutex.unlock();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// Once the worker is gone nothing would empty the queues, the hooks are called inline from then on
+void StopHookQueues()
+{
+	std::vector<LogHookQueue*> queues;
+
+	s_hookListMutex.lock();
+
+	std::vector<LogHook>* hooks = new std::vector<LogHook>(s_hookList.GetForWriter());
+	for (int i = 0; i < (int)hooks->size(); ++i)
+	{
+		if ((*hooks)[i].m_queue != nullptr)
+		{
+			queues.push_back((*hooks)[i].m_queue);
+			(*hooks)[i].m_queue = nullptr;
+		}
+	}
+	s_hookList.Publish(hooks);
+	s_hookList.Synchronize();
+
+	s_hookListMutex.unlock();
+
+	for (int i = 0; i < (int)queues.size(); ++i)
+	{
+		queues[i]->Stop();
+		queues[i]->Release();
+	}
+}
+
+
 //-------------------------------------------------------------------------------------------------------
 void Log_Initialize()
 {
 	FileWrite_Hook_Initialize();
-	Log_Hook(VisualStudioOutput_Hook);
-	Log_Hook(Logger_DevConsole_Hook);
+#if defined( PLATFORM_WINDOWS )
+	Log_Hook(VisualStudioOutput_Hook, nullptr, LOG_HOOK_POLICY_DROP_OLDEST);
+#endif
+	Log_Hook(Logger_DevConsole_Hook, nullptr, LOG_HOOK_POLICY_DROP_OLDEST);
 
 	RegisterCommand("Log_ShowAll",		Log_ShowAll_Command);
 	RegisterCommand("Log_HideAll",		Log_HideAll_Command);
@@ -271,165 +1160,620 @@ void Log_Initialize()
 	RegisterCommand("Log_HideTag",		Log_HideTag_Command);
 	RegisterCommand("Log_Test",			Log_Test_Command);
 	RegisterCommand("Log_FlushTest",	Log_FlushTest_Command);
+	RegisterCommand("Log_OverflowPolicy",	Log_OverflowPolicy_Command);
+	RegisterCommand("Log_Binary",		Log_Binary_Command);
+	RegisterCommand("Log_Rotation",		Log_Rotation_Command);
+	RegisterCommand("Log_Hooks",		Log_Hooks_Command);
+	RegisterCommand("Log_Benchmark",	Log_Benchmark_Command);
 
 	s_workerThread = Thread_Create(LoggerWorkerThread_Callback);
+	StartHookQueues();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void Log_Destroy()
+{
+	// Stop the worker thread
+	Log_SetRunningState(false);
+	Thread_Join(s_workerThread);
+	s_workerThread = nullptr;
+	StopHookQueues();
+
+
+	FileWrite_Hook_Destroy();
+	Log_CloseBinaryFile();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool Log_IsRunning()
+{
+	return s_isRunning.load(std::memory_order_acquire);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void Log_SetRunningState(bool isRunning)
+{
+	s_isRunning.store(isRunning, std::memory_order_release);
+	WakeLoggerThread();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void Log_SetMaxWorkerSpins(int maxSpins)
+{
+	s_maxWorkerSpins.store(maxSpins, std::memory_order_relaxed);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+int Log_GetMaxWorkerSpins()
+{
+	return s_maxWorkerSpins.load(std::memory_order_relaxed);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void Log_SetFileRotation(uint64_t maxSegmentBytes, double maxSegmentSeconds, int maxSegmentsKept)
+{
+	s_maxLogSegmentBytes.store(maxSegmentBytes);
+	s_maxLogSegmentSeconds.store(maxSegmentSeconds);
+	s_maxLogSegmentsKept.store(maxSegmentsKept);
+
+	s_fileSink.SetRotation(maxSegmentBytes, maxSegmentSeconds, maxSegmentsKept);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool IsTagShown(const LogTagFilter& filter, char const* tag)
+{
+	bool isValid = false;
+
+
+	// Not so critical section
+	if (filter.m_isWhiteList)
+	{
+		// Whitelist so default to false
+		isValid = false; 
+
+		// If the tag is present in the list we are good
+		for (int i = 0; i < (int)filter.m_tags.size(); ++i)
+		{
+			if (filter.m_tags[i] == tag)
+			{
+				isValid = true;
+				break;
+			}
+		}
+	}
+	else
+	{
+		// Blacklist so default to true
+		isValid = true;
+
+		// If the tag is NOT present in the list we are good
+		for (int i = 0; i < (int)filter.m_tags.size(); ++i)
+		{
+			if (filter.m_tags[i] == tag)
+			{
+				isValid = false;
+				break;
+			}
+		}
+	}
+
+
+	return isValid;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+uint32_t HashTagName(char const* tag)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (const char* character = tag; *character != '\0'; ++character)
+	{
+		hash = (hash ^ (uint8_t)*character) * 16777619u;
+	}
+
+	return hash;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+// LOG_MAX_TAGS if the tag hasn't been interned
+int FindTagID(char const* tag, uint32_t hash)
+{
+	for (uint32_t probe = 0; probe < LOG_TAG_TABLE_SIZE; ++probe)
+	{
+		uint32_t entry = s_tagTable[(hash + probe) & (LOG_TAG_TABLE_SIZE - 1)].load(std::memory_order_acquire);
+		if (entry == 0)
+		{
+			break;
+		}
+
+		if (s_tagNames[entry - 1] == tag)
+		{
+			return (int)entry - 1;
+		}
+	}
+
+	return LOG_MAX_TAGS;
 }
 
 
-//-------------------------------------------------------------------------------------------------------
-void Log_Destroy()
-{
-	// Stop the worker thread
-	Log_SetRunningState(false);
-	Thread_Join(s_workerThread);
-	s_workerThread = nullptr;
+//-------------------------------------------------------------------------------------------------------
+// s_tagMutex must be locked, one store a word so a caller checking any one tag sees its old or new state
+void RebuildShownTags_Locked()
+{
+	const LogTagFilter& filter = s_tagFilter.GetForWriter();
+	uint64_t shownTags[LOG_MAX_TAGS / 64] = {};
+	for (int tagID = 0; tagID < s_numTags; ++tagID)
+	{
+		if (IsTagShown(filter, s_tagNames[tagID].c_str()))
+		{
+			shownTags[tagID >> 6] |= 1ULL << (tagID & 63);
+		}
+	}
+	shownTags[LOG_OVERFLOW_TAG_ID >> 6] |= 1ULL << (LOG_OVERFLOW_TAG_ID & 63);
+
+	for (int i = 0; i < LOG_MAX_TAGS / 64; ++i)
+	{
+		g_logShownTags[i].store(shownTags[i], std::memory_order_relaxed);
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+LogTagID Log_InternTag(char const* tag)
+{
+	uint32_t hash = HashTagName(tag);
+	int tagID = FindTagID(tag, hash);
+	if (tagID != LOG_MAX_TAGS)
+	{
+		return (LogTagID)tagID;
+	}
+
+	s_tagMutex.lock();
+
+	// Critical Section
+	// Someone may have added it while we waited
+	tagID = FindTagID(tag, hash);
+	if (tagID == LOG_MAX_TAGS)
+	{
+		if (s_numTags < LOG_OVERFLOW_TAG_ID)
+		{
+			tagID = s_numTags;
+			s_tagNames[tagID] = tag;
+			++s_numTags;
+
+			if (IsTagShown(s_tagFilter.GetForWriter(), tag))
+			{
+				g_logShownTags[tagID >> 6].fetch_or(1ULL << (tagID & 63), std::memory_order_relaxed);
+			}
+
+			// Published last, the name has to be there before anyone can find it
+			uint32_t slot = hash;
+			while (s_tagTable[slot & (LOG_TAG_TABLE_SIZE - 1)].load(std::memory_order_relaxed) != 0)
+			{
+				++slot;
+			}
+			s_tagTable[slot & (LOG_TAG_TABLE_SIZE - 1)].store((uint32_t)tagID + 1, std::memory_order_release);
+		}
+		else
+		{
+			tagID = LOG_OVERFLOW_TAG_ID;
+		}
+	}
+
+	s_tagMutex.unlock();
+	return (LogTagID)tagID;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+const char* Log_GetTagName(LogTagID tagID)
+{
+	// Names never change once their ID is handed out
+	return (tagID < LOG_OVERFLOW_TAG_ID) ? s_tagNames[tagID].c_str() : "";
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool Log_IsTagShown(char const* tag)
+{
+	LogTagID tagID = Log_InternTag(tag);
+	if (tagID != LOG_OVERFLOW_TAG_ID)
+	{
+		return Log_IsTagIDShown(tagID);
+	}
+
+	// Past the last ID, check the lists by name
+	LogSnapshot<LogTagFilter>::Reader filter(s_tagFilter);
+	return IsTagShown(*filter, tag);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void LogHookQueue::ConsumerThread_Callback(void* data)
+{
+	LogHookQueue* queue = (LogHookQueue*)data;
+	t_isHookThread = true;
+	std::vector<Log_LogEntry> batch(LOG_HOOK_QUEUE_BATCH_SIZE);
+
+	std::unique_lock<std::mutex> queueLock(queue->m_mutex);
+	while (true)
+	{
+		if (queue->m_numQueued == 0)
+		{
+			if (queue->m_isStopping)
+			{
+				break;
+			}
+
+			queue->m_isConsumerWaiting = true;
+			queue->m_hasEntriesCondition.wait(queueLock, [queue]() { return queue->m_numQueued > 0 || queue->m_isStopping; });
+			queue->m_isConsumerWaiting = false;
+			continue;
+		}
+
+		// Swapped out so the slots get these entries' strings to reuse
+		uint32_t batchSize = (queue->m_numQueued < LOG_HOOK_QUEUE_BATCH_SIZE) ? queue->m_numQueued : LOG_HOOK_QUEUE_BATCH_SIZE;
+		for (uint32_t i = 0; i < batchSize; ++i)
+		{
+			std::swap(batch[i], queue->m_entries[queue->m_head]);
+			queue->m_head = (queue->m_head + 1) % LOG_HOOK_QUEUE_CAPACITY;
+		}
+		bool wasFull = (queue->m_numQueued == LOG_HOOK_QUEUE_CAPACITY);
+		queue->m_numQueued -= batchSize;
+		queueLock.unlock();
+
+		if (wasFull)
+		{
+			queue->m_hasRoomCondition.notify_one();
+		}
+
+		uint64_t maxLagHPC = 0;
+		uint64_t lagHPC = 0;
+		for (uint32_t i = 0; i < batchSize; ++i)
+		{
+			queue->m_callback(batch[i], queue->m_userData);
 
+			uint64_t nowHPC = GetCurrentTimeInHPC();
+			lagHPC = (nowHPC > batch[i].m_timeHPC) ? nowHPC - batch[i].m_timeHPC : 0;
+			maxLagHPC = (lagHPC > maxLagHPC) ? lagHPC : maxLagHPC;
+		}
 
-	FileWrite_Hook_Destroy();
+		queueLock.lock();
+		queue->m_numDelivered += batchSize;
+		queue->m_lastLagHPC = lagHPC;
+		queue->m_maxLagHPC = (maxLagHPC > queue->m_maxLagHPC) ? maxLagHPC : queue->m_maxLagHPC;
+		if (queue->m_numDeliveryWaiters > 0)
+		{
+			queue->m_deliveredCondition.notify_all();
+		}
+	}
 }
 
 
 //-------------------------------------------------------------------------------------------------------
-bool Log_IsRunning()
+bool HasValidTag(const Log_LogEntry& entry)
 {
-	return s_isRunning;
+	// Checked again in case the filter changed while the line was queued
+	if (entry.m_tagID != LOG_OVERFLOW_TAG_ID)
+	{
+		return Log_IsTagIDShown(entry.m_tagID);
+	}
+
+	return Log_IsTagShown(entry.m_tag.c_str());
 }
 
 
 //-------------------------------------------------------------------------------------------------------
-void Log_SetRunningState(bool isRunning)
+void ProcessEntry(const Log_LogEntry& entry, const std::vector<LogHook>& hooks)
 {
-	s_isRunning = isRunning;
+	bool hasValidTag = HasValidTag(entry);
+	if (hasValidTag)
+	{
+		// A tag with hooks of its own only goes to those, the overflow ID is never hooked
+		LogTagID hookTagID = LOG_HOOK_ALL_TAGS;
+		for (int i = 0; i < (int)hooks.size(); ++i)
+		{
+			if (hooks[i].m_tagID == entry.m_tagID)
+			{
+				hookTagID = entry.m_tagID;
+				break;
+			}
+		}
+
+		// Not so critical section
+		for (int i = 0; i < (int)hooks.size(); ++i)
+		{
+			if (hooks[i].m_tagID != hookTagID)
+			{
+				continue;
+			}
+
+			// Call all callbacks with this entry, queued hooks get a copy to call it with on their own thread
+			if (hooks[i].m_queue != nullptr)
+			{
+				hooks[i].m_queue->Push(entry);
+			}
+			else
+			{
+				hooks[i].m_callback(entry, hooks[i].m_userData);
+			}
+		}
+	}
 }
 
 
 //-------------------------------------------------------------------------------------------------------
-bool HasValidTag(const Log_LogEntry& entry)
+void Log_DoAllWork()
 {
-	bool isValid = false;
-	s_tagMutex.LockForRead();
-
-
-	// Not so critical section
-	if (s_isWhiteList)
+	// Copied out before the hooks run so the slot goes back to the producers straight away
+	//	The hook list is pinned once a batch instead of once a line, short batches keep Log_Hook from waiting long
+	Log_LogEntry entry;
+	bool isRingEmpty = false;
+	while (!isRingEmpty)
 	{
-		// Whitelist so default to false
-		isValid = false; 
+		LogHookList::Reader hooks(s_hookList);
 
-		// If the tag is present in the list we are good
-		for (int i = 0; i < (int)s_tags.size(); ++i)
+		for (int i = 0; i < LOG_WORKER_BATCH_SIZE; ++i)
 		{
-			if (s_tags[i] == entry.m_tag)
+			if (!s_logRing.TryDequeue(&entry))
 			{
-				isValid = true;
+				isRingEmpty = true;
 				break;
 			}
+
+			ProcessEntry(entry, *hooks); 
+		}
+
+		for (int i = 0; i < (int)hooks->size(); ++i)
+		{
+			if ((*hooks)[i].m_queue != nullptr)
+			{
+				(*hooks)[i].m_queue->Wake();
+			}
 		}
 	}
-	else
+
+	// Read after draining so a request that came in meanwhile is covered by this flush when it can be
+	uint64_t requestedFlushPosition = s_requestedFlushPosition.load(std::memory_order_acquire);
+	uint64_t requestedSyncPosition = s_requestedSyncPosition.load(std::memory_order_acquire);
+	s_lastSeenFlushRequest = requestedFlushPosition;
+	s_lastSeenSyncRequest = requestedSyncPosition;
+
+	bool shouldFlush = requestedFlushPosition > s_flushedPosition.load(std::memory_order_relaxed);
+	bool shouldSync = requestedSyncPosition > s_syncedPosition.load(std::memory_order_relaxed);
+	if (shouldFlush || shouldSync)
 	{
-		// Blacklist so default to true
-		isValid = true;
+		// A line claimed but still being copied in stops the drain short of some tickets, its producer wakes us again
+		uint64_t position = s_logRing.GetNumDequeued();
+
+		// Not published past lines a failed write is still holding, the worker tries again shortly and the file sink gives up after a few tries
+		bool didFlush = FlushLogFiles();
+		if (shouldSync)
+		{
+			didFlush = SyncLogFiles() && didFlush;
+		}
+		if (!didFlush)
+		{
+			return;
+		}
 
-		// If the tag is NOT present in the list we are good
-		for (int i = 0; i < (int)s_tags.size(); ++i)
 		{
-			if (s_tags[i] == entry.m_tag)
+			std::lock_guard<std::mutex> flushLock(s_flushMutex);
+			s_flushedPosition.store(position, std::memory_order_release);
+			if (shouldSync)
 			{
-				isValid = false;
-				break;
+				s_syncedPosition.store(position, std::memory_order_release);
 			}
 		}
+		s_flushCondition.notify_all();
 	}
+}
 
 
-	s_tagMutex.UnlockForRead();
-	return isValid;
+//-------------------------------------------------------------------------------------------------------
+void RequestPosition(std::atomic<uint64_t>& requestedPosition, uint64_t position)
+{
+	// Only ever raised, a later ticket covers every earlier one
+	uint64_t currentPosition = requestedPosition.load(std::memory_order_relaxed);
+	while (currentPosition < position && !requestedPosition.compare_exchange_weak(currentPosition, position, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
 }
 
 
 //-------------------------------------------------------------------------------------------------------
-void ProcessEntry(const Log_LogEntry& entry)
+void Log_Flush(bool shouldSyncToDisk)
 {
-	s_hookListMutex.LockForRead();
+	// Every line this thread logged, and any line logged before this call by another thread, is before the ticket
+	uint64_t ticket = s_logRing.GetNumEnqueued();
 
-	bool hasValidTag = HasValidTag(entry);
-	if (hasValidTag)
+	// Nobody to wait on, a hook calling LogError on the logger thread or logging before Log_Initialize/after Log_Destroy
+	if (t_isLoggerThread || s_workerThread == nullptr)
 	{
-		// Not so critical section
-		for (int i = 0; i < (int)s_hookList.size(); ++i)
+		if (!t_isLoggerThread)
+		{
+			Log_DoAllWork();
+		}
+
+		FlushLogFiles();
+		if (shouldSyncToDisk)
+		{
+			SyncLogFiles();
+		}
+		return;
+	}
+
+	// The logger thread could be waiting for room in this hook's queue
+	if (t_isHookThread)
+	{
+		RequestPosition(s_requestedFlushPosition, ticket);
+		if (shouldSyncToDisk)
+		{
+			RequestPosition(s_requestedSyncPosition, ticket);
+		}
+		WakeLoggerThread();
+		return;
+	}
+
+	std::atomic<uint64_t>& completedPosition = shouldSyncToDisk ? s_syncedPosition : s_flushedPosition;
+	if (completedPosition.load(std::memory_order_acquire) < ticket)
+	{
+		RequestPosition(s_requestedFlushPosition, ticket);
+		if (shouldSyncToDisk)
+		{
+			RequestPosition(s_requestedSyncPosition, ticket);
+		}
+		WakeLoggerThread();
+
+		std::unique_lock<std::mutex> flushLock(s_flushMutex);
+		s_flushCondition.wait(flushLock, [&](){ return completedPosition.load(std::memory_order_acquire) >= ticket; });
+	}
+
+	// Every line up to the ticket has been handed to the queued hooks by now, the ones that never drop get through them too
+	//	Waited on after letting go of the hook list, a slow hook shouldn't hold up Log_Hook or Log_Unhook
+	std::vector<LogHookQueue*> blockingQueues;
+	{
+		LogHookList::Reader hooks(s_hookList);
+		for (int i = 0; i < (int)hooks->size(); ++i)
 		{
-			// Call all callbacks with this entry
-			s_hookList[i].m_callback(entry, s_hookList[i].m_userData);
+			if ((*hooks)[i].m_queue != nullptr && (*hooks)[i].m_queue->GetPolicy() == LOG_HOOK_POLICY_BLOCK)
+			{
+				(*hooks)[i].m_queue->AddRef();
+				blockingQueues.push_back((*hooks)[i].m_queue);
+			}
 		}
 	}
 
-	s_hookListMutex.UnlockForRead();
+	for (int i = 0; i < (int)blockingQueues.size(); ++i)
+	{
+		blockingQueues[i]->WaitForDelivery();
+		blockingQueues[i]->Release();
+	}
 }
 
 
 //-------------------------------------------------------------------------------------------------------
-void Log_DoAllWork()
+void Log_FlushTest()
 {
-	bool shouldFlush = s_shouldFlush;
+	Log("LogFlushTest"); 
+	Log_Flush();
+	// breakpoint on this line; 
+	GUARANTEE_RECOVERABLE(false, "Flush Test");
+}
+
 
-	Log_LogEntry* entry = nullptr; 
-	while (s_logQueue.Dequeue(&entry))
+//-------------------------------------------------------------------------------------------------------
+void EnqueueLine(const char* tag, LogTagID tagID, const char* format, const char* text, size_t textLength)
+{
+	if (t_logThreadID == 0)
 	{
-		ProcessEntry(*entry); 
-		delete entry; 
+		t_logThreadID = s_numLogThreads.fetch_add(1, std::memory_order_relaxed) + 1;
 	}
 
-	if (shouldFlush)
+	LogLineInfo info;
+	info.m_tag = tag;
+	info.m_tagID = tagID;
+	info.m_format = format;
+	info.m_timeHPC = GetCurrentTimeInHPC();
+	info.m_threadID = t_logThreadID;
+
+	while (!s_logRing.TryEnqueue(info, text, textLength))
 	{
-		if (s_logFile.is_open())
+		eLogOverflowPolicy policy = (eLogOverflowPolicy)s_overflowPolicy.load(std::memory_order_relaxed);
+
+		if (policy == LOG_OVERFLOW_POLICY_DROP_OLDEST)
+		{
+			// Make room and try again, the logger thread may have made room first
+			if (s_logRing.TryDequeue(nullptr))
+			{
+				s_numDroppedLines.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		else if (policy == LOG_OVERFLOW_POLICY_DROP_NEWEST || t_isLoggerThread || t_isHookThread || s_workerThread == nullptr)
 		{
-			s_logFile.flush();
+			// Blocking only makes sense while the logger thread is there to make room, and isn't waiting on this thread
+			s_numDroppedLines.fetch_add(1, std::memory_order_relaxed);
+			return;
 		}
-
-		if (s_logFile_Timestamped.is_open())
+		else
 		{
-			s_logFile_Timestamped.flush();
+			std::this_thread::yield();
 		}
+	}
 
-		s_shouldFlush = false;
+	// Pairs with the fence in WaitForWork, only the first producer to see the worker asleep pays for the wake
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (s_isWorkerWaiting.load(std::memory_order_relaxed) && s_isWorkerWaiting.exchange(false, std::memory_order_relaxed))
+	{
+		WakeLoggerThread();
 	}
 }
 
 
 //-------------------------------------------------------------------------------------------------------
-void Log_Flush()
+void LogTagged_Interned_va(const char* tag, LogTagID tagID, const char* format, va_list args)
 {
-	s_shouldFlush = true;
+	// Tags past LOG_MAX_TAGS are always shown here, the logger thread checks them by name
+	if (!Log_IsTagIDShown(tagID))
+	{
+		return;
+	}
+
+	// Formatted on the stack, the ring copies it into its slot
+	va_list argsCopy;
+	va_copy(argsCopy, args);
 
-	//Log_DoAllWork();
-	while(s_shouldFlush)
+	char text[LOG_SLOT_TEXT_CAPACITY];
+	int textLength = vsnprintf(text, sizeof(text), format, args);
+	if (textLength < 0)
+	{
+		textLength = 0;
+	}
+
+	if ((size_t)textLength < sizeof(text))
+	{
+		EnqueueLine(tag, tagID, nullptr, text, (size_t)textLength);
+	}
+	else
 	{
-		// Wait
+		std::string longText = Stringf_va(format, argsCopy);
+		EnqueueLine(tag, tagID, nullptr, longText.data(), longText.size());
 	}
 
-	return;
+	va_end(argsCopy);
 }
 
 
 //-------------------------------------------------------------------------------------------------------
-void Log_FlushTest()
+void LogTagged_va(char const* tag, char const* format, va_list args)
 {
-	Log("LogFlushTest"); 
-	Log_Flush();
-	// breakpoint on this line; 
-	GUARANTEE_RECOVERABLE(false, "Flush Test");
+	LogTagged_Interned_va(tag, Log_InternTag(tag), format, args);
 }
 
 
 //-------------------------------------------------------------------------------------------------------
-void LogTagged_va(char const* tag, char const* format, va_list args)
+void LogTagged_Interned(const char* tag, LogTagID tagID, const char* format, ...)
 {
-	Log_LogEntry* entry = new Log_LogEntry();
-	entry->m_tag = tag;
-	entry->m_text = Stringf_va(format, args);
+	va_list variableArgumentList;
+	va_start( variableArgumentList, format );
+	LogTagged_Interned_va(tag, tagID, format, variableArgumentList);
+	va_end( variableArgumentList );
+}
+
 
-	s_logQueue.Enqueue(entry);
+//-------------------------------------------------------------------------------------------------------
+void LogTagged_Captured(const char* tag, LogTagID tagID, const char* format, const char* arguments, size_t argumentsSize)
+{
+	EnqueueLine(tag, tagID, format, arguments, argumentsSize);
 }
 
 
@@ -446,9 +1790,11 @@ void LogTagged(const char* tag, const char* format, ...)
 //-------------------------------------------------------------------------------------------------------
 void Log(const char* format, ...)
 {
+	static const LogTagID s_tagID = Log_InternTag("LOG");
+
 	va_list variableArgumentList;
 	va_start( variableArgumentList, format );
-	LogTagged_va("LOG", format, variableArgumentList);
+	LogTagged_Interned_va("LOG", s_tagID, format, variableArgumentList);
 	va_end( variableArgumentList );
 }
 
@@ -456,9 +1802,11 @@ void Log(const char* format, ...)
 //-------------------------------------------------------------------------------------------------------
 void LogDebug(const char* format, ...)
 {
+	static const LogTagID s_tagID = Log_InternTag("DEBUG");
+
 	va_list variableArgumentList;
 	va_start( variableArgumentList, format );
-	LogTagged_va("DEBUG", format, variableArgumentList);
+	LogTagged_Interned_va("DEBUG", s_tagID, format, variableArgumentList);
 	va_end( variableArgumentList );
 }
 
@@ -466,9 +1814,11 @@ void LogDebug(const char* format, ...)
 //-------------------------------------------------------------------------------------------------------
 void LogWarning(char const *format, ...)
 {
+	static const LogTagID s_tagID = Log_InternTag("WARNING");
+
 	va_list variableArgumentList;
 	va_start( variableArgumentList, format );
-	LogTagged_va("WARNING", format, variableArgumentList);
+	LogTagged_Interned_va("WARNING", s_tagID, format, variableArgumentList);
 	va_end( variableArgumentList );
 }
 
@@ -476,57 +1826,111 @@ void LogWarning(char const *format, ...)
 //-------------------------------------------------------------------------------------------------------
 void LogError(char const *format, ...)
 {
+	static const LogTagID s_tagID = Log_InternTag("ERROR");
+
 	va_list variableArgumentList;
 	va_start( variableArgumentList, format );
-	LogTagged_va("ERROR", format, variableArgumentList);
+	LogTagged_Interned_va("ERROR", s_tagID, format, variableArgumentList);
 	va_end( variableArgumentList );
 
-	Log_Flush();
+	// On disk before the process goes down
+	Log_Flush(true);
 	GUARANTEE_OR_DIE(false, "Log Error");
 }
 
 
+//-------------------------------------------------------------------------------------------------------
+void Log_SetOverflowPolicy(eLogOverflowPolicy policy)
+{
+	GUARANTEE_OR_DIE(policy > LOG_OVERFLOW_POLICY_INVALID && policy < LOG_OVERFLOW_POLICY_COUNT, "Invalid log overflow policy");
+
+	s_overflowPolicy.store(policy, std::memory_order_relaxed);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+eLogOverflowPolicy Log_GetOverflowPolicy()
+{
+	return (eLogOverflowPolicy)s_overflowPolicy.load(std::memory_order_relaxed);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+uint64_t Log_GetNumLoggedLines()
+{
+	return s_logRing.GetNumEnqueued();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+uint64_t Log_GetNumDroppedLines()
+{
+	return s_numDroppedLines.load(std::memory_order_relaxed);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+uint64_t Log_GetNumFileWriteErrors()
+{
+	return s_fileSink.GetNumWriteErrors();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+uint64_t Log_GetNumLostFileBytes()
+{
+	return s_fileSink.GetNumLostBytes();
+}
+
+
 //-------------------------------------------------------------------------------------------------------
 void Log_ShowAll()
 {
-	s_tagMutex.LockForWrite();
+	s_tagMutex.lock();
 
 	// Critical Section
-	s_tags.clear();
-	s_isWhiteList = false;
+	LogTagFilter* filter = new LogTagFilter(s_tagFilter.GetForWriter());
+	filter->m_tags.clear();
+	filter->m_isWhiteList = false;
 
-	s_tagMutex.UnlockForWrite();
+	s_tagFilter.Publish(filter);
+	RebuildShownTags_Locked();
+	s_tagMutex.unlock();
 }
 
 
 //-------------------------------------------------------------------------------------------------------
 void Log_HideAll()
 {
-	s_tagMutex.LockForWrite();
+	s_tagMutex.lock();
 
 	// Critical Section
-	s_tags.clear();
-	s_isWhiteList = true;
+	LogTagFilter* filter = new LogTagFilter(s_tagFilter.GetForWriter());
+	filter->m_tags.clear();
+	filter->m_isWhiteList = true;
 
-	s_tagMutex.UnlockForWrite();
+	s_tagFilter.Publish(filter);
+	RebuildShownTags_Locked();
+	s_tagMutex.unlock();
 }
 
 
 //-------------------------------------------------------------------------------------------------------
 void Log_ShowTag(char const* tag)
 {
-	s_tagMutex.LockForWrite();
+	s_tagMutex.lock();
 
 	// Critical Section
-	if (!s_isWhiteList)
+	LogTagFilter* filter = new LogTagFilter(s_tagFilter.GetForWriter());
+	if (!filter->m_isWhiteList)
 	{
 		// As blacklist
-		for (int i = 0; i < (int)s_tags.size(); ++i)
+		for (int i = 0; i < (int)filter->m_tags.size(); ++i)
 		{
 			// If the tag exists in the list remove it
-			if (s_tags[i] == tag)
+			if (filter->m_tags[i] == tag)
 			{
-				s_tags.erase(s_tags.begin() + i);
+				filter->m_tags.erase(filter->m_tags.begin() + i);
 				break;
 			}
 		}
@@ -537,9 +1941,9 @@ void Log_ShowTag(char const* tag)
 
 		// Look for the tag in the list
 		bool isPresent = false;
-		for (int i = 0; i < (int)s_tags.size(); ++i)
+		for (int i = 0; i < (int)filter->m_tags.size(); ++i)
 		{
-			if (s_tags[i] == tag)
+			if (filter->m_tags[i] == tag)
 			{
 				isPresent = true;
 			}
@@ -548,29 +1952,32 @@ void Log_ShowTag(char const* tag)
 		// If it doesn't exist add it
 		if (!isPresent)
 		{
-			s_tags.push_back(tag);
+			filter->m_tags.push_back(tag);
 		}
 	}
 
-	s_tagMutex.UnlockForWrite();
+	s_tagFilter.Publish(filter);
+	RebuildShownTags_Locked();
+	s_tagMutex.unlock();
 }
 
 
 //-------------------------------------------------------------------------------------------------------
 void Log_HideTag(char const* tag)
 {
-	s_tagMutex.LockForWrite();
+	s_tagMutex.lock();
 
 	// Critical Section
-	if (!s_isWhiteList)
+	LogTagFilter* filter = new LogTagFilter(s_tagFilter.GetForWriter());
+	if (!filter->m_isWhiteList)
 	{
 		// As blacklist
 
 		// Look for the tag in the list
 		bool isPresent = false;
-		for (int i = 0; i < (int)s_tags.size(); ++i)
+		for (int i = 0; i < (int)filter->m_tags.size(); ++i)
 		{
-			if (s_tags[i] == tag)
+			if (filter->m_tags[i] == tag)
 			{
 				isPresent = true;
 			}
@@ -579,58 +1986,199 @@ void Log_HideTag(char const* tag)
 		// If it doesn't exist add it
 		if (!isPresent)
 		{
-			s_tags.push_back(tag);
+			filter->m_tags.push_back(tag);
 		}
 		
 	}
 	else
 	{
 		// As whitelist
-		for (int i = 0; i < (int)s_tags.size(); ++i)
+		for (int i = 0; i < (int)filter->m_tags.size(); ++i)
 		{
 			// If the tag exists in the list remove it
-			if (s_tags[i] == tag)
+			if (filter->m_tags[i] == tag)
 			{
-				s_tags.erase(s_tags.begin() + i);
+				filter->m_tags.erase(filter->m_tags.begin() + i);
 				break;
 			}
 		}
 	}
 
-	s_tagMutex.UnlockForWrite();
+	s_tagFilter.Publish(filter);
+	RebuildShownTags_Locked();
+	s_tagMutex.unlock();
 }
 
 
 //-------------------------------------------------------------------------------------------------------
-void Log_Hook(Log_Callback callback, void* userData)
+void AddHook(LogHook& hook)
 {
-	s_hookListMutex.LockForWrite();
+	// Started outside the lock, without a worker there's nothing to queue behind
+	if (hook.m_policy != LOG_HOOK_POLICY_INLINE && s_workerThread != nullptr)
+	{
+		hook.m_queue = new LogHookQueue(hook);
+	}
+
+	s_hookListMutex.lock();
 
 	// Critical Section
+	std::vector<LogHook>* hooks = new std::vector<LogHook>(s_hookList.GetForWriter());
+	hooks->push_back(hook);
+	s_hookList.Publish(hooks);
+
+	s_hookListMutex.unlock();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void Log_Hook(Log_Callback callback, void* userData, eLogHookPolicy policy)
+{
 	LogHook hook;
 	hook.m_callback = callback;
 	hook.m_userData = userData;
-	s_hookList.push_back(hook);
+	hook.m_policy = policy;
+	AddHook(hook);
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool Log_HookTag(char const* tag, Log_Callback callback, void* userData, eLogHookPolicy policy)
+{
+	// Tags past the limit share one ID, hooking it would take all of them
+	LogTagID tagID = Log_InternTag(tag);
+	if (tagID == LOG_OVERFLOW_TAG_ID)
+	{
+		return false;
+	}
 
-	s_hookListMutex.UnlockForWrite();
+	LogHook hook;
+	hook.m_callback = callback;
+	hook.m_userData = userData;
+	hook.m_policy = policy;
+	hook.m_tagID = tagID;
+	AddHook(hook);
+	return true;
 }
 
 
 //-------------------------------------------------------------------------------------------------------
 void Log_Unhook(Log_Callback callback, void* userData)
 {
-	s_hookListMutex.LockForWrite();
+	LogHookQueue* queue = nullptr;
+
+	s_hookListMutex.lock();
 
 	// Critical Section
-	for (int i = 0; i < (int)s_hookList.size(); ++i)
+	std::vector<LogHook>* hooks = new std::vector<LogHook>(s_hookList.GetForWriter());
+	for (int i = 0; i < (int)hooks->size(); ++i)
 	{
 		// Remove the callback if it exists
-		if (s_hookList[i].m_callback == callback && s_hookList[i].m_userData == userData)
+		if ((*hooks)[i].m_callback == callback && (*hooks)[i].m_userData == userData)
+		{
+			queue = (*hooks)[i].m_queue;
+			hooks->erase(hooks->begin() + i);
+			break;
+		}
+	}
+	s_hookList.Publish(hooks);
+	s_hookList.Synchronize();
+
+	s_hookListMutex.unlock();
+
+	// Once synchronized nothing is still calling it or queueing for it, the lines already queued are still delivered
+	if (queue != nullptr)
+	{
+		queue->Stop();
+		queue->Release();
+	}
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool Log_GetHookStats(Log_Callback callback, void* userData, LogHookStats& outStats)
+{
+	bool isHooked = false;
+
+	LogHookList::Reader hooks(s_hookList);
+	for (int i = 0; i < (int)hooks->size(); ++i)
+	{
+		const LogHook& hook = (*hooks)[i];
+		if (hook.m_callback == callback && hook.m_userData == userData)
 		{
-			s_hookList.erase(s_hookList.begin() + i);
+			outStats = LogHookStats();
+			outStats.m_policy = hook.m_policy;
+			if (hook.m_queue != nullptr)
+			{
+				hook.m_queue->GetStats(outStats);
+			}
+
+			isHooked = true;
 			break;
 		}
 	}
 
-	s_hookListMutex.UnlockForWrite();
+	return isHooked;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool Log_OpenBinaryFile(const std::string& filepath)
+{
+	{
+		std::lock_guard<std::mutex> binaryWriterLock(s_binaryWriterMutex);
+
+		if (s_binaryWriter.IsOpen())
+		{
+			return false;
+		}
+
+		if (!GetFolderPath(filepath).empty() && !DoesFolderExist(GetFolderPath(filepath)))
+		{
+			CreateFolder(GetFolderPath(filepath));
+		}
+
+		// Converted through a big count, one tick on its own rounds badly
+		const uint64_t TICKS_FOR_RATE = 1000000000ULL;
+		double secondsPerTick = ConvertHPCtoSeconds(TICKS_FOR_RATE) / (double)TICKS_FOR_RATE;
+		if (!s_binaryWriter.Open(filepath, secondsPerTick, GetCurrentTimeInHPC()))
+		{
+			return false;
+		}
+	}
+
+	Log_Hook(Logger_BinaryWrite_Hook, (void*)&s_binaryWriter, LOG_HOOK_POLICY_INLINE);
+	return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+void Log_CloseBinaryFile()
+{
+	// Once unhooked the worker can't be part way through a write
+	Log_Unhook(Logger_BinaryWrite_Hook, (void*)&s_binaryWriter);
+
+	std::lock_guard<std::mutex> binaryWriterLock(s_binaryWriterMutex);
+	s_binaryWriter.Close();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+bool Log_IsBinaryFileOpen()
+{
+	std::lock_guard<std::mutex> binaryWriterLock(s_binaryWriterMutex);
+	return s_binaryWriter.IsOpen();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+uint64_t Log_GetNumBinaryWriteErrors()
+{
+	return s_binaryWriter.GetNumWriteErrors();
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+uint64_t Log_GetNumLostBinaryBytes()
+{
+	return s_binaryWriter.GetNumLostBytes();
 }
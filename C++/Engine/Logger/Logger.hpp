@@ -2,20 +2,79 @@
 
 #include <string>
 #include <functional>
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 
+typedef uint16_t LogTagID;
 struct Log_LogEntry
 {
 	std::string m_tag; 
 	std::string m_text; 
+
+	// Captured by the calling thread
+	uint64_t	m_timeHPC		= 0;
+	uint32_t	m_threadID		= 0;		// Small and dense, handed out in the order threads first log
+	LogTagID	m_tagID			= 0;
+
+	// Deferred lines only, m_text is already formatted for hooks that just want text
+	const char*	m_format		= nullptr;	// The string literal it was logged with
+	std::string	m_arguments;				// Captured arguments, see LogArgumentBuffer
+};
+
+
+// What a log call does when the queue is full
+enum eLogOverflowPolicy
+{
+	LOG_OVERFLOW_POLICY_INVALID = -1,
+
+	LOG_OVERFLOW_POLICY_BLOCK = 0,		// Wait for the logger thread to make room, nothing is lost
+	LOG_OVERFLOW_POLICY_DROP_NEWEST,	// Throw the new line away
+	LOG_OVERFLOW_POLICY_DROP_OLDEST,	// Throw the oldest queued line away to make room
+
+	LOG_OVERFLOW_POLICY_COUNT
+};
+
+
+// Where a hook is called, and what the logger does when a queued hook falls behind
+enum eLogHookPolicy
+{
+	LOG_HOOK_POLICY_INVALID = -1,
+
+	LOG_HOOK_POLICY_INLINE = 0,			// On the logger thread, in step with the log files
+	LOG_HOOK_POLICY_BLOCK,				// On its own thread from its own queue, the logger thread waits for room when it's full, nothing is lost
+	LOG_HOOK_POLICY_DROP_NEWEST,		// On its own thread from its own queue, new lines are thrown away when it's full
+	LOG_HOOK_POLICY_DROP_OLDEST,		// On its own thread from its own queue, the oldest queued line is thrown away when it's full
+
+	LOG_HOOK_POLICY_COUNT
 };
 
 
+class LogHookQueue;
 typedef void (*Log_Callback)(const Log_LogEntry& entry, void* userData); 
+constexpr LogTagID LOG_HOOK_ALL_TAGS = 0xFFFF;
 struct LogHook
 {
 	Log_Callback	m_callback;
 	void*			m_userData = nullptr;
+	eLogHookPolicy	m_policy = LOG_HOOK_POLICY_INLINE;
+	LogHookQueue*	m_queue = nullptr;		// Queued hooks while the logger is running
+	LogTagID		m_tagID = LOG_HOOK_ALL_TAGS;	// Only lines with this tag, see Log_HookTag
+};
+
+
+struct LogHookStats
+{
+	eLogHookPolicy	m_policy			= LOG_HOOK_POLICY_INVALID;
+	uint64_t		m_numDelivered		= 0;
+	uint64_t		m_numDropped		= 0;
+	uint32_t		m_numQueued			= 0;
+	uint32_t		m_maxQueued			= 0;
+	double			m_lastLagSeconds	= 0.0;	// From the log call to the hook being called with the line
+	double			m_maxLagSeconds		= 0.0;
 };
 
 
@@ -29,9 +88,26 @@ void Log_Destroy();
 bool Log_IsRunning();
 void Log_SetRunningState(bool isRunning);
 
+// Worker
+// NOTE: The logger thread sleeps until a line arrives, after a burst it spins (yielding) for up to this many checks before sleeping again, 0 never spins
+void	Log_SetMaxWorkerSpins(int maxSpins);
+int		Log_GetMaxWorkerSpins();
+
+// File Rotation
+// NOTE: log.txt and its timestamped copy move to "<filepath>.<N>" once they pass the size or age limit, 0 turns a limit off
+//		 Closed segments are compressed and the oldest past maxSegmentsKept deleted on a low priority thread, never the logger thread
+//		 Defaults to 64 MB segments with the newest 32 kept
+void Log_SetFileRotation(uint64_t maxSegmentBytes, double maxSegmentSeconds, int maxSegmentsKept);
+
+// File Errors
+// NOTE: Lines a write failed on stay buffered and are written again, Log_Flush waits for them
+//		 After a few failures in a row, or once new lines need the room, they're thrown away and counted as lost
+uint64_t Log_GetNumFileWriteErrors();
+uint64_t Log_GetNumLostFileBytes();
+
 // Flush
 void Log_DoAllWork();
-void Log_Flush();
+void Log_Flush(bool shouldSyncToDisk = false);	// Blocks until every line logged before the call has been written out, or synced to disk for crash logs
 void Log_FlushTest();
 
 // Logging
@@ -42,12 +118,174 @@ void LogError(char const *format, ...);
 void LogTagged(const char* tag, const char* format, ...);
 void LogTagged_va(char const *tag, char const *format, va_list args);
 
+// Interned Tags
+// NOTE: LogTagged looks its tag up on every call, these take the ID Log_InternTag gave for it instead
+//		 LOG_TAGGED keeps the ID in a static at each call site, so its tag has to be a string literal
+#define LOG_TAGGED(tag, format, ...)	do { static const LogTagID s_logCallSiteTagID = Log_InternTag("" tag); LogTagged_Interned(tag, s_logCallSiteTagID, format, ##__VA_ARGS__); } while (0)
+void LogTagged_Interned(const char* tag, LogTagID tagID, const char* format, ...);
+void LogTagged_Interned_va(const char* tag, LogTagID tagID, const char* format, va_list args);
+
+// Deferred Logging
+// NOTE: Only the arguments are copied on the calling thread, printf formatting happens on the logger thread
+//		 The format has to be a string literal since the line is formatted after the call returns, and binary files key formats on their address
+//		 The macros paste "" in front of it so anything else (a char array on the stack, a std::string's c_str()) doesn't compile
+//		 Like LOG_TAGGED the tag is interned once per call site, it has to be a literal too
+//		 Arguments can be any number, bool, enum, pointer, C string or std::string, strings are copied
+#define LOG_DEFERRED(format, ...)				LOG_TAGGED_DEFERRED("LOG", format, ##__VA_ARGS__)
+#define LOG_TAGGED_DEFERRED(tag, format, ...)	do { static const LogTagID s_logCallSiteTagID = Log_InternTag("" tag); LogTagged_Deferred(tag, s_logCallSiteTagID, "" format, ##__VA_ARGS__); } while (0)
+
+// Queue
+// NOTE: Lines are formatted by the caller straight into fixed size slots of a bounded lock free ring, only lines too long for a slot allocate
+void				Log_SetOverflowPolicy(eLogOverflowPolicy policy);
+eLogOverflowPolicy	Log_GetOverflowPolicy();
+uint64_t			Log_GetNumLoggedLines();	// Every line that made it into the queue
+uint64_t			Log_GetNumDroppedLines();	// Every line an overflow policy threw away
+
 // Filtering
+// NOTE: Tags are interned to small IDs with a shown bit each, checking an interned tag is a single load
+constexpr int			LOG_MAX_TAGS		= 256;
+constexpr LogTagID		LOG_OVERFLOW_TAG_ID	= LOG_MAX_TAGS - 1;	// Shared by every tag past the limit, always shown here and checked by name instead
+extern std::atomic<uint64_t> g_logShownTags[LOG_MAX_TAGS / 64];
+
+LogTagID	Log_InternTag(char const* tag);		// Same text, same ID, for the life of the process
+const char*	Log_GetTagName(LogTagID tagID);
+inline bool	Log_IsTagIDShown(LogTagID tagID) { return (g_logShownTags[tagID >> 6].load(std::memory_order_relaxed) & (1ULL << (tagID & 63))) != 0; }
+bool		Log_IsTagShown(char const* tag);	// Checked on the calling thread, hidden lines are never formatted or queued
 void Log_ShowAll(); 
 void Log_HideAll(); 
 void Log_ShowTag(char const* tag); 
 void Log_HideTag(char const* tag); 
 
 // Additional Logger Hooks
-void Log_Hook(Log_Callback callback, void* userData = nullptr); 
-void Log_Unhook(Log_Callback callback, void* userData = nullptr);
+// NOTE: Queued hooks each get their own thread, Log_Flush waits for the inline and blocking ones but not the ones that drop
+//		 A queued hook that calls Log_Flush doesn't wait, and one that logs into a full queue drops the line
+void Log_Hook(Log_Callback callback, void* userData = nullptr, eLogHookPolicy policy = LOG_HOOK_POLICY_BLOCK); 
+void Log_Unhook(Log_Callback callback, void* userData = nullptr);	// Delivers what's already queued for it first
+bool Log_GetHookStats(Log_Callback callback, void* userData, LogHookStats& outStats);	// False if it isn't hooked
+
+// Tag Hooks
+// NOTE: A tag with hooks of its own only goes to those, every other hook (log.txt included) keeps getting every other tag
+//		 Log_Benchmark hooks its sinks this way so the game's lines stay in log.txt and out of its counts
+bool Log_HookTag(char const* tag, Log_Callback callback, void* userData = nullptr, eLogHookPolicy policy = LOG_HOOK_POLICY_BLOCK);	// False past LOG_MAX_TAGS
+
+// Binary File
+// NOTE: Compact records (time, thread, tag ID, format ID, raw arguments) with the tags and formats written once each
+//		 Deferred lines are never formatted for it, Tools/LogDecoder turns the file back into text
+bool Log_OpenBinaryFile(const std::string& filepath);	// False if it couldn't be opened or one is already open
+void Log_CloseBinaryFile();
+bool Log_IsBinaryFileOpen();
+uint64_t Log_GetNumBinaryWriteErrors();	// A failed write loses its records, the decoder stops there
+uint64_t Log_GetNumLostBinaryBytes();
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Deferred Logging -----------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Each argument is written as a type byte followed by its value, 8 bytes for scalars and a length then the bytes for strings
+enum eLogArgumentType : uint8_t
+{
+	LOG_ARGUMENT_INT = 0,
+	LOG_ARGUMENT_UINT,
+	LOG_ARGUMENT_DOUBLE,
+	LOG_ARGUMENT_POINTER,
+	LOG_ARGUMENT_STRING
+};
+
+// Run once without data to measure, then again to write
+struct LogArgumentBuffer
+{
+	char*	m_data = nullptr;
+	size_t	m_size = 0;
+
+	void Write(const void* bytes, size_t numBytes)
+	{
+		if (m_data != nullptr)
+		{
+			memcpy(m_data + m_size, bytes, numBytes);
+		}
+		m_size += numBytes;
+	}
+
+	template <typename T>
+	void WriteScalar(eLogArgumentType type, T value)
+	{
+		uint8_t typeByte = (uint8_t)type;
+		Write(&typeByte, 1);
+		Write(&value, sizeof(value));
+	}
+
+	void WriteString(const char* text, size_t length)
+	{
+		uint8_t typeByte = (uint8_t)LOG_ARGUMENT_STRING;
+		uint32_t length32 = (uint32_t)length;
+		Write(&typeByte, 1);
+		Write(&length32, sizeof(length32));
+		Write(text, length);
+	}
+};
+
+// Queues a line whose arguments were captured by LogTagged_Deferred
+void LogTagged_Captured(const char* tag, LogTagID tagID, const char* format, const char* arguments, size_t argumentsSize);
+
+template <typename T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type = 0>
+inline void Log_CaptureArgument(LogArgumentBuffer& buffer, T value)	{ buffer.WriteScalar(LOG_ARGUMENT_INT, (int64_t)value); }
+
+template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, int>::type = 0>
+inline void Log_CaptureArgument(LogArgumentBuffer& buffer, T value)	{ buffer.WriteScalar(LOG_ARGUMENT_UINT, (uint64_t)value); }
+
+template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+inline void Log_CaptureArgument(LogArgumentBuffer& buffer, T value)	{ buffer.WriteScalar(LOG_ARGUMENT_INT, (int64_t)value); }
+
+template <typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+inline void Log_CaptureArgument(LogArgumentBuffer& buffer, T value)	{ buffer.WriteScalar(LOG_ARGUMENT_DOUBLE, (double)value); }
+
+template <typename T, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value, int>::type = 0>
+inline void Log_CaptureArgument(LogArgumentBuffer& buffer, T* value)	{ buffer.WriteScalar(LOG_ARGUMENT_POINTER, (uint64_t)(uintptr_t)value); }
+
+inline void Log_CaptureArgument(LogArgumentBuffer& buffer, const char* value)
+{
+	value = (value != nullptr) ? value : "(null)";
+	buffer.WriteString(value, strlen(value));
+}
+
+inline void Log_CaptureArgument(LogArgumentBuffer& buffer, const std::string& value)	{ buffer.WriteString(value.data(), value.size()); }
+
+template <typename... Args>
+inline void Log_CaptureArguments(LogArgumentBuffer& buffer, const Args&... args)
+{
+	int expansion[] = {0, (Log_CaptureArgument(buffer, args), 0)...};
+	(void)expansion;
+}
+
+
+// Called through LOG_DEFERRED and LOG_TAGGED_DEFERRED, which make sure the format is a literal
+template <typename... Args>
+void LogTagged_Deferred(const char* tag, LogTagID tagID, const char* literalFormat, const Args&... args)
+{
+	// Tags past LOG_MAX_TAGS are always shown here, the logger thread checks them by name
+	if (!Log_IsTagIDShown(tagID))
+	{
+		return;
+	}
+
+	LogArgumentBuffer measure;
+	Log_CaptureArguments(measure, args...);
+
+	// Long strings are the only thing that won't fit on the stack
+	char stackArguments[256];
+	std::string heapArguments;
+	LogArgumentBuffer buffer;
+	if (measure.m_size <= sizeof(stackArguments))
+	{
+		buffer.m_data = stackArguments;
+	}
+	else
+	{
+		heapArguments.resize(measure.m_size);
+		buffer.m_data = &heapArguments[0];
+	}
+
+	Log_CaptureArguments(buffer, args...);
+	LogTagged_Captured(tag, tagID, literalFormat, buffer.m_data, buffer.m_size);
+}
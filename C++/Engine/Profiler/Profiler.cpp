@@ -1,8 +1,14 @@
 #include "Engine/Profiler/Profiler.hpp"
 
-#include <stack>
 #include <deque>
 #include <algorithm>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstdio>
+#include <cstring>
 
 #include "Engine/Core/EngineCommon.h"
 #include "Engine/Core/ErrorWarningAssert.hpp"
@@ -12,19 +18,33 @@
 
 #include "Engine/Core/Time.hpp"
 #include "Engine/Commands/Command.hpp"
+#include "Engine/Commands/DevConsole.hpp"
+extern DevConsole* g_theDevConsole;
 
-#define PROFILER_ENABLED
+#include "Engine/Profiler/ProfilerArena.hpp"
+#include "Engine/Profiler/ProfilerClock.hpp"
+#include "Engine/Profiler/ProfilerCapture.hpp"
+#include "Engine/Profiler/ProfilerCounters.hpp"
+#include "Engine/Profiler/ProfilerExport.hpp"
+#include "Engine/Profiler/ProfilerMemory.hpp"
+#include "Engine/Profiler/ProfilerSampling.hpp"
+#include "Engine/Profiler/ProfilerStatistics.hpp"
 
 
 
 // ----------------------------------------------------------------------------------------------------------------
 // ProfilerNode ---------------------------------------------------------------------------------------------------
 // ----------------------------------------------------------------------------------------------------------------
-ProfilerNode::ProfilerNode(const char* name)
+ProfilerNode::ProfilerNode(const char* name, uint32_t nameID)
 	: m_name(name)
-	, m_startHPC(GetCurrentTimeInHPC())
+	, m_nameID(nameID)
+	, m_startHPC(ProfilerClock_GetCurrentTicks())
 	, m_endHPC(m_startHPC)
 	, m_parent(nullptr)
+	, m_firstChild(nullptr)
+	, m_lastChild(nullptr)
+	, m_nextSibling(nullptr)
+	, m_childCount(0)
 {
 }
 
@@ -32,11 +52,26 @@ ProfilerNode::ProfilerNode(const char* name)
 
 ProfilerNode::~ProfilerNode()
 {
-	for (int i = 0; i < (int)m_children.size(); ++i)
+	// Children live in the same arena as us, they are released when the arena is reset
+}
+
+
+
+void ProfilerNode::AddChild(ProfilerNode* child)
+{
+	child->m_parent = this;
+
+	if (m_lastChild == nullptr)
+	{
+		m_firstChild = child;
+	}
+	else
 	{
-		delete m_children[i];
+		m_lastChild->m_nextSibling = child;
 	}
-	m_children.clear();
+	m_lastChild = child;
+
+	++m_childCount;
 }
 
 
@@ -45,13 +80,41 @@ uint64_t ProfilerNode::GetSelfTimeHPC() const
 {
 	uint64_t selfElapsedTime = GetElapsedTimeHPC();
 
-	for (int i = 0; i < (int)m_children.size(); ++i)
+	for (const ProfilerNode* child = m_firstChild; child != nullptr; child = child->m_nextSibling)
 	{
-		uint64_t childSubTreeElapsedTime = m_children[i]->GetElapsedTimeHPC();
+		uint64_t childSubTreeElapsedTime = child->GetElapsedTimeHPC();
 		selfElapsedTime -= childSubTreeElapsedTime;
 	}
 
-	return selfElapsedTime;
+	return ProfilerClock_RemoveOverhead(selfElapsedTime, m_childCount);
+}
+
+
+
+ProfilerMemoryCounts ProfilerNode::GetSelfMemory() const
+{
+	ProfilerMemoryCounts childrenMemory;
+
+	for (const ProfilerNode* child = m_firstChild; child != nullptr; child = child->m_nextSibling)
+	{
+		childrenMemory += child->m_memory;
+	}
+
+	return m_memory - childrenMemory;
+}
+
+
+
+ProfilerHardwareCounts ProfilerNode::GetSelfCounters() const
+{
+	ProfilerHardwareCounts childrenCounters;
+
+	for (const ProfilerNode* child = m_firstChild; child != nullptr; child = child->m_nextSibling)
+	{
+		childrenCounters += child->m_counters;
+	}
+
+	return m_counters - childrenCounters;
 }
 
 
@@ -59,11 +122,60 @@ uint64_t ProfilerNode::GetSelfTimeHPC() const
 // ----------------------------------------------------------------------------------------------------------------
 // ReportNode----------------------------------------------------------------------------------------------------
 // ----------------------------------------------------------------------------------------------------------------
+// Pools are recycled like frame arenas, so a report built every frame stops touching the heap
+constexpr size_t					MAX_NUM_FREE_REPORT_POOLS = 4;
+std::mutex							s_freeReportPoolsMutex;
+std::vector<ProfilerArena*>			s_freeReportPools;
+
+
+
+ProfilerArena* AcquireReportPool()
+{
+	std::lock_guard<std::mutex> poolsLock(s_freeReportPoolsMutex);
+
+	ProfilerArena* pool = nullptr;
+	if (!s_freeReportPools.empty())
+	{
+		pool = s_freeReportPools.back();
+		s_freeReportPools.pop_back();
+	}
+	else
+	{
+		pool = new ProfilerArena();
+	}
+
+	return pool;
+}
+
+
+
+void ReleaseReportPool(ProfilerArena* pool)
+{
+	pool->Reset();
+
+	std::lock_guard<std::mutex> poolsLock(s_freeReportPoolsMutex);
+	if (s_freeReportPools.size() < MAX_NUM_FREE_REPORT_POOLS)
+	{
+		s_freeReportPools.push_back(pool);
+	}
+	else
+	{
+		delete pool;
+	}
+}
+
+
+
 ReportNode::ReportNode(const ProfilerNode* profilerNode)
 	: m_name(profilerNode->m_name)
+	, m_nameID(profilerNode->m_nameID)
 	, m_callCount(1)
 	, m_elapsedTimeHPC(profilerNode->GetElapsedTimeHPC())
 	, m_selfTimeHPC(profilerNode->GetSelfTimeHPC())
+	, m_memory(profilerNode->m_memory)
+	, m_selfMemory(profilerNode->GetSelfMemory())
+	, m_counters(profilerNode->m_counters)
+	, m_selfCounters(profilerNode->GetSelfCounters())
 {
 
 }
@@ -72,11 +184,31 @@ ReportNode::ReportNode(const ProfilerNode* profilerNode)
 
 ReportNode::~ReportNode()
 {
-	for (auto iter = m_children.begin(); iter != m_children.end(); ++iter)
+	// Every other node in the tree lives in the root's pool
+	if (m_pool != nullptr)
+	{
+		ReleaseReportPool(m_pool);
+		m_pool = nullptr;
+	}
+}
+
+
+
+void ReportNode::AddChild(ReportNode* child)
+{
+	child->m_parent = this;
+
+	if (m_lastChild == nullptr)
+	{
+		m_firstChild = child;
+	}
+	else
 	{
-		delete iter->second;
+		m_lastChild->m_nextSibling = child;
 	}
-	m_children.clear();
+	m_lastChild = child;
+
+	++m_childCount;
 }
 
 
@@ -90,18 +222,239 @@ ReportNode::~ReportNode()
 // ----------------------------------------------------------------------------------------------------------------
 // State ----------------------------------------------------------------------------------------------------------
 // ----------------------------------------------------------------------------------------------------------------
+// Events mode
+constexpr int						MAX_EVENT_DEPTH = 256;
+std::atomic<int>					s_recordMode(PROFILER_RECORD_MODE_TREE);
+size_t								s_eventBufferCapacity = 256 * 1024;	// Per thread, power of two
+
+// A closed scope in events mode, written when the scope pops so children always land before their parent
+struct ProfilerEvent
+{
+	uint32_t						m_nameID;
+	uint32_t						m_depth;
+	uint64_t						m_startHPC;
+	uint64_t						m_endHPC;
+};
+
+// A ProfilerEvent in the ring, read by other threads while the owner may be overwriting it
+//	Relaxed atomics are free on the owner's side, whether a copy can be trusted is down to m_writeIndex
+struct ProfilerEventSlot
+{
+	std::atomic<uint32_t>			m_nameID{0};
+	std::atomic<uint32_t>			m_depth{0};
+	std::atomic<uint64_t>			m_startHPC{0};
+	std::atomic<uint64_t>			m_endHPC{0};
+};
+
+// Preallocated per thread ring of closed scopes
+//	Only the owning thread writes, m_writeIndex is published with release so readers can trust everything below it
+//	Once the ring wraps the oldest events are overwritten, frames that old materialize with what is left
+//	Overwriting works like a seqlock, the owner fences after reading m_writeIndex and before touching the slot
+//	so a reader that copied any of the new values is guaranteed to see the index that says the slot is gone
+struct ProfilerEventBuffer
+{
+	ProfilerEventBuffer(size_t capacity) : m_events(capacity), m_mask(capacity - 1) {}
+
+	std::vector<ProfilerEventSlot>	m_events;
+	uint64_t						m_mask;
+	std::atomic<uint64_t>			m_writeIndex{0};
+};
+
+// A scope that has been pushed but not popped yet in events mode
+struct ProfilerOpenEvent
+{
+	uint32_t						m_nameID;
+	uint64_t						m_startHPC;
+};
+
+// One thread's tree for one frame, it owns the arena the whole tree was allocated from
+//	In events mode the tree only holds the root until someone asks for it, see MaterializeTimeline
+struct ProfilerTimeline
+{
+	ProfilerArena							m_arena;
+	ProfilerNode*							m_root = nullptr;
+
+	std::shared_ptr<ProfilerEventBuffer>	m_eventBuffer;		// Set while the timeline has events waiting to be materialized
+	uint64_t								m_eventsBegin = 0;
+	uint64_t								m_eventsEnd = 0;
+	uint64_t								m_numLostEvents = 0;	// Overwritten by the ring before the tree was built
+
+	// What the sampler caught on the thread during the frame, in the arena with the tree
+	ProfilerSample*							m_samples = nullptr;
+	int										m_numSamples = 0;
+};
+
+// Every thread that recorded something during a frame, the main thread is always first
+//	Shared between the frame ring and any spike captures, it is recycled when the last of them lets go
+struct ProfilerFrame
+{
+	unsigned int					m_frameNumber = 0;
+	int								m_numRefs = 0;
+	std::vector<ProfilerTimeline*>	m_timelines;
+};
+
+// Recording state for a single thread
+//	The owning thread raises m_isRecording around every push/pop, Profiler_BeginFrame raises m_isSwapping and waits out a push/pop
+//	already under way before it swaps the timeline out. A push/pop that sees a swap under way steps back until it is done, so the
+//	hot path is an exchange and a load, and the two only ever wait on each other once per frame
+//	m_lock is for the rare paths (naming the thread, making the event buffer) and Profiler_BeginFrame holds it while swapping
+//	Events mode never raises m_isRecording, the event buffer's write index is the only thing shared
+struct ProfilerThreadState
+{
+	std::atomic<bool>						m_isRecording{false};
+	std::atomic<bool>						m_isSwapping{false};
+	std::mutex								m_lock;
+	ProfilerTimeline*						m_timeline = nullptr;
+	const char*								m_name = nullptr;
+	bool									m_isAlive = true;	// Cleared when the thread exits, the state is freed on the next frame
+
+	// Set by Profiler_Destroy for threads that are still alive, under s_threadListMutex
+	//	The state is taken off the list but left to its thread, which frees it once it has nothing open or when it exits
+	std::atomic<bool>						m_isOrphaned{false};
+
+	// Latched whenever the thread has nothing open so a scope always pops in the mode it pushed in
+	eProfilerRecordMode						m_recordMode = PROFILER_RECORD_MODE_TREE;
+
+	// Tree mode
+	std::vector<ProfilerNode*>				m_nodeStack;		// Vector over std::stack so popping never gives memory back
+
+	// Allocation tracking, only the owning thread writes them
+	//	Profiler_BeginFrame reads them while swapping to split the scopes open across the boundary
+	std::atomic<uint64_t>					m_numAllocations{0};
+	std::atomic<uint64_t>					m_bytesAllocated{0};
+	std::atomic<uint64_t>					m_bytesFreed{0};
+
+	// Hardware counters, opened by the owning thread the first time it records
+	ProfilerCounterGroup					m_counterGroup;
+
+	// Sampling, handed out under s_threadListMutex when sampling starts and kept until the state is destroyed
+	std::atomic<ProfilerSampleBuffer*>		m_sampleBuffer{nullptr};
+
+	// Events mode
+	std::shared_ptr<ProfilerEventBuffer>	m_eventBuffer;		// Created under m_lock the first time the thread records an event
+	uint64_t								m_eventsFrameStart = 0;
+	int										m_numOpenEvents = 0;
+	ProfilerOpenEvent						m_openEvents[MAX_EVENT_DEPTH];
+};
+
 // Saved Trees
-constexpr int				MAX_NUM_OLD_TREES = 128;
-std::deque<ProfilerNode*>	s_oldTrees;
+constexpr int						MAX_NUM_OLD_TREES = 128;
+std::deque<ProfilerFrame*>			s_oldTrees;
+std::vector<ProfilerFrame*>			s_freeFrames;		// Evicted frames waiting to be reused
+std::vector<ProfilerTimeline*>		s_freeTimelines;
+
+// Threads
+std::mutex							s_threadListMutex;	// Guards the thread list and both free lists
+std::vector<ProfilerThreadState*>	s_threadStates;		// The main thread is always first
+ProfilerThreadState*				s_mainThreadState = nullptr;
+int									s_numThreadsRegistered = 0;
+thread_local ProfilerThreadState*	t_threadState = nullptr;
+
+// Frames
+unsigned int						s_frameCounter = 0;
+bool								s_hasBegunFrame = false;
+
+// Interned Names
+constexpr int						NAME_CACHE_SIZE = 256;		// Power of two
+struct NameCacheEntry
+{
+	const char*						m_key		= nullptr;
+	const char*						m_interned	= nullptr;
+	uint32_t						m_id		= 0;
+};
+std::mutex								s_internedNamesMutex;
+std::unordered_map<std::string, uint32_t>	s_internedNames;	// Node based so the c_str()s never move
+std::vector<const char*>				s_internedNamesByID;
+thread_local NameCacheEntry				t_nameCache[NAME_CACHE_SIZE];
+
+// Memory
+bool								s_isMemoryTracking = false;
 
-// Stack for creation of the current tree
-ProfilerNode*				s_currentTree = nullptr;
-std::stack<ProfilerNode*>	s_nodeStack;
-unsigned int				s_frameCounter = 0;
+// Sampling
+bool								s_isSampling = false;	// Guarded by s_threadListMutex so new threads know to make a buffer
 
 // Pausing
-bool						s_isPaused = false;
-bool						s_shouldTogglePauseState = false;
+bool								s_isPaused = false;
+bool								s_shouldTogglePauseState = false;
+
+// Spike Capture
+//	A scope spike is packed as (name ID + 1) << SCOPE_SPIKE_ID_SHIFT | elapsed ticks so one exchange hands over both
+struct ProfilerSpikeRecord
+{
+	unsigned int					m_spikeFrameNumber = 0;
+	const char*						m_scopeName = nullptr;
+	double							m_spikeSeconds = 0.0;
+	double							m_thresholdSeconds = 0.0;
+
+	std::vector<ProfilerFrame*>		m_frames;
+	int								m_spikeIndex = 0;
+	int								m_numFramesStillToCome = 0;
+};
+constexpr int						MAX_NUM_SPIKE_CAPTURES = 16;
+constexpr uint32_t					MAX_NUM_SCOPE_SPIKE_THRESHOLDS = 4096;
+constexpr int						SCOPE_SPIKE_ID_SHIFT = 52;
+constexpr uint64_t					SCOPE_SPIKE_TICKS_MASK = (1ull << SCOPE_SPIKE_ID_SHIFT) - 1;
+std::vector<ProfilerSpikeRecord*>	s_spikeCaptures;	// Oldest first
+double								s_frameSpikeThresholdSeconds = 0.0;
+int									s_numSpikeNeighbours = 4;
+std::atomic<uint64_t>				s_scopeSpikeThresholds[MAX_NUM_SCOPE_SPIKE_THRESHOLDS];	// Ticks indexed by name ID, 0 for none
+std::atomic<int>					s_numScopeSpikeThresholds(0);
+std::atomic<uint64_t>				s_pendingScopeSpike(0);	// The first scope over its threshold since the last frame boundary
+
+// Rolling Reports
+//	Values are per frame, a scope's frame sums are blended into its averages as each frame closes
+struct RollingValues
+{
+	double							m_callCount = 0.0;
+	double							m_elapsedHPC = 0.0;
+	double							m_selfHPC = 0.0;
+	double							m_numAllocations = 0.0;
+	double							m_bytesAllocated = 0.0;
+	double							m_bytesFreed = 0.0;
+	double							m_selfNumAllocations = 0.0;
+	double							m_selfBytesAllocated = 0.0;
+	double							m_selfBytesFreed = 0.0;
+};
+struct RollingScope
+{
+	const char*						m_name = nullptr;
+	uint32_t						m_nameID = PROFILER_INVALID_NAME_ID;
+	int								m_flatIndex = 0;		// Nested scopes only, which flat scope they add to
+
+	// Nested scopes only, siblings are kept in name order so the nested lines come out like Profiler_GenerateNestedReportFromTree
+	int								m_depth = 0;
+	int								m_firstChild = -1;
+	int								m_nextSibling = -1;
+
+	RollingValues					m_frame;
+	RollingValues					m_average;
+};
+class ProfilerRollingReport
+{
+public:
+	eFlatReportSortMode				m_sortMode = FLAT_REPORT_SORT_MODE_SELF_TIME;
+	double							m_smoothing = 0.1;
+	unsigned int					m_numFramesAveraged = 0;
+
+	std::vector<RollingScope>		m_nestedScopes;			// The frame is always 0
+	std::vector<RollingScope>		m_flatScopes;			// The frame is always 0
+	std::unordered_map<uint64_t, int>	m_nestedIndices;	// (parent index << 32) | name ID
+	std::unordered_map<uint32_t, int>	m_flatIndices;		// Name ID
+
+	// Orders are only touched when they actually change, the lines only get their names again when they do
+	std::vector<int>				m_flatOrder;
+	std::vector<int>				m_nestedOrder;
+	unsigned int					m_flatOrderVersion = 0;
+	unsigned int					m_nestedOrderVersion = 0;
+
+	std::vector<PrintableReportLine>	m_flatLines;
+	std::vector<PrintableReportLine>	m_nestedLines;
+	unsigned int					m_flatLinesOrderVersion = 0xFFFFFFFF;
+	unsigned int					m_nestedLinesOrderVersion = 0xFFFFFFFF;
+	unsigned int					m_flatLinesFrame = 0;	// m_numFramesAveraged when the numbers were last formatted
+	unsigned int					m_nestedLinesFrame = 0;
+};
+std::vector<ProfilerRollingReport*>	s_rollingReports;
 
 
 
@@ -126,232 +479,2290 @@ void Profiler_Unpause_Command(Command& cmd)
 
 
 
-// ----------------------------------------------------------------------------------------------------------------
-// Composition ----------------------------------------------------------------------------------------------------
-// ----------------------------------------------------------------------------------------------------------------
-void Profiler_Initialize()
+void Profiler_Benchmark_Command(Command& cmd)
 {
-	RegisterCommand("ProfilerPause", Profiler_Pause_Command);
-	RegisterCommand("ProfilerUnpause", Profiler_Unpause_Command);
+	int numPairs = StringToInt(cmd.GetNextString().c_str());
+	if (numPairs <= 0)
+	{
+		numPairs = 100000;
+	}
+
+	double nsPerPair = Profiler_MeasurePushPopCost(numPairs);
+	double nsPerScope = Profiler_MeasureScopeCost(numPairs);
+	const char* modeName = (Profiler_GetRecordMode() == PROFILER_RECORD_MODE_EVENTS) ? "events" : "tree";
+	g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler: %.2f ns per Push/Pop pair, %.2f ns per PROFILE_SCOPE (%d pairs, %s mode)", nsPerPair, nsPerScope, numPairs, modeName));
 }
 
 
 
-void Profiler_Destroy()
+void Profiler_ReportBenchmark_Command(Command& cmd)
 {
-	for (int i = 0; i < (int)s_oldTrees.size(); ++i)
+	int numNodes = StringToInt(cmd.GetNextString().c_str());
+	if (numNodes <= 0)
 	{
-		delete s_oldTrees[i];
+		numNodes = 100000;
 	}
-	s_oldTrees.clear();
+
+	double treeMS = 0.0;
+	double flatMS = 0.0;
+	double nestedMS = 0.0;
+	Profiler_MeasureReportCost(numNodes, treeMS, flatMS, nestedMS);
+	g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler reports for %d nodes: tree %.2f ms, flat %.2f ms, nested %.2f ms", numNodes, treeMS, flatMS, nestedMS));
+
+	double updateMS = 0.0;
+	Profiler_MeasureRollingReportCost(numNodes, updateMS, flatMS, nestedMS);
+	g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler rolling report per frame: update %.2f ms, flat %.2f ms, nested %.2f ms", updateMS, flatMS, nestedMS));
 }
 
 
 
-// ----------------------------------------------------------------------------------------------------------------
-// Updating -------------------------------------------------------------------------------------------------------
-// ----------------------------------------------------------------------------------------------------------------
-void Profiler_BeginFrame()
+void Profiler_RecordMode_Command(Command& cmd)
 {
-	GUARANTEE_OR_DIE(s_nodeStack.size() == 0, "Uneven number of pushes/pops in the profiler");
-	
-	
-	++s_frameCounter;
+	std::string modeName = cmd.GetNextString();
 
-	if (s_currentTree != nullptr)
+	if (modeName == "tree")
 	{
-		s_currentTree->m_endHPC = GetCurrentTimeInHPC();
-
-		// If the profiler is not paused add the current tree to the list of old trees
-		if (!Profiler_IsPaused())
-		{
-			// Here we want to save off the current tree to some location 
-			// If the number of old trees we are storing is getting to large we want to remove the oldest one
-			if (s_oldTrees.size() >= MAX_NUM_OLD_TREES)
-			{
-				delete s_oldTrees.front();
-				s_oldTrees.pop_front();
-			}
-			s_oldTrees.push_back(s_currentTree);
-		}
-		else
-		{
-			// Else destroy it
-			// NOTE: So we don't have to manage pause state all over
-			//			Even if we are paused we keep generating trees we just throw them away at the end of the frame
-			delete s_currentTree;
-			s_currentTree = nullptr;
-		}
-
+		Profiler_SetRecordMode(PROFILER_RECORD_MODE_TREE);
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), "Profiler recording trees");
 	}
-
-
-	// Create the new tree
-	std::string frameName = "Frame " + std::to_string(s_frameCounter);
-	s_currentTree = new ProfilerNode(frameName.c_str());
-
-
-	// Toggle pause state 
-	if (s_shouldTogglePauseState)
+	else if (modeName == "events")
 	{
-		s_isPaused = !s_isPaused;
-		s_shouldTogglePauseState = false;
+		Profiler_SetRecordMode(PROFILER_RECORD_MODE_EVENTS);
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), "Profiler recording events");
+	}
+	else
+	{
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), "Record mode must be tree or events");
 	}
 }
 
 
-void Profiler_EndFrame()
+
+void Profiler_ExportTrace_Command(Command& cmd)
 {
+	std::string filepath = cmd.GetNextString();
+	if (filepath.empty())
+	{
+		filepath = "Log/profile.json";
+	}
 
+	// Anything that doesn't end in .json gets the perfetto format
+	bool isJSON = filepath.size() >= 5 && filepath.compare(filepath.size() - 5, 5, ".json") == 0;
+	bool success = isJSON ? Profiler_ExportChromeTrace(filepath) : Profiler_ExportPerfettoTrace(filepath);
+
+	if (success)
+	{
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Exported %d frames to %s", Profiler_GetNumPreviousTrees(), filepath.c_str()));
+	}
+	else
+	{
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), Stringf("Failed to write %s", filepath.c_str()));
+	}
 }
 
 
 
-// ----------------------------------------------------------------------------------------------------------------
-// Current Tree Stack Manipulation --------------------------------------------------------------------------------
-// ----------------------------------------------------------------------------------------------------------------
-void Profiler_Push(char const* name)
+void Profiler_Statistics_Command(Command& cmd)
 {
-	ProfilerNode* node = new ProfilerNode(name);
-
-	if (s_nodeStack.size() > 0)
+	int numFrames = StringToInt(cmd.GetNextString().c_str());
+	if (numFrames <= 0)
 	{
-		ProfilerNode* top = s_nodeStack.top();
-		top->m_children.push_back(node);
-		node->m_parent = top;
+		numFrames = Profiler_GetMaxNumPreviousTrees();
 	}
 
-	s_nodeStack.push(node);
+	const int NUM_LINES_TO_PRINT = 10;
+	std::vector<ProfilerStatisticsLine> report = Profiler_GenerateStatisticsReport(0, (unsigned int)numFrames, FLAT_REPORT_SORT_MODE_SELF_TIME);
+
+	g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("%-40s %10s %10s %10s %10s", "SCOPE (SELF TIME, MS)", "P50", "P95", "P99", "MAX"));
+	for (int i = 0; i < (int)report.size() && i < NUM_LINES_TO_PRINT; ++i)
+	{
+		const ProfilerStatisticsLine& line = report[i];
+		g_theDevConsole->PrintToLog(RGBA(255,255,255), Stringf("%-40s %10.3f %10.3f %10.3f %10.3f", line.m_name.c_str(), line.m_selfTime.m_p50 * 1000.0, line.m_selfTime.m_p95 * 1000.0, line.m_selfTime.m_p99 * 1000.0, line.m_selfTime.m_max * 1000.0));
+	}
 }
 
 
 
-void Profiler_Pop()
+void Profiler_Clock_Command(Command& cmd)
 {
-	if (s_nodeStack.size() > 1)
+	std::string compensation = cmd.GetNextString();
+	if (compensation == "on")
 	{
-		// The stack will still have nodes on it
-		ProfilerNode* top = s_nodeStack.top();
+		Profiler_SetClockOverheadCompensation(true);
+	}
+	else if (compensation == "off")
+	{
+		Profiler_SetClockOverheadCompensation(false);
+	}
 
+	eProfilerClock clock = Profiler_GetClock();
+	g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler clock: %s, %.3f MHz, %.2f ns per sample, compensation %s", Profiler_GetClockName(clock), Profiler_GetClockTicksPerSecond() / 1000000.0, Profiler_GetClockOverheadNanoseconds(), Profiler_IsClockOverheadCompensated() ? "on" : "off"));
+}
 
-		top->m_endHPC = GetCurrentTimeInHPC();
 
 
-		s_nodeStack.pop();
+void Profiler_Memory_Command(Command& cmd)
+{
+	std::string tracking = cmd.GetNextString();
+	if (tracking == "on")
+	{
+		Profiler_SetMemoryTracking(true);
 	}
-	else if (s_nodeStack.size() == 1)
+	else if (tracking == "off")
 	{
-		// This is the last node
-		ProfilerNode* top = s_nodeStack.top();
-
+		Profiler_SetMemoryTracking(false);
+	}
 
-		// Update node
-		top->m_endHPC = GetCurrentTimeInHPC();
+#ifdef PROFILER_MEMORY_TRACKING
+	g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler memory tracking %s", Profiler_IsMemoryTracking() ? "on" : "off"));
+#else
+	g_theDevConsole->PrintToLog(RGBA(255,0,0), "Profiler memory tracking is compiled out, see PROFILER_MEMORY_TRACKING");
+#endif
+}
 
 
-		// Remove node from stack
-		s_nodeStack.pop();
 
+void Profiler_Counters_Command(Command& cmd)
+{
+	UNUSED(cmd);
 
-		// Add subtree to current tree
-		s_currentTree->m_children.push_back(top); // This subtree is a direct child of the frame
+	if (!Profiler_IsCountingHardware())
+	{
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), "Profiler hardware counters are off, call Profiler_SetHardwareCounters(true) before Profiler_Initialize");
+		return;
 	}
-	else 
+
+	ProfilerNode* tree = Profiler_GetPreviousTree(0);
+	if (tree == nullptr)
 	{
-		// Bad Shit, we popped an empty stack
-		GUARANTEE_OR_DIE(false, "Uneven number of pushes/pops in the profiler");
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), "Profiler has no frames to report on yet");
+		return;
 	}
-}
 
+	ReportNode* report = Profiler_GenerateReportTree(tree);
+	std::vector<PrintableReportLine> flatReport = Profiler_GenerateFlatReportFromTree(report, FLAT_REPORT_SORT_MODE_SELF_TIME);
+	delete report;
 
+	const int NUM_LINES_TO_PRINT = 10;
+	g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("%-40s %6s %12s %12s %10s %10s %10s", "SCOPE (SELF, LAST FRAME)", "IPC", "CYCLES", "INSTRUCTIONS", "L1D MISS", "LLC MISS", "BR MISS"));
+	for (int i = 0; i < (int)flatReport.size() && i < NUM_LINES_TO_PRINT; ++i)
+	{
+		const PrintableReportLine& line = flatReport[i];
+		const ProfilerHardwareCounts& counters = line.m_selfCounters;
+		double instructionsPerCycle = (counters.m_cycles != 0) ? ((double)counters.m_instructions / (double)counters.m_cycles) : 0.0;
 
-// ----------------------------------------------------------------------------------------------------------------
-// Pausing -------------------------------------------------------------------------------------------------------
-// ----------------------------------------------------------------------------------------------------------------
-bool Profiler_IsPaused()
-{
-	return s_isPaused;
+		std::string name = line.m_nameFront + line.m_nameBack;
+		g_theDevConsole->PrintToLog(RGBA(255,255,255), Stringf("%-40s %6.2f %12llu %12llu %10llu %10llu %10llu", name.c_str(), instructionsPerCycle, (unsigned long long)counters.m_cycles, (unsigned long long)counters.m_instructions, (unsigned long long)counters.m_l1DataMisses, (unsigned long long)counters.m_llcMisses, (unsigned long long)counters.m_branchMisses));
+	}
 }
 
 
 
-void Profiler_Pause()
+void Profiler_SpikeThreshold_Command(Command& cmd)
 {
-	if (!s_isPaused)	
+	double thresholdMS = (double)StringToFloat(cmd.GetNextString().c_str());
+	Profiler_SetFrameSpikeThreshold(thresholdMS / 1000.0);
+
+	std::string neighbours = cmd.GetNextString();
+	if (!neighbours.empty())
 	{
-		s_shouldTogglePauseState = true;
+		Profiler_SetSpikeCaptureNeighbours(std::min(std::max(StringToInt(neighbours.c_str()), 0), MAX_NUM_OLD_TREES - 1));
+	}
+
+	if (thresholdMS > 0.0)
+	{
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler capturing frames over %.2f ms", thresholdMS));
+	}
+	else
+	{
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), "Profiler frame spike capture off");
 	}
 }
 
 
 
-void Profiler_Unpause()
+void Profiler_ScopeSpikeThreshold_Command(Command& cmd)
 {
-	if (s_isPaused)
+	std::string scopeName = cmd.GetNextString();
+	double thresholdMS = (double)StringToFloat(cmd.GetNextString().c_str());
+
+	if (scopeName.empty())
 	{
-		s_shouldTogglePauseState = true;
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), "Usage: ProfilerScopeSpikeThreshold <scope name> <milliseconds>");
+	}
+	else if (!Profiler_SetScopeSpikeThreshold(scopeName.c_str(), thresholdMS / 1000.0))
+	{
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), Stringf("Too many scope names to put a threshold on %s", scopeName.c_str()));
+	}
+	else
+	{
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler capturing %s calls over %.2f ms", scopeName.c_str(), thresholdMS));
 	}
 }
 
 
 
-// ----------------------------------------------------------------------------------------------------------------
-// Frame Number ---------------------------------------------------------------------------------------------------
-// ----------------------------------------------------------------------------------------------------------------
-unsigned int Profiler_GetFrameNumber()
+void Profiler_Spikes_Command(Command& cmd)
 {
-	return s_frameCounter;
-}
-
+	if (cmd.GetNextString() == "clear")
+	{
+		Profiler_ClearSpikeCaptures();
+	}
 
+	int numCaptures = Profiler_GetNumSpikeCaptures();
+	g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler has %d spike captures", numCaptures));
+	for (int i = 0; i < numCaptures; ++i)
+	{
+		ProfilerSpikeCapture capture = Profiler_GetSpikeCapture(i);
+		const char* scopeName = (capture.m_scopeName != nullptr) ? capture.m_scopeName : "Frame";
+		g_theDevConsole->PrintToLog(RGBA(255,255,255), Stringf("%2d: frame %u, %s took %.3f ms (threshold %.3f ms), %d frames kept", i, capture.m_spikeFrameNumber, scopeName, capture.m_spikeSeconds * 1000.0, capture.m_thresholdSeconds * 1000.0, (int)capture.m_frameTrees.size()));
+	}
+}
 
-// ----------------------------------------------------------------------------------------------------------------
-// Report Generation ----------------------------------------------------------------------------------------------
-// ----------------------------------------------------------------------------------------------------------------
-// Report Formatting Constants(PX) ------------------------------------------------------------------------
-const int INDENT_SIZE			= 1;
-const int NAME_SIZE				= 72;
-const int CALL_COUNT_SIZE		= 8;
-const int ELAPSED_PERCENT_SIZE	= 8;
-const int ELAPSED_TIME_SIZE		= 14;
-const int SELF_PERCENT_SIZE		= 8;
-const int SELF_TIME_SIZE		= 14;
 
 
-void ParseTime(float timeInSeconds, int& intPart, float& floatPart, std::string& units)
+void Profiler_Capture_Command(Command& cmd)
 {
-	int unitUps = 0;
+	std::string action = cmd.GetNextString();
 
-	float time = timeInSeconds;
-	while(time < 1.0f)
+	if (action == "start")
 	{
-		time *= 1000.0f;
-
-		++unitUps;
-		if (unitUps >= 3)
+		std::string filepath = cmd.GetNextString();
+		if (filepath.empty())
 		{
-			break;
+			filepath = "Log/profile.prfcap";
 		}
-	}
-
-
-	intPart = (int)time;
-	floatPart = time - (int)time;
 
-	if (unitUps == 0)
-	{
-		units = "s";
+		if (Profiler_StartCapture(filepath))
+		{
+			g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler capturing to %s", filepath.c_str()));
+		}
+		else
+		{
+			g_theDevConsole->PrintToLog(RGBA(255,0,0), Stringf("Could not start a capture to %s", filepath.c_str()));
+		}
 	}
-	else if (unitUps == 1)
+	else if (action == "stop")
 	{
-		units = "ms";
+		unsigned int numFrames = Profiler_GetNumCapturedFrames();
+		unsigned int numDropped = Profiler_GetNumDroppedCaptureFrames();
+		Profiler_StopCapture();
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler capture stopped, %u frames written, %u dropped", numFrames, numDropped));
 	}
-	else if (unitUps == 2)
+	else if (action == "report")
 	{
-		units = "us";
-		floatPart = 0.0f;
-	}
-	else 
+		// Reads a capture back the way a viewer would, over whatever range was asked for
+		std::string filepath = cmd.GetNextString();
+		int firstFrameIndex = StringToInt(cmd.GetNextString().c_str());
+		int numFrames = StringToInt(cmd.GetNextString().c_str());
+
+		ProfilerCaptureFile captureFile;
+		if (!captureFile.Open(filepath))
+		{
+			g_theDevConsole->PrintToLog(RGBA(255,0,0), Stringf("Could not open the capture %s", filepath.c_str()));
+			return;
+		}
+
+		if (firstFrameIndex < 0 || firstFrameIndex > captureFile.GetNumFrames())
+		{
+			firstFrameIndex = 0;
+		}
+		if (numFrames <= 0 || firstFrameIndex + numFrames > captureFile.GetNumFrames())
+		{
+			numFrames = captureFile.GetNumFrames() - firstFrameIndex;
+		}
+		if (numFrames <= 0)
+		{
+			g_theDevConsole->PrintToLog(RGBA(255,0,0), Stringf("%s has no frames in that range", filepath.c_str()));
+			return;
+		}
+
+		ReportNode* report = captureFile.GenerateReportTree(firstFrameIndex, numFrames);
+		std::vector<PrintableReportLine> flatReport = (report != nullptr) ? Profiler_GenerateFlatReportFromTree(report, FLAT_REPORT_SORT_MODE_SELF_TIME) : std::vector<PrintableReportLine>();
+		delete report;
+
+		const int NUM_LINES_TO_PRINT = 10;
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("%s frames %u to %u, %d of %d", filepath.c_str(), captureFile.GetFrameNumber(firstFrameIndex), captureFile.GetFrameNumber(firstFrameIndex + numFrames - 1), numFrames, captureFile.GetNumFrames()));
+		for (int i = 0; i < (int)flatReport.size() && i < NUM_LINES_TO_PRINT; ++i)
+		{
+			const PrintableReportLine& line = flatReport[i];
+			std::string name = line.m_nameFront + line.m_nameBack;
+			g_theDevConsole->PrintToLog(RGBA(255,255,255), Stringf("%-40s %8d calls %8.3f %s self", name.c_str(), line.m_callCount, (float)line.m_selfTime_intPart + line.m_selfTime_floatPart, line.m_selfTime_units.c_str()));
+		}
+	}
+	else if (Profiler_IsCapturing())
+	{
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler capturing, %u frames written, %u dropped", Profiler_GetNumCapturedFrames(), Profiler_GetNumDroppedCaptureFrames()));
+	}
+	else
+	{
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), "Usage: ProfilerCapture start [file] | stop | report <file> [first frame] [frame count]");
+	}
+}
+
+
+
+void Profiler_Sampling_Command(Command& cmd)
+{
+	std::string action = cmd.GetNextString();
+
+	if (action == "start")
+	{
+		int samplesPerSecond = StringToInt(cmd.GetNextString().c_str());
+		samplesPerSecond = (samplesPerSecond > 0) ? samplesPerSecond : 1000;
+
+		if (Profiler_StartSampling(samplesPerSecond))
+		{
+			g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler sampling at %d Hz of CPU time", samplesPerSecond));
+		}
+		else
+		{
+			g_theDevConsole->PrintToLog(RGBA(255,0,0), "Profiler sampling isn't available on this platform");
+		}
+	}
+	else if (action == "stop")
+	{
+		Profiler_StopSampling();
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Profiler sampling stopped, %u samples dropped", Profiler_GetNumDroppedSamples()));
+	}
+	else if (action == "export")
+	{
+		std::string filepath = cmd.GetNextString();
+		if (filepath.empty())
+		{
+			filepath = "Log/profile.folded";
+		}
+
+		if (Profiler_ExportFoldedStacks(filepath))
+		{
+			g_theDevConsole->PrintToLog(RGBA(0,255,0), Stringf("Exported folded stacks to %s", filepath.c_str()));
+		}
+		else
+		{
+			g_theDevConsole->PrintToLog(RGBA(255,0,0), Stringf("Failed to write %s", filepath.c_str()));
+		}
+	}
+	else if (action == "report")
+	{
+		ReportNode* report = Profiler_GenerateHybridReportTree(0);
+		if (report == nullptr)
+		{
+			g_theDevConsole->PrintToLog(RGBA(255,0,0), "Profiler has no frames to report on yet");
+			return;
+		}
+
+		std::vector<PrintableReportLine> flatReport = Profiler_GenerateFlatReportFromTree(report, FLAT_REPORT_SORT_MODE_SELF_TIME);
+		delete report;
+
+		const int NUM_LINES_TO_PRINT = 10;
+		g_theDevConsole->PrintToLog(RGBA(0,255,0), "Last frame by self time, sampled functions marked with *");
+		for (int i = 0; i < (int)flatReport.size() && i < NUM_LINES_TO_PRINT; ++i)
+		{
+			const PrintableReportLine& line = flatReport[i];
+			std::string name = line.m_nameFront + line.m_nameBack;
+			g_theDevConsole->PrintToLog(RGBA(255,255,255), Stringf("%c %-60s %8.3f %s", line.m_isSampled ? '*' : ' ', name.c_str(), (float)line.m_selfTime_intPart + line.m_selfTime_floatPart, line.m_selfTime_units.c_str()));
+		}
+	}
+	else
+	{
+		g_theDevConsole->PrintToLog(RGBA(255,0,0), "Usage: ProfilerSampling start [samples per second] | stop | report | export [file]");
+	}
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Names ----------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+const char* InternName(const char* name, uint32_t& outID)
+{
+	// Almost every name is a string literal so the pointer makes a good cache key
+	//	The strcmp keeps us honest when a caller reuses a buffer with different contents
+	//	The cache is per thread so a hit never takes a lock
+	size_t slot = (((uintptr_t)name) >> 3) & (NAME_CACHE_SIZE - 1);
+	NameCacheEntry& entry = t_nameCache[slot];
+	if (entry.m_key == name && strcmp(entry.m_interned, name) == 0)
+	{
+		outID = entry.m_id;
+		return entry.m_interned;
+	}
+
+	// Cache miss, only the very first sighting of a name allocates
+	std::lock_guard<std::mutex> namesLock(s_internedNamesMutex);
+	auto result = s_internedNames.emplace(std::string(name), (uint32_t)s_internedNamesByID.size());
+	if (result.second)
+	{
+		s_internedNamesByID.push_back(result.first->first.c_str());
+	}
+
+	entry.m_key = name;
+	entry.m_interned = result.first->first.c_str();
+	entry.m_id = result.first->second;
+
+	outID = entry.m_id;
+	return entry.m_interned;
+}
+
+
+
+const char* Profiler_InternName(const char* name)
+{
+	uint32_t id = 0;
+	return InternName(name, id);
+}
+
+
+
+ProfilerScopeDescriptor::ProfilerScopeDescriptor(const char* name, const char* file, int line, uint32_t nameHash)
+	: m_name(nullptr)
+	, m_nameID(PROFILER_INVALID_NAME_ID)
+	, m_nameHash(nameHash)
+	, m_file(file)
+	, m_line(line)
+{
+	m_name = InternName(name, m_nameID);
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Memory ---------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Installed as the allocation callback, runs inside every operator new/delete in the process
+void CountAllocation(void* memory, size_t numBytes, bool isAllocation)
+{
+	UNUSED(memory);
+
+	// Threads that never profiled anything aren't tracked
+	ProfilerThreadState* state = t_threadState;
+	if (state == nullptr)
+	{
+		return;
+	}
+
+	// We are the only writer, no need for a locked add
+	if (isAllocation)
+	{
+		state->m_numAllocations.store(state->m_numAllocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		state->m_bytesAllocated.store(state->m_bytesAllocated.load(std::memory_order_relaxed) + numBytes, std::memory_order_relaxed);
+	}
+	else
+	{
+		state->m_bytesFreed.store(state->m_bytesFreed.load(std::memory_order_relaxed) + numBytes, std::memory_order_relaxed);
+	}
+}
+
+
+
+// The thread's running totals, scopes keep them on push and turn them into a difference on pop
+ProfilerMemoryCounts ReadMemoryCounts(const ProfilerThreadState* state)
+{
+	ProfilerMemoryCounts counts;
+
+#ifdef PROFILER_MEMORY_TRACKING
+	counts.m_numAllocations = state->m_numAllocations.load(std::memory_order_relaxed);
+	counts.m_bytesAllocated = state->m_bytesAllocated.load(std::memory_order_relaxed);
+	counts.m_bytesFreed = state->m_bytesFreed.load(std::memory_order_relaxed);
+#else
+	UNUSED(state);
+#endif
+
+	return counts;
+}
+
+
+
+void Profiler_SetMemoryTracking(bool isTracking)
+{
+	ProfilerMemory_SetAllocationCallback(isTracking ? CountAllocation : nullptr);
+	s_isMemoryTracking = isTracking;
+}
+
+
+
+bool Profiler_IsMemoryTracking()
+{
+	return s_isMemoryTracking;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Hardware Counters ----------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// A syscall per read, so nothing is read unless counting was asked for
+ProfilerHardwareCounts ReadHardwareCounts(const ProfilerThreadState* state)
+{
+	ProfilerHardwareCounts counts;
+
+	if (g_isCountingHardware)
+	{
+		counts = ProfilerCounters_Read(state->m_counterGroup);
+	}
+
+	return counts;
+}
+
+
+
+void DestroyThreadState(ProfilerThreadState* state)
+{
+	ProfilerCounters_CloseGroup(state->m_counterGroup);
+	delete state->m_sampleBuffer.load(std::memory_order_relaxed);
+	delete state;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Sampling -------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+bool Profiler_StartSampling(int samplesPerSecond)
+{
+	GUARANTEE_OR_DIE(samplesPerSecond > 0, "Sampling rate must be positive");
+
+	if (!ProfilerSampling_IsAvailable())
+	{
+		return false;
+	}
+
+	// Every thread needs somewhere to put its samples before the first signal can land on it
+	std::lock_guard<std::mutex> listLock(s_threadListMutex);
+	for (int i = 0; i < (int)s_threadStates.size(); ++i)
+	{
+		ProfilerThreadState* state = s_threadStates[i];
+		if (state->m_sampleBuffer.load(std::memory_order_relaxed) == nullptr)
+		{
+			state->m_sampleBuffer.store(new ProfilerSampleBuffer(), std::memory_order_release);
+		}
+	}
+
+	s_isSampling = ProfilerSampling_Start(samplesPerSecond);
+	return s_isSampling;
+}
+
+
+
+void Profiler_StopSampling()
+{
+	std::lock_guard<std::mutex> listLock(s_threadListMutex);
+	ProfilerSampling_Stop();
+	s_isSampling = false;
+}
+
+
+
+bool Profiler_IsSampling()
+{
+	return s_isSampling;
+}
+
+
+
+unsigned int Profiler_GetNumDroppedSamples()
+{
+	return ProfilerSampling_GetNumDropped();
+}
+
+
+
+std::vector<ProfilerSample> Profiler_GetPreviousSamples(unsigned int xTreesAgo, int threadIndex)
+{
+	std::vector<ProfilerSample> samples;
+
+	if (s_oldTrees.size() > xTreesAgo)
+	{
+		const ProfilerFrame* frame = s_oldTrees[s_oldTrees.size() - 1 - xTreesAgo];
+		if (threadIndex >= 0 && threadIndex < (int)frame->m_timelines.size())
+		{
+			const ProfilerTimeline* timeline = frame->m_timelines[threadIndex];
+			samples.assign(timeline->m_samples, timeline->m_samples + timeline->m_numSamples);
+		}
+	}
+
+	return samples;
+}
+
+
+
+ProfilerNode* Profiler_FindSampleScope(ProfilerNode* tree, const ProfilerSample& sample)
+{
+	ProfilerNode* scope = tree;
+
+	// Siblings never overlap, so at most one child at each level holds the sample
+	ProfilerNode* child = (scope != nullptr) ? scope->m_firstChild : nullptr;
+	while (child != nullptr)
+	{
+		if (sample.m_ticks >= child->m_startHPC && sample.m_ticks < child->m_endHPC)
+		{
+			scope = child;
+			child = child->m_firstChild;
+		}
+		else
+		{
+			child = child->m_nextSibling;
+		}
+	}
+
+	return scope;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Frames ---------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// NOTE: Everything in this section touches the free lists, hold s_threadListMutex
+ProfilerTimeline* StartTimeline(ProfilerThreadState* state, uint64_t startHPC)
+{
+	ProfilerTimeline* timeline = nullptr;
+
+	if (!s_freeTimelines.empty())
+	{
+		timeline = s_freeTimelines.back();
+		s_freeTimelines.pop_back();
+	}
+	else
+	{
+		timeline = new ProfilerTimeline();
+	}
+
+
+	// The main thread's root is the frame, so it gets the frame name
+	//	That name is unique per frame so it lives in the timeline's arena instead of the intern table
+	const char* rootName = state->m_name;
+	if (state == s_mainThreadState)
+	{
+		char frameName[32];
+		snprintf(frameName, sizeof(frameName), "Frame %u", s_frameCounter);
+		rootName = timeline->m_arena.CopyString(frameName);
+	}
+
+	timeline->m_root = timeline->m_arena.Create<ProfilerNode>(rootName);
+	timeline->m_root->m_startHPC = startHPC;
+	timeline->m_root->m_endHPC = startHPC;
+	timeline->m_root->m_memory = ReadMemoryCounts(state);
+	timeline->m_root->m_counters = ReadHardwareCounts(state);
+
+	return timeline;
+}
+
+
+
+void RecycleTimeline(ProfilerTimeline* timeline)
+{
+	// Nodes are trivially destructible in practice, resetting the arena is all the teardown a tree needs
+	timeline->m_root = nullptr;
+	timeline->m_arena.Reset();
+
+	timeline->m_eventBuffer.reset();
+	timeline->m_eventsBegin = 0;
+	timeline->m_eventsEnd = 0;
+	timeline->m_numLostEvents = 0;
+
+	timeline->m_samples = nullptr;
+	timeline->m_numSamples = 0;
+
+	s_freeTimelines.push_back(timeline);
+}
+
+
+
+ProfilerFrame* AcquireFrame()
+{
+	ProfilerFrame* frame = nullptr;
+
+	if (!s_freeFrames.empty())
+	{
+		frame = s_freeFrames.back();
+		s_freeFrames.pop_back();
+	}
+	else
+	{
+		frame = new ProfilerFrame();
+	}
+
+	frame->m_numRefs = 1;
+	return frame;
+}
+
+
+
+void RecycleFrame(ProfilerFrame* frame)
+{
+	for (int i = 0; i < (int)frame->m_timelines.size(); ++i)
+	{
+		RecycleTimeline(frame->m_timelines[i]);
+	}
+	frame->m_timelines.clear();
+
+	s_freeFrames.push_back(frame);
+}
+
+
+
+void ReleaseFrame(ProfilerFrame* frame)
+{
+	--frame->m_numRefs;
+	if (frame->m_numRefs == 0)
+	{
+		RecycleFrame(frame);
+	}
+}
+
+
+
+// Moves everything the signal handler has published into the closed timeline's arena
+//	A sample that landed between the boundary and here is still kept, it just ends up attributed to the root
+void DrainSamples(ProfilerThreadState* state, ProfilerTimeline* closedTimeline)
+{
+	ProfilerSampleBuffer* buffer = state->m_sampleBuffer.load(std::memory_order_acquire);
+	if (buffer == nullptr)
+	{
+		return;
+	}
+
+	uint32_t readIndex = buffer->m_readIndex.load(std::memory_order_relaxed);
+	uint32_t writeIndex = buffer->m_writeIndex.load(std::memory_order_acquire);
+	if (readIndex == writeIndex)
+	{
+		return;
+	}
+
+	int numSamples = (int)(writeIndex - readIndex);
+	ProfilerSample* samples = (ProfilerSample*)closedTimeline->m_arena.Allocate(sizeof(ProfilerSample) * (size_t)numSamples, alignof(ProfilerSample));
+	for (int i = 0; i < numSamples; ++i)
+	{
+		const ProfilerSampleSlot& slot = buffer->m_slots[(readIndex + (uint32_t)i) & (PROFILER_SAMPLE_BUFFER_CAPACITY - 1)];
+
+		void** frames = (void**)closedTimeline->m_arena.Allocate(sizeof(void*) * (size_t)slot.m_numFrames, alignof(void*));
+		memcpy(frames, slot.m_frames, sizeof(void*) * (size_t)slot.m_numFrames);
+
+		samples[i].m_ticks = slot.m_ticks;
+		samples[i].m_numFrames = slot.m_numFrames;
+		samples[i].m_frames = frames;
+	}
+
+	// The slots can be written again
+	buffer->m_readIndex.store(writeIndex, std::memory_order_release);
+
+	closedTimeline->m_samples = samples;
+	closedTimeline->m_numSamples = numSamples;
+}
+
+
+
+// Profiler_BeginFrame's side of the handoff, see ProfilerThreadState
+//	Pairs with BeginRecording, either the thread sees the swap before it starts or we see it recording and wait it out
+void BeginSwap(ProfilerThreadState* state)
+{
+	state->m_isSwapping.store(true, std::memory_order_seq_cst);
+	while (state->m_isRecording.load(std::memory_order_seq_cst))
+	{
+		std::this_thread::yield();
+	}
+}
+
+
+
+void EndSwap(ProfilerThreadState* state)
+{
+	state->m_isSwapping.store(false, std::memory_order_release);
+}
+
+
+
+ProfilerTimeline* SwapTimeline(ProfilerThreadState* state)
+{
+	std::lock_guard<std::mutex> threadLock(state->m_lock);
+	BeginSwap(state);
+
+	// Claim every event the thread has published so far
+	//	Read the index before sampling the boundary so every claimed event ended before the boundary
+	ProfilerTimeline* closedTimeline = state->m_timeline;
+	if (state->m_eventBuffer != nullptr)
+	{
+		uint64_t writeIndex = state->m_eventBuffer->m_writeIndex.load(std::memory_order_acquire);
+		if (writeIndex != state->m_eventsFrameStart)
+		{
+			closedTimeline->m_eventBuffer	= state->m_eventBuffer;
+			closedTimeline->m_eventsBegin	= state->m_eventsFrameStart;
+			closedTimeline->m_eventsEnd		= writeIndex;
+			state->m_eventsFrameStart		= writeIndex;
+		}
+	}
+
+	// Sample the boundary under the thread's lock so nothing it recorded can land after the end of its closed tree
+	uint64_t frameBoundaryHPC = ProfilerClock_GetCurrentTicks();
+	closedTimeline->m_root->m_endHPC = frameBoundaryHPC;
+
+	ProfilerMemoryCounts frameBoundaryMemory = ReadMemoryCounts(state);
+	closedTimeline->m_root->m_memory = frameBoundaryMemory - closedTimeline->m_root->m_memory;
+
+	ProfilerHardwareCounts frameBoundaryCounters = ReadHardwareCounts(state);
+	closedTimeline->m_root->m_counters = frameBoundaryCounters - closedTimeline->m_root->m_counters;
+
+	DrainSamples(state, closedTimeline);
+
+	state->m_timeline = StartTimeline(state, frameBoundaryHPC);
+
+
+	// Worker threads are free to have scopes open across the frame boundary (a long load for example)
+	//	Split them, the closed frame keeps everything up to the boundary and a continuation of each scope
+	//	is opened in the new frame so the thread can keep pushing/popping as if nothing happened
+	ProfilerNode* continuedParent = nullptr;
+	for (int i = 0; i < (int)state->m_nodeStack.size(); ++i)
+	{
+		ProfilerNode* openNode = state->m_nodeStack[i];
+		openNode->m_endHPC = frameBoundaryHPC;
+		openNode->m_memory = frameBoundaryMemory - openNode->m_memory;
+		openNode->m_counters = frameBoundaryCounters - openNode->m_counters;
+		if (i == 0)
+		{
+			// Top level scopes are only attached to the root when they pop
+			closedTimeline->m_root->AddChild(openNode);
+		}
+
+		ProfilerNode* continuedNode = state->m_timeline->m_arena.Create<ProfilerNode>(openNode->m_name, openNode->m_nameID);
+		continuedNode->m_startHPC = frameBoundaryHPC;
+		continuedNode->m_endHPC = frameBoundaryHPC;
+		continuedNode->m_memory = frameBoundaryMemory;
+		continuedNode->m_counters = frameBoundaryCounters;
+		if (continuedParent != nullptr)
+		{
+			continuedParent->AddChild(continuedNode);
+		}
+
+		state->m_nodeStack[i] = continuedNode;
+		continuedParent = continuedNode;
+	}
+
+	EndSwap(state);
+	return closedTimeline;
+}
+
+
+
+// Builds the tree for a timeline recorded in events mode, nothing is done until the tree is asked for
+//	Events are in pop order so every child is seen before its parent, each event adopts everything pending one level below it
+//	Scopes that were still open when the frame closed show up in the frame they pop in, their children that
+//	popped in this frame are hung off the root instead
+void MaterializeTimeline(ProfilerTimeline* timeline)
+{
+	if (timeline->m_eventBuffer == nullptr)
+	{
+		return;
+	}
+
+	ProfilerEventBuffer* buffer = timeline->m_eventBuffer.get();
+	uint64_t capacity = buffer->m_mask + 1;
+
+
+	// Copy out what the ring still holds, then check nothing was overwritten while we copied
+	//	The slot at writeIndex may be mid write, which is what the + 1 is for
+	//	Scratch is per thread, reports can be generated from any of them
+	static thread_local std::vector<ProfilerEvent> t_scratchEvents;
+	t_scratchEvents.clear();
+
+	uint64_t writeIndex = buffer->m_writeIndex.load(std::memory_order_acquire);
+	uint64_t begin = timeline->m_eventsBegin;
+	if (writeIndex + 1 > capacity && writeIndex + 1 - capacity > begin)
+	{
+		begin = writeIndex + 1 - capacity;
+	}
+	for (uint64_t eventIndex = begin; eventIndex < timeline->m_eventsEnd; ++eventIndex)
+	{
+		const ProfilerEventSlot& slot = buffer->m_events[eventIndex & buffer->m_mask];
+
+		ProfilerEvent event;
+		event.m_nameID		= slot.m_nameID.load(std::memory_order_relaxed);
+		event.m_depth		= slot.m_depth.load(std::memory_order_relaxed);
+		event.m_startHPC	= slot.m_startHPC.load(std::memory_order_relaxed);
+		event.m_endHPC		= slot.m_endHPC.load(std::memory_order_relaxed);
+		t_scratchEvents.push_back(event);
+	}
+
+	// Pairs with the owner's fence in PopEvent, if any copy saw a value from an overwrite the index read below sees that overwrite
+	//	Events that fail the check may hold torn values, they are skipped before anything looks at them
+	std::atomic_thread_fence(std::memory_order_acquire);
+	writeIndex = buffer->m_writeIndex.load(std::memory_order_relaxed);
+	size_t firstValidEvent = 0;
+	if (writeIndex + 1 > capacity && writeIndex + 1 - capacity > begin)
+	{
+		firstValidEvent = (size_t)std::min<uint64_t>(writeIndex + 1 - capacity - begin, t_scratchEvents.size());
+	}
+
+	// Frames older than the ring come back partial, Profiler_GetPreviousNumLostEvents says by how much
+	timeline->m_numLostEvents = (std::min(begin, timeline->m_eventsEnd) - timeline->m_eventsBegin) + firstValidEvent;
+
+
+	// Names by ID, taken once so the walk doesn't lock per event
+	static thread_local std::vector<const char*> t_namesByID;
+	{
+		std::lock_guard<std::mutex> namesLock(s_internedNamesMutex);
+		t_namesByID = s_internedNamesByID;
+	}
+
+
+	// Build
+	ProfilerNode* root = timeline->m_root;
+	static thread_local std::vector<ProfilerNode*> t_pendingFirst;		// Intrusive lists of nodes waiting on a parent, one per depth
+	static thread_local std::vector<ProfilerNode*> t_pendingLast;
+	t_pendingFirst.assign(MAX_EVENT_DEPTH + 1, nullptr);
+	t_pendingLast.assign(MAX_EVENT_DEPTH + 1, nullptr);
+
+	for (size_t i = firstValidEvent; i < t_scratchEvents.size(); ++i)
+	{
+		const ProfilerEvent& event = t_scratchEvents[i];
+
+		// Only keep the part inside this frame
+		//	An event can end just before the boundary and still be published after it, that one clamps to nothing
+		ProfilerNode* node = timeline->m_arena.Create<ProfilerNode>(t_namesByID[event.m_nameID], event.m_nameID);
+		node->m_startHPC	= std::max(event.m_startHPC, root->m_startHPC);
+		node->m_endHPC		= std::max(event.m_endHPC, node->m_startHPC);
+
+		// Adopt the children
+		int childDepth = (int)event.m_depth + 1;
+		for (ProfilerNode* child = t_pendingFirst[childDepth]; child != nullptr;)
+		{
+			ProfilerNode* next = child->m_nextSibling;
+			child->m_nextSibling = nullptr;
+			node->AddChild(child);
+			child = next;
+		}
+		t_pendingFirst[childDepth] = nullptr;
+		t_pendingLast[childDepth] = nullptr;
+
+		// Wait for our parent
+		ProfilerNode*& last = t_pendingLast[event.m_depth];
+		if (last == nullptr)
+		{
+			t_pendingFirst[event.m_depth] = node;
+		}
+		else
+		{
+			last->m_nextSibling = node;
+		}
+		last = node;
+	}
+
+
+	// Whatever is still pending belongs to the root, put it back in start order
+	static thread_local std::vector<ProfilerNode*> t_orphans;
+	t_orphans.clear();
+	for (int depth = 0; depth <= MAX_EVENT_DEPTH; ++depth)
+	{
+		for (ProfilerNode* node = t_pendingFirst[depth]; node != nullptr;)
+		{
+			ProfilerNode* next = node->m_nextSibling;
+			node->m_nextSibling = nullptr;
+			t_orphans.push_back(node);
+			node = next;
+		}
+	}
+	std::stable_sort(t_orphans.begin(), t_orphans.end(), [](const ProfilerNode* lhs, const ProfilerNode* rhs) { return lhs->m_startHPC < rhs->m_startHPC; });
+	for (int i = 0; i < (int)t_orphans.size(); ++i)
+	{
+		root->AddChild(t_orphans[i]);
+	}
+
+
+	// Let go of the buffer so a dead thread's ring can be freed
+	timeline->m_eventBuffer.reset();
+}
+
+
+
+ProfilerFrame* GetMaterializedFrame(unsigned int xTreesAgo)
+{
+	ProfilerFrame* frame = s_oldTrees[s_oldTrees.size() - 1 - xTreesAgo];
+
+	for (int i = 0; i < (int)frame->m_timelines.size(); ++i)
+	{
+		MaterializeTimeline(frame->m_timelines[i]);
+	}
+
+	return frame;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Spike Capture --------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Called on every pop, so it has to cost nothing while no scope thresholds are set
+void CheckForScopeSpike(uint32_t nameID, uint64_t elapsedTicks)
+{
+	if (s_numScopeSpikeThresholds.load(std::memory_order_relaxed) == 0 || nameID >= MAX_NUM_SCOPE_SPIKE_THRESHOLDS)
+	{
+		return;
+	}
+
+	uint64_t thresholdTicks = s_scopeSpikeThresholds[nameID].load(std::memory_order_relaxed);
+	if (thresholdTicks != 0 && elapsedTicks > thresholdTicks)
+	{
+		// Only the first spike in a frame is kept, that frame is getting captured either way
+		uint64_t spike = ((uint64_t)(nameID + 1) << SCOPE_SPIKE_ID_SHIFT) | std::min(elapsedTicks, SCOPE_SPIKE_TICKS_MASK);
+		uint64_t noSpike = 0;
+		s_pendingScopeSpike.compare_exchange_strong(noSpike, spike, std::memory_order_relaxed);
+	}
+}
+
+
+
+// NOTE: Everything below touches the frame lists, hold s_threadListMutex
+void AddFrameToSpikeCapture(ProfilerSpikeRecord* capture, ProfilerFrame* frame)
+{
+	// Events mode frames point into their thread's ring, which will be overwritten long before anyone looks at the capture
+	for (int i = 0; i < (int)frame->m_timelines.size(); ++i)
+	{
+		MaterializeTimeline(frame->m_timelines[i]);
+	}
+
+	++frame->m_numRefs;
+	capture->m_frames.push_back(frame);
+}
+
+
+
+void ReleaseSpikeCapture(ProfilerSpikeRecord* capture)
+{
+	for (int i = 0; i < (int)capture->m_frames.size(); ++i)
+	{
+		ReleaseFrame(capture->m_frames[i]);
+	}
+
+	delete capture;
+}
+
+
+
+void StartSpikeCapture(const char* scopeName, double spikeSeconds, double thresholdSeconds)
+{
+	// Make room by dropping the mildest capture, unless this one is milder still
+	double severity = spikeSeconds / thresholdSeconds;
+	if ((int)s_spikeCaptures.size() >= MAX_NUM_SPIKE_CAPTURES)
+	{
+		int mildestIndex = 0;
+		for (int i = 1; i < (int)s_spikeCaptures.size(); ++i)
+		{
+			const ProfilerSpikeRecord* capture = s_spikeCaptures[i];
+			const ProfilerSpikeRecord* mildest = s_spikeCaptures[mildestIndex];
+			if (capture->m_spikeSeconds / capture->m_thresholdSeconds < mildest->m_spikeSeconds / mildest->m_thresholdSeconds)
+			{
+				mildestIndex = i;
+			}
+		}
+
+		const ProfilerSpikeRecord* mildest = s_spikeCaptures[mildestIndex];
+		if (severity <= mildest->m_spikeSeconds / mildest->m_thresholdSeconds)
+		{
+			return;
+		}
+
+		ReleaseSpikeCapture(s_spikeCaptures[mildestIndex]);
+		s_spikeCaptures.erase(s_spikeCaptures.begin() + mildestIndex);
+	}
+
+
+	// The spike is the newest frame in the ring, take what we have of the frames before it
+	ProfilerSpikeRecord* capture = new ProfilerSpikeRecord();
+	capture->m_spikeFrameNumber		= s_oldTrees.back()->m_frameNumber;
+	capture->m_scopeName			= scopeName;
+	capture->m_spikeSeconds			= spikeSeconds;
+	capture->m_thresholdSeconds		= thresholdSeconds;
+	capture->m_numFramesStillToCome	= s_numSpikeNeighbours;
+
+	int numFramesBefore = std::min(s_numSpikeNeighbours, (int)s_oldTrees.size() - 1);
+	for (int i = (int)s_oldTrees.size() - 1 - numFramesBefore; i < (int)s_oldTrees.size(); ++i)
+	{
+		AddFrameToSpikeCapture(capture, s_oldTrees[i]);
+	}
+	capture->m_spikeIndex = numFramesBefore;
+
+	s_spikeCaptures.push_back(capture);
+}
+
+
+
+// The closed frame has just been pushed onto the ring
+void UpdateSpikeCaptures(ProfilerFrame* closedFrame)
+{
+	// Captures still waiting on the frames after their spike get this one
+	for (int i = 0; i < (int)s_spikeCaptures.size(); ++i)
+	{
+		ProfilerSpikeRecord* capture = s_spikeCaptures[i];
+		if (capture->m_numFramesStillToCome > 0)
+		{
+			AddFrameToSpikeCapture(capture, closedFrame);
+			--capture->m_numFramesStillToCome;
+		}
+	}
+
+
+	// Did this frame go over budget
+	const char* scopeName = nullptr;
+	double spikeSeconds = 0.0;
+	double thresholdSeconds = 0.0;
+
+	ProfilerNode* frameRoot = closedFrame->m_timelines[0]->m_root;
+	double frameSeconds = Profiler_ConvertTicksToSeconds(frameRoot->GetElapsedTimeHPC());
+	uint64_t scopeSpike = s_pendingScopeSpike.exchange(0, std::memory_order_relaxed);
+
+	if (s_frameSpikeThresholdSeconds > 0.0 && frameSeconds > s_frameSpikeThresholdSeconds)
+	{
+		spikeSeconds = frameSeconds;
+		thresholdSeconds = s_frameSpikeThresholdSeconds;
+	}
+	else if (scopeSpike != 0)
+	{
+		uint32_t nameID = (uint32_t)(scopeSpike >> SCOPE_SPIKE_ID_SHIFT) - 1;
+		{
+			std::lock_guard<std::mutex> namesLock(s_internedNamesMutex);
+			scopeName = s_internedNamesByID[nameID];
+		}
+
+		spikeSeconds = Profiler_ConvertTicksToSeconds(scopeSpike & SCOPE_SPIKE_TICKS_MASK);
+		thresholdSeconds = Profiler_ConvertTicksToSeconds(s_scopeSpikeThresholds[nameID].load(std::memory_order_relaxed));
+	}
+	else
+	{
+		return;
+	}
+
+
+	// A spike inside a capture that is still filling in is already kept, a run of slow frames makes one capture instead of many
+	if (!s_spikeCaptures.empty() && s_spikeCaptures.back()->m_frames.back() == closedFrame)
+	{
+		return;
+	}
+
+	StartSpikeCapture(scopeName, spikeSeconds, thresholdSeconds);
+}
+
+
+
+void Profiler_SetFrameSpikeThreshold(double seconds)
+{
+	s_frameSpikeThresholdSeconds = std::max(seconds, 0.0);
+}
+
+
+
+double Profiler_GetFrameSpikeThreshold()
+{
+	return s_frameSpikeThresholdSeconds;
+}
+
+
+
+bool Profiler_SetScopeSpikeThreshold(const char* name, double seconds)
+{
+	uint32_t nameID = 0;
+	InternName(name, nameID);
+	if (nameID >= MAX_NUM_SCOPE_SPIKE_THRESHOLDS)
+	{
+		return false;
+	}
+
+	uint64_t thresholdTicks = (seconds > 0.0) ? std::max(ProfilerClock_ConvertSecondsToTicks(seconds), (uint64_t)1) : 0;
+	uint64_t oldThresholdTicks = s_scopeSpikeThresholds[nameID].exchange(thresholdTicks, std::memory_order_relaxed);
+
+	if (oldThresholdTicks == 0 && thresholdTicks != 0)
+	{
+		s_numScopeSpikeThresholds.fetch_add(1, std::memory_order_relaxed);
+	}
+	else if (oldThresholdTicks != 0 && thresholdTicks == 0)
+	{
+		s_numScopeSpikeThresholds.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	return true;
+}
+
+
+
+void Profiler_SetSpikeCaptureNeighbours(int numNeighbours)
+{
+	GUARANTEE_OR_DIE(numNeighbours >= 0 && numNeighbours < MAX_NUM_OLD_TREES, "Spike capture neighbours must fit in the frame ring");
+	s_numSpikeNeighbours = numNeighbours;
+}
+
+
+
+int Profiler_GetNumSpikeCaptures()
+{
+	std::lock_guard<std::mutex> listLock(s_threadListMutex);
+	return (int)s_spikeCaptures.size();
+}
+
+
+
+ProfilerSpikeCapture Profiler_GetSpikeCapture(int captureIndex)
+{
+	std::lock_guard<std::mutex> listLock(s_threadListMutex);
+	GUARANTEE_OR_DIE(captureIndex >= 0 && captureIndex < (int)s_spikeCaptures.size(), "Spike capture index out of range");
+
+	const ProfilerSpikeRecord* record = s_spikeCaptures[captureIndex];
+
+	ProfilerSpikeCapture capture;
+	capture.m_spikeFrameNumber	= record->m_spikeFrameNumber;
+	capture.m_scopeName			= record->m_scopeName;
+	capture.m_spikeSeconds		= record->m_spikeSeconds;
+	capture.m_thresholdSeconds	= record->m_thresholdSeconds;
+	capture.m_spikeIndex		= record->m_spikeIndex;
+
+	for (int i = 0; i < (int)record->m_frames.size(); ++i)
+	{
+		const ProfilerFrame* frame = record->m_frames[i];
+		capture.m_frameTrees.push_back(frame->m_timelines[0]->m_root);
+
+		capture.m_threadTrees.emplace_back();
+		for (int j = 0; j < (int)frame->m_timelines.size(); ++j)
+		{
+			capture.m_threadTrees.back().push_back(frame->m_timelines[j]->m_root);
+		}
+	}
+
+	return capture;
+}
+
+
+
+void Profiler_ClearSpikeCaptures()
+{
+	std::lock_guard<std::mutex> listLock(s_threadListMutex);
+
+	for (int i = 0; i < (int)s_spikeCaptures.size(); ++i)
+	{
+		ReleaseSpikeCapture(s_spikeCaptures[i]);
+	}
+	s_spikeCaptures.clear();
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Rolling Reports ------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// NOTE: Main thread only, Profiler_BeginFrame updates them while holding s_threadListMutex
+void RollingValues_Add(RollingValues& values, const RollingValues& other)
+{
+	values.m_callCount			+= other.m_callCount;
+	values.m_elapsedHPC			+= other.m_elapsedHPC;
+	values.m_selfHPC			+= other.m_selfHPC;
+	values.m_numAllocations		+= other.m_numAllocations;
+	values.m_bytesAllocated		+= other.m_bytesAllocated;
+	values.m_bytesFreed			+= other.m_bytesFreed;
+	values.m_selfNumAllocations	+= other.m_selfNumAllocations;
+	values.m_selfBytesAllocated	+= other.m_selfBytesAllocated;
+	values.m_selfBytesFreed		+= other.m_selfBytesFreed;
+}
+
+
+
+void RollingValues_Blend(RollingValues& average, const RollingValues& frame, double weight)
+{
+	average.m_callCount				+= (frame.m_callCount - average.m_callCount) * weight;
+	average.m_elapsedHPC			+= (frame.m_elapsedHPC - average.m_elapsedHPC) * weight;
+	average.m_selfHPC				+= (frame.m_selfHPC - average.m_selfHPC) * weight;
+	average.m_numAllocations		+= (frame.m_numAllocations - average.m_numAllocations) * weight;
+	average.m_bytesAllocated		+= (frame.m_bytesAllocated - average.m_bytesAllocated) * weight;
+	average.m_bytesFreed			+= (frame.m_bytesFreed - average.m_bytesFreed) * weight;
+	average.m_selfNumAllocations	+= (frame.m_selfNumAllocations - average.m_selfNumAllocations) * weight;
+	average.m_selfBytesAllocated	+= (frame.m_selfBytesAllocated - average.m_selfBytesAllocated) * weight;
+	average.m_selfBytesFreed		+= (frame.m_selfBytesFreed - average.m_selfBytesFreed) * weight;
+}
+
+
+
+void RollingValues_AddNode(RollingValues& values, const ProfilerNode* node)
+{
+	ProfilerMemoryCounts selfMemory = node->GetSelfMemory();
+
+	values.m_callCount			+= 1.0;
+	values.m_elapsedHPC			+= (double)node->GetElapsedTimeHPC();
+	values.m_selfHPC			+= (double)node->GetSelfTimeHPC();
+	values.m_numAllocations		+= (double)node->m_memory.m_numAllocations;
+	values.m_bytesAllocated		+= (double)node->m_memory.m_bytesAllocated;
+	values.m_bytesFreed			+= (double)node->m_memory.m_bytesFreed;
+	values.m_selfNumAllocations	+= (double)selfMemory.m_numAllocations;
+	values.m_selfBytesAllocated	+= (double)selfMemory.m_bytesAllocated;
+	values.m_selfBytesFreed		+= (double)selfMemory.m_bytesFreed;
+}
+
+
+
+double RollingReport_GetSortKey(const RollingValues& values, eFlatReportSortMode sortMode)
+{
+	switch (sortMode)
+	{
+	case FLAT_REPORT_SORT_MODE_TOTAL_TIME:				return values.m_elapsedHPC;
+	case FLAT_REPORT_SORT_MODE_SELF_ALLOCATIONS:		return values.m_selfNumAllocations;
+	case FLAT_REPORT_SORT_MODE_SELF_BYTES_ALLOCATED:	return values.m_selfBytesAllocated;
+	case FLAT_REPORT_SORT_MODE_TOTAL_BYTES_ALLOCATED:	return values.m_bytesAllocated;
+	case FLAT_REPORT_SORT_MODE_SELF_TIME:
+	default:											return values.m_selfHPC;
+	}
+}
+
+
+
+// Every main thread root has its own "Frame N" name, the rolling report folds them all into one scope
+void RollingReport_Reset(ProfilerRollingReport* report)
+{
+	static const char* FRAME_SCOPE_NAME = "Frame";
+
+	report->m_numFramesAveraged = 0;
+
+	report->m_nestedScopes.clear();
+	report->m_nestedScopes.emplace_back();
+	report->m_nestedScopes[0].m_name = FRAME_SCOPE_NAME;
+	report->m_nestedIndices.clear();
+
+	report->m_flatScopes.clear();
+	report->m_flatScopes.emplace_back();
+	report->m_flatScopes[0].m_name = FRAME_SCOPE_NAME;
+	report->m_flatIndices.clear();
+
+	report->m_flatOrder.assign(1, 0);
+	report->m_nestedOrder.assign(1, 0);
+	++report->m_flatOrderVersion;
+	++report->m_nestedOrderVersion;
+}
+
+
+
+int RollingReport_FindOrAddFlatScope(ProfilerRollingReport* report, const char* name, uint32_t nameID)
+{
+	auto found = report->m_flatIndices.find(nameID);
+	if (found != report->m_flatIndices.end())
+	{
+		return found->second;
+	}
+
+	int flatIndex = (int)report->m_flatScopes.size();
+	report->m_flatScopes.emplace_back();
+	report->m_flatScopes[flatIndex].m_name = name;
+	report->m_flatScopes[flatIndex].m_nameID = nameID;
+	report->m_flatIndices.emplace(nameID, flatIndex);
+
+	// New scopes start at the bottom and climb as their averages do
+	report->m_flatOrder.push_back(flatIndex);
+	++report->m_flatOrderVersion;
+
+	return flatIndex;
+}
+
+
+
+int RollingReport_FindOrAddNestedScope(ProfilerRollingReport* report, int parentIndex, const char* name, uint32_t nameID)
+{
+	uint64_t key = ((uint64_t)parentIndex << 32) | (uint64_t)nameID;
+	auto found = report->m_nestedIndices.find(key);
+	if (found != report->m_nestedIndices.end())
+	{
+		return found->second;
+	}
+
+	int flatIndex = RollingReport_FindOrAddFlatScope(report, name, nameID);
+
+	int index = (int)report->m_nestedScopes.size();
+	report->m_nestedScopes.emplace_back();
+	RollingScope& scope = report->m_nestedScopes[index];
+	scope.m_name = name;
+	scope.m_nameID = nameID;
+	scope.m_flatIndex = flatIndex;
+	scope.m_depth = report->m_nestedScopes[parentIndex].m_depth + 1;
+	report->m_nestedIndices.emplace(key, index);
+
+	// Slot it in among its siblings by name
+	int previousIndex = -1;
+	int nextIndex = report->m_nestedScopes[parentIndex].m_firstChild;
+	while (nextIndex != -1 && strcmp(report->m_nestedScopes[nextIndex].m_name, name) < 0)
+	{
+		previousIndex = nextIndex;
+		nextIndex = report->m_nestedScopes[nextIndex].m_nextSibling;
+	}
+
+	scope.m_nextSibling = nextIndex;
+	if (previousIndex == -1)
+	{
+		report->m_nestedScopes[parentIndex].m_firstChild = index;
+	}
+	else
+	{
+		report->m_nestedScopes[previousIndex].m_nextSibling = index;
+	}
+
+	return index;
+}
+
+
+
+void RollingReport_AddToNestedOrder_Recursive(ProfilerRollingReport* report, int index)
+{
+	report->m_nestedOrder.push_back(index);
+
+	for (int childIndex = report->m_nestedScopes[index].m_firstChild; childIndex != -1; childIndex = report->m_nestedScopes[childIndex].m_nextSibling)
+	{
+		RollingReport_AddToNestedOrder_Recursive(report, childIndex);
+	}
+}
+
+
+
+// Averages drift a little every frame, so the order is almost always still sorted or a swap or two away from it
+//	Insertion sort costs a single pass in that case and never touches the order unless something actually moved
+void RollingReport_RankFlatScopes(ProfilerRollingReport* report)
+{
+	std::vector<int>& order = report->m_flatOrder;
+	bool hasOrderChanged = false;
+
+	for (int i = 1; i < (int)order.size(); ++i)
+	{
+		int index = order[i];
+		double key = RollingReport_GetSortKey(report->m_flatScopes[index].m_average, report->m_sortMode);
+
+		int j = i;
+		while (j > 0 && RollingReport_GetSortKey(report->m_flatScopes[order[j - 1]].m_average, report->m_sortMode) < key)
+		{
+			order[j] = order[j - 1];
+			--j;
+		}
+
+		if (j != i)
+		{
+			order[j] = index;
+			hasOrderChanged = true;
+		}
+	}
+
+	if (hasOrderChanged)
+	{
+		++report->m_flatOrderVersion;
+	}
+}
+
+
+
+void RollingReport_Update(ProfilerRollingReport* report, const ProfilerNode* frameRoot)
+{
+	// Sum this frame's calls per scope
+	static std::vector<std::pair<const ProfilerNode*, int>> s_nodeStack;
+	s_nodeStack.clear();
+	s_nodeStack.emplace_back(frameRoot, 0);
+
+	while (!s_nodeStack.empty())
+	{
+		const ProfilerNode* node = s_nodeStack.back().first;
+		int index = s_nodeStack.back().second;
+		s_nodeStack.pop_back();
+
+		RollingValues_AddNode(report->m_nestedScopes[index].m_frame, node);
+
+		for (const ProfilerNode* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
+		{
+			// Trees built by hand may not carry IDs
+			uint32_t nameID = child->m_nameID;
+			if (nameID == PROFILER_INVALID_NAME_ID)
+			{
+				InternName(child->m_name, nameID);
+			}
+
+			int childIndex = RollingReport_FindOrAddNestedScope(report, index, child->m_name, nameID);
+			s_nodeStack.emplace_back(child, childIndex);
+		}
+	}
+
+
+	// Blend the frame in, scopes that didn't run this frame decay towards zero
+	//	The first frame is taken as is so the averages don't have to climb up from nothing
+	double weight = (report->m_numFramesAveraged == 0) ? 1.0 : report->m_smoothing;
+
+	for (int i = 0; i < (int)report->m_flatScopes.size(); ++i)
+	{
+		report->m_flatScopes[i].m_frame = RollingValues();
+	}
+
+	for (int i = 0; i < (int)report->m_nestedScopes.size(); ++i)
+	{
+		RollingScope& scope = report->m_nestedScopes[i];
+		RollingValues_Add(report->m_flatScopes[scope.m_flatIndex].m_frame, scope.m_frame);
+		RollingValues_Blend(scope.m_average, scope.m_frame, weight);
+		scope.m_frame = RollingValues();
+	}
+
+	for (int i = 0; i < (int)report->m_flatScopes.size(); ++i)
+	{
+		RollingValues_Blend(report->m_flatScopes[i].m_average, report->m_flatScopes[i].m_frame, weight);
+	}
+
+	++report->m_numFramesAveraged;
+
+
+	// Orders
+	RollingReport_RankFlatScopes(report);
+
+	if (report->m_nestedOrder.size() != report->m_nestedScopes.size())
+	{
+		report->m_nestedOrder.clear();
+		RollingReport_AddToNestedOrder_Recursive(report, 0);
+		++report->m_nestedOrderVersion;
+	}
+}
+
+
+
+// The closed frame has just been pushed onto the ring
+void UpdateRollingReports(ProfilerFrame* closedFrame)
+{
+	if (s_rollingReports.empty())
+	{
+		return;
+	}
+
+	// Events mode frames are built here instead of when someone first asks for them
+	MaterializeTimeline(closedFrame->m_timelines[0]);
+	const ProfilerNode* frameRoot = closedFrame->m_timelines[0]->m_root;
+
+	for (int i = 0; i < (int)s_rollingReports.size(); ++i)
+	{
+		RollingReport_Update(s_rollingReports[i], frameRoot);
+	}
+}
+
+
+
+// Every thread of the closed frame goes to the capture, if one is running
+void UpdateCapture(ProfilerFrame* closedFrame)
+{
+	if (!Profiler_IsCapturing())
+	{
+		return;
+	}
+
+	static std::vector<ProfilerNode*> s_threadTrees;
+	s_threadTrees.clear();
+	for (int i = 0; i < (int)closedFrame->m_timelines.size(); ++i)
+	{
+		MaterializeTimeline(closedFrame->m_timelines[i]);
+		s_threadTrees.push_back(closedFrame->m_timelines[i]->m_root);
+	}
+
+	ProfilerCapture_AddFrame(closedFrame->m_frameNumber, s_threadTrees);
+}
+
+
+
+ProfilerRollingReport* Profiler_CreateRollingReport(eFlatReportSortMode sortMode, float smoothing)
+{
+	GUARANTEE_OR_DIE(sortMode > FLAT_REPORT_SORT_MODE_INVALID && sortMode < FLAT_REPORT_SORT_MODE_COUNT, "Invalid rolling report sort mode");
+	GUARANTEE_OR_DIE(smoothing > 0.0f && smoothing <= 1.0f, "Rolling report smoothing must be in (0,1]");
+
+	ProfilerRollingReport* report = new ProfilerRollingReport();
+	report->m_sortMode = sortMode;
+	report->m_smoothing = (double)smoothing;
+	RollingReport_Reset(report);
+
+	s_rollingReports.push_back(report);
+	return report;
+}
+
+
+
+void Profiler_DestroyRollingReport(ProfilerRollingReport* report)
+{
+	auto found = std::find(s_rollingReports.begin(), s_rollingReports.end(), report);
+	GUARANTEE_OR_DIE(found != s_rollingReports.end(), "Rolling report was not created by Profiler_CreateRollingReport");
+
+	s_rollingReports.erase(found);
+	delete report;
+}
+
+
+
+void Profiler_SetRollingReportSortMode(ProfilerRollingReport* report, eFlatReportSortMode sortMode)
+{
+	GUARANTEE_OR_DIE(sortMode > FLAT_REPORT_SORT_MODE_INVALID && sortMode < FLAT_REPORT_SORT_MODE_COUNT, "Invalid rolling report sort mode");
+
+	if (report->m_sortMode != sortMode)
+	{
+		report->m_sortMode = sortMode;
+		std::stable_sort(report->m_flatOrder.begin(), report->m_flatOrder.end(), [report](int lhs, int rhs)
+		{
+			return RollingReport_GetSortKey(report->m_flatScopes[lhs].m_average, report->m_sortMode) > RollingReport_GetSortKey(report->m_flatScopes[rhs].m_average, report->m_sortMode);
+		});
+		++report->m_flatOrderVersion;
+	}
+}
+
+
+
+void Profiler_ClearRollingReport(ProfilerRollingReport* report)
+{
+	RollingReport_Reset(report);
+}
+
+
+
+unsigned int Profiler_GetRollingReportOrderVersion(ProfilerRollingReport* report)
+{
+	return report->m_flatOrderVersion;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Threads --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// A state Profiler_Destroy left to its thread, nothing else can reach it and its timeline never made it onto the free list
+void DestroyOrphanedThreadState()
+{
+	ProfilerThreadState* state = t_threadState;
+
+	// Whatever is freed from here on can't be counted against it, and a late sample can't land in it
+	ProfilerSampling_UnregisterThread();
+	t_threadState = nullptr;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+
+	delete state->m_timeline;
+	DestroyThreadState(state);
+}
+
+
+
+// Flags the thread's state as dead when the thread exits, Profiler_BeginFrame retires its last tree and frees it
+//	Taken under s_threadListMutex so Profiler_Destroy either frees it first or leaves it to us
+struct ProfilerThreadExitHook
+{
+	~ProfilerThreadExitHook()
+	{
+		if (t_threadState != nullptr)
+		{
+			std::lock_guard<std::mutex> listLock(s_threadListMutex);
+
+			if (t_threadState->m_isOrphaned.load(std::memory_order_relaxed))
+			{
+				DestroyOrphanedThreadState();
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> threadLock(t_threadState->m_lock);
+				t_threadState->m_isAlive = false;
+			}
+
+			// Whatever the thread frees on its way out can't be counted against a state that is about to be deleted
+			//	and a late sample can't land in it either
+			ProfilerSampling_UnregisterThread();
+			t_threadState = nullptr;
+		}
+	}
+};
+thread_local ProfilerThreadExitHook t_threadExitHook;
+
+
+
+ProfilerThreadState* GetOrCreateThreadState()
+{
+	// The profiler was destroyed and started again under us, a scope still open from before finishes on the old state
+	if (t_threadState != nullptr && t_threadState->m_isOrphaned.load(std::memory_order_relaxed) 
+		&& t_threadState->m_nodeStack.empty() && t_threadState->m_numOpenEvents == 0)
+	{
+		DestroyOrphanedThreadState();
+	}
+
+	if (t_threadState == nullptr)
+	{
+		ProfilerThreadState* state = new ProfilerThreadState();
+		state->m_nodeStack.reserve(64);
+
+		// perf only counts the thread that opened the counters, this is the only place we are sure to be on it
+		if (g_isCountingHardware)
+		{
+			ProfilerCounters_OpenGroup(state->m_counterGroup);
+		}
+
+		{
+			std::lock_guard<std::mutex> listLock(s_threadListMutex);
+
+			char threadName[32];
+			snprintf(threadName, sizeof(threadName), "Thread %d", s_numThreadsRegistered);
+			++s_numThreadsRegistered;
+			state->m_name = Profiler_InternName(threadName);
+
+			state->m_timeline = StartTimeline(state, ProfilerClock_GetCurrentTicks());
+			s_threadStates.push_back(state);
+
+			if (s_isSampling)
+			{
+				state->m_sampleBuffer.store(new ProfilerSampleBuffer(), std::memory_order_release);
+			}
+		}
+
+		ProfilerSampling_RegisterThread(&state->m_sampleBuffer);
+		t_threadState = state;
+		(void)&t_threadExitHook; // Thread locals are only constructed once they are used, this is that use
+	}
+
+	return t_threadState;
+}
+
+
+
+void Profiler_SetThreadName(const char* name)
+{
+	ProfilerThreadState* state = GetOrCreateThreadState();
+	const char* internedName = Profiler_InternName(name);
+
+	std::lock_guard<std::mutex> threadLock(state->m_lock);
+	state->m_name = internedName;
+	if (state != s_mainThreadState)
+	{
+		state->m_timeline->m_root->m_name = internedName;
+	}
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Composition ----------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+void Profiler_Initialize()
+{
+	// Before anything records a timestamp
+	ProfilerClock_Initialize();
+	ProfilerCounters_Initialize();
+
+	RegisterCommand("ProfilerPause", Profiler_Pause_Command);
+	RegisterCommand("ProfilerUnpause", Profiler_Unpause_Command);
+	RegisterCommand("ProfilerBenchmark", Profiler_Benchmark_Command);
+	RegisterCommand("ProfilerReportBenchmark", Profiler_ReportBenchmark_Command);
+	RegisterCommand("ProfilerRecordMode", Profiler_RecordMode_Command);
+	RegisterCommand("ProfilerExportTrace", Profiler_ExportTrace_Command);
+	RegisterCommand("ProfilerStatistics", Profiler_Statistics_Command);
+	RegisterCommand("ProfilerClock", Profiler_Clock_Command);
+	RegisterCommand("ProfilerMemory", Profiler_Memory_Command);
+	RegisterCommand("ProfilerCounters", Profiler_Counters_Command);
+	RegisterCommand("ProfilerSpikeThreshold", Profiler_SpikeThreshold_Command);
+	RegisterCommand("ProfilerScopeSpikeThreshold", Profiler_ScopeSpikeThreshold_Command);
+	RegisterCommand("ProfilerSpikes", Profiler_Spikes_Command);
+	RegisterCommand("ProfilerCapture", Profiler_Capture_Command);
+	RegisterCommand("ProfilerSampling", Profiler_Sampling_Command);
+
+
+	// The thread that initializes the profiler owns the frame, it has to be the one calling Profiler_BeginFrame
+	ProfilerThreadState* mainState = GetOrCreateThreadState();
+
+	std::lock_guard<std::mutex> listLock(s_threadListMutex);
+	s_mainThreadState = mainState;
+	s_threadStates.erase(std::find(s_threadStates.begin(), s_threadStates.end(), mainState));
+	s_threadStates.insert(s_threadStates.begin(), mainState);
+}
+
+
+
+// NOTE: Other threads that recorded into the profiler can't be in a scope when this is called
+//	Their states are left to them, each thread frees its own the next time it records or when it exits
+void Profiler_Destroy()
+{
+	Profiler_SetMemoryTracking(false);
+	Profiler_StopCapture();
+	Profiler_StopSampling();
+	ProfilerSampling_UnregisterThread();
+
+	std::lock_guard<std::mutex> listLock(s_threadListMutex);
+
+	for (int i = 0; i < (int)s_oldTrees.size(); ++i)
+	{
+		ReleaseFrame(s_oldTrees[i]);
+	}
+	s_oldTrees.clear();
+
+	for (int i = 0; i < (int)s_spikeCaptures.size(); ++i)
+	{
+		ReleaseSpikeCapture(s_spikeCaptures[i]);
+	}
+	s_spikeCaptures.clear();
+
+	for (int i = 0; i < (int)s_threadStates.size(); ++i)
+	{
+		ProfilerThreadState* state = s_threadStates[i];
+		if (state != t_threadState && state->m_isAlive)
+		{
+			state->m_isOrphaned.store(true, std::memory_order_relaxed);
+			continue;
+		}
+
+		RecycleTimeline(state->m_timeline);
+		DestroyThreadState(state);
+	}
+	s_threadStates.clear();
+	s_mainThreadState = nullptr;
+	t_threadState = nullptr;
+
+	for (int i = 0; i < (int)s_freeFrames.size(); ++i)
+	{
+		delete s_freeFrames[i];
+	}
+	s_freeFrames.clear();
+
+	for (int i = 0; i < (int)s_freeTimelines.size(); ++i)
+	{
+		delete s_freeTimelines[i];
+	}
+	s_freeTimelines.clear();
+
+	// Reports still alive keep their own pools, the cache only has the ones nobody is using
+	{
+		std::lock_guard<std::mutex> poolsLock(s_freeReportPoolsMutex);
+		for (int i = 0; i < (int)s_freeReportPools.size(); ++i)
+		{
+			delete s_freeReportPools[i];
+		}
+		s_freeReportPools.clear();
+	}
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Updating -------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+void Profiler_BeginFrame()
+{
+	GUARANTEE_OR_DIE(t_threadState != nullptr && t_threadState == s_mainThreadState, "Profiler_BeginFrame must be called from the thread that initialized the profiler");
+	GUARANTEE_OR_DIE(s_mainThreadState->m_nodeStack.size() == 0, "Uneven number of pushes/pops in the profiler");
+	
+	
+	++s_frameCounter;
+
+	{
+		std::lock_guard<std::mutex> listLock(s_threadListMutex);
+
+
+		// Close every thread's tree
+		ProfilerFrame* closedFrame = AcquireFrame();
+		closedFrame->m_frameNumber = s_frameCounter - 1;
+
+		for (int i = 0; i < (int)s_threadStates.size();)
+		{
+			ProfilerThreadState* state = s_threadStates[i];
+			ProfilerTimeline* closedTimeline = SwapTimeline(state);
+
+			// Threads that didn't record anything this frame are left out of it
+			if (state == s_mainThreadState || closedTimeline->m_root->m_firstChild != nullptr || closedTimeline->m_eventBuffer != nullptr || closedTimeline->m_numSamples > 0)
+			{
+				closedFrame->m_timelines.push_back(closedTimeline);
+			}
+			else
+			{
+				RecycleTimeline(closedTimeline);
+			}
+
+			// The thread has exited and this was its last tree
+			if (!state->m_isAlive)
+			{
+				RecycleTimeline(state->m_timeline);
+				DestroyThreadState(state);
+				s_threadStates.erase(s_threadStates.begin() + i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+
+		// If the profiler is not paused add the closed frame to the list of old trees
+		//	The very first call has no frame before it, everything recorded up to now is thrown away
+		if (!Profiler_IsPaused() && s_hasBegunFrame)
+		{
+			// Here we want to save off the current tree to some location 
+			// If the number of old trees we are storing is getting to large we want to recycle the oldest one
+			if (s_oldTrees.size() >= MAX_NUM_OLD_TREES)
+			{
+				ReleaseFrame(s_oldTrees.front());
+				s_oldTrees.pop_front();
+			}
+			s_oldTrees.push_back(closedFrame);
+
+			UpdateSpikeCaptures(closedFrame);
+			UpdateRollingReports(closedFrame);
+			UpdateCapture(closedFrame);
+		}
+		else
+		{
+			// Else recycle it
+			// NOTE: So we don't have to manage pause state all over
+			//			Even if we are paused we keep generating trees we just throw them away at the end of the frame
+			ReleaseFrame(closedFrame);
+			s_pendingScopeSpike.store(0, std::memory_order_relaxed);
+		}
+
+		s_hasBegunFrame = true;
+	}
+
+
+	// Toggle pause state 
+	if (s_shouldTogglePauseState)
+	{
+		s_isPaused = !s_isPaused;
+		s_shouldTogglePauseState = false;
+	}
+}
+
+
+void Profiler_EndFrame()
+{
+
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Current Tree Stack Manipulation --------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Tree mode -------------------------------------------------------------------------------------
+// The owning thread's side of the handoff, see ProfilerThreadState
+void BeginRecording(ProfilerThreadState* state)
+{
+	while (true)
+	{
+		state->m_isRecording.exchange(true, std::memory_order_seq_cst);
+		if (!state->m_isSwapping.load(std::memory_order_seq_cst))
+		{
+			return;
+		}
+
+		// Profiler_BeginFrame is swapping our timeline, step back until it has the new one in place
+		state->m_isRecording.store(false, std::memory_order_seq_cst);
+		while (state->m_isSwapping.load(std::memory_order_acquire))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+
+
+void EndRecording(ProfilerThreadState* state)
+{
+	state->m_isRecording.store(false, std::memory_order_release);
+}
+
+
+
+void PushNode(ProfilerThreadState* state, const char* internedName, uint32_t nameID)
+{
+	BeginRecording(state);
+
+	ProfilerNode* node = state->m_timeline->m_arena.Create<ProfilerNode>(internedName, nameID);
+	node->m_memory = ReadMemoryCounts(state);
+	node->m_counters = ReadHardwareCounts(state);
+
+	if (state->m_nodeStack.size() > 0)
+	{
+		ProfilerNode* top = state->m_nodeStack.back();
+		top->AddChild(node);
+	}
+
+	state->m_nodeStack.push_back(node);
+	EndRecording(state);
+}
+
+
+
+void PopNode(ProfilerThreadState* state)
+{
+	BeginRecording(state);
+
+	if (state->m_nodeStack.size() > 1)
+	{
+		// The stack will still have nodes on it
+		ProfilerNode* top = state->m_nodeStack.back();
+
+
+		top->m_endHPC = ProfilerClock_GetCurrentTicks();
+		top->m_memory = ReadMemoryCounts(state) - top->m_memory;
+		top->m_counters = ReadHardwareCounts(state) - top->m_counters;
+		CheckForScopeSpike(top->m_nameID, top->GetElapsedTimeHPC());
+
+
+		state->m_nodeStack.pop_back();
+	}
+	else if (state->m_nodeStack.size() == 1)
+	{
+		// This is the last node
+		ProfilerNode* top = state->m_nodeStack.back();
+
+
+		// Update node
+		top->m_endHPC = ProfilerClock_GetCurrentTicks();
+		top->m_memory = ReadMemoryCounts(state) - top->m_memory;
+		top->m_counters = ReadHardwareCounts(state) - top->m_counters;
+		CheckForScopeSpike(top->m_nameID, top->GetElapsedTimeHPC());
+
+
+		// Remove node from stack
+		state->m_nodeStack.pop_back();
+
+
+		// Add subtree to current tree
+		state->m_timeline->m_root->AddChild(top); // This subtree is a direct child of the frame
+	}
+	else 
+	{
+		// Bad Shit, we popped an empty stack
+		GUARANTEE_OR_DIE(false, "Uneven number of pushes/pops in the profiler");
+	}
+
+	EndRecording(state);
+}
+
+
+
+// Events mode -----------------------------------------------------------------------------------
+void PushEvent(ProfilerThreadState* state, uint32_t nameID)
+{
+	GUARANTEE_OR_DIE(state->m_numOpenEvents < MAX_EVENT_DEPTH, "Profiler scopes nested too deep for events mode");
+
+	if (state->m_eventBuffer == nullptr)
+	{
+		std::lock_guard<std::mutex> threadLock(state->m_lock);
+		state->m_eventBuffer = std::make_shared<ProfilerEventBuffer>(s_eventBufferCapacity);
+		state->m_eventsFrameStart = 0;
+	}
+
+	ProfilerOpenEvent& openEvent = state->m_openEvents[state->m_numOpenEvents];
+	openEvent.m_nameID = nameID;
+	++state->m_numOpenEvents;
+
+	openEvent.m_startHPC = ProfilerClock_GetCurrentTicks();
+}
+
+
+
+void PopEvent(ProfilerThreadState* state)
+{
+	uint64_t endHPC = ProfilerClock_GetCurrentTicks();
+
+	GUARANTEE_OR_DIE(state->m_numOpenEvents > 0, "Uneven number of pushes/pops in the profiler");
+	--state->m_numOpenEvents;
+	const ProfilerOpenEvent& openEvent = state->m_openEvents[state->m_numOpenEvents];
+
+	ProfilerEventBuffer* buffer = state->m_eventBuffer.get();
+	uint64_t writeIndex = buffer->m_writeIndex.load(std::memory_order_relaxed);	// We are the only writer
+
+	// Orders our last index store before the overwrite, see ProfilerEventBuffer, only a compiler barrier on x86
+	std::atomic_thread_fence(std::memory_order_release);
+
+	ProfilerEventSlot& slot = buffer->m_events[writeIndex & buffer->m_mask];
+	slot.m_nameID.store(openEvent.m_nameID, std::memory_order_relaxed);
+	slot.m_depth.store((uint32_t)state->m_numOpenEvents, std::memory_order_relaxed);
+	slot.m_startHPC.store(openEvent.m_startHPC, std::memory_order_relaxed);
+	slot.m_endHPC.store(endHPC, std::memory_order_relaxed);
+
+	buffer->m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+
+	CheckForScopeSpike(openEvent.m_nameID, endHPC - openEvent.m_startHPC);
+}
+
+
+
+// Dispatch --------------------------------------------------------------------------------------
+void PushInternedName(const char* internedName, uint32_t nameID)
+{
+	ProfilerThreadState* state = GetOrCreateThreadState();
+
+	// Pick up mode changes only when nothing is open
+	if (state->m_numOpenEvents == 0 && state->m_nodeStack.empty())
+	{
+		state->m_recordMode = (eProfilerRecordMode)s_recordMode.load(std::memory_order_relaxed);
+	}
+
+	if (state->m_recordMode == PROFILER_RECORD_MODE_EVENTS)
+	{
+		PushEvent(state, nameID);
+	}
+	else
+	{
+		PushNode(state, internedName, nameID);
+	}
+}
+
+
+
+void Profiler_Push(char const* name)
+{
+	uint32_t nameID = 0;
+	const char* internedName = InternName(name, nameID);
+
+	PushInternedName(internedName, nameID);
+}
+
+
+
+void Profiler_PushScope(const ProfilerScopeDescriptor& scope)
+{
+	PushInternedName(scope.m_name, scope.m_nameID);
+}
+
+
+
+void Profiler_Pop()
+{
+	ProfilerThreadState* state = GetOrCreateThreadState();
+
+	if (state->m_recordMode == PROFILER_RECORD_MODE_EVENTS)
+	{
+		PopEvent(state);
+	}
+	else
+	{
+		PopNode(state);
+	}
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Recording Mode -------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+void Profiler_SetRecordMode(eProfilerRecordMode mode)
+{
+	GUARANTEE_OR_DIE(mode == PROFILER_RECORD_MODE_TREE || mode == PROFILER_RECORD_MODE_EVENTS, "Invalid profiler record mode");
+
+	s_recordMode.store(mode, std::memory_order_relaxed);
+}
+
+
+
+eProfilerRecordMode Profiler_GetRecordMode()
+{
+	return (eProfilerRecordMode)s_recordMode.load(std::memory_order_relaxed);
+}
+
+
+
+void Profiler_SetEventBufferCapacity(unsigned int numEvents)
+{
+	GUARANTEE_OR_DIE(numEvents > 0 && (numEvents & (numEvents - 1)) == 0, "Profiler event buffer capacity must be a power of two");
+
+	s_eventBufferCapacity = numEvents;
+}
+
+
+
+unsigned int Profiler_GetPreviousNumLostEvents(unsigned int xTreesAgo, int threadIndex)
+{
+	unsigned int numLostEvents = 0;
+
+	if (s_oldTrees.size() > xTreesAgo)
+	{
+		ProfilerFrame* frame = s_oldTrees[s_oldTrees.size() - 1 - xTreesAgo];
+		if (threadIndex >= 0 && threadIndex < (int)frame->m_timelines.size())
+		{
+			// Only known once the events have been read back
+			ProfilerTimeline* timeline = frame->m_timelines[threadIndex];
+			MaterializeTimeline(timeline);
+			numLostEvents = (unsigned int)timeline->m_numLostEvents;
+		}
+	}
+
+	return numLostEvents;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Pausing -------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+bool Profiler_IsPaused()
+{
+	return s_isPaused;
+}
+
+
+
+void Profiler_Pause()
+{
+	if (!s_isPaused)	
+	{
+		s_shouldTogglePauseState = true;
+	}
+}
+
+
+
+void Profiler_Unpause()
+{
+	if (s_isPaused)
+	{
+		s_shouldTogglePauseState = true;
+	}
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Frame Number ---------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+unsigned int Profiler_GetFrameNumber()
+{
+	return s_frameCounter;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Report Generation ----------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Report Formatting Constants(PX) ------------------------------------------------------------------------
+const int INDENT_SIZE			= 1;
+const int NAME_SIZE				= 72;
+const int CALL_COUNT_SIZE		= 8;
+const int ELAPSED_PERCENT_SIZE	= 8;
+const int ELAPSED_TIME_SIZE		= 14;
+const int SELF_PERCENT_SIZE		= 8;
+const int SELF_TIME_SIZE		= 14;
+
+
+void ParseTime(float timeInSeconds, int& intPart, float& floatPart, std::string& units)
+{
+	int unitUps = 0;
+
+	float time = timeInSeconds;
+	while(time < 1.0f)
+	{
+		time *= 1000.0f;
+
+		++unitUps;
+		if (unitUps >= 3)
+		{
+			break;
+		}
+	}
+
+
+	intPart = (int)time;
+	floatPart = time - (int)time;
+
+	if (unitUps == 0)
+	{
+		units = "s";
+	}
+	else if (unitUps == 1)
+	{
+		units = "ms";
+	}
+	else if (unitUps == 2)
+	{
+		units = "us";
+		floatPart = 0.0f;
+	}
+	else 
 	{
 		units = "ns";
 		floatPart = 0.0f;
@@ -360,107 +2771,531 @@ void ParseTime(float timeInSeconds, int& intPart, float& floatPart, std::string&
 
 
 
-// Sort Functions -------------------------------------------------------------------------------------
-bool SortFunction_TotalTime(const ReportNode* lhs, const ReportNode* rhs)
+// Sort Functions -------------------------------------------------------------------------------------
+bool SortFunction_TotalTime(const ReportNode* lhs, const ReportNode* rhs)
+{
+	bool isLHSLess = false;
+
+	if (lhs->m_elapsedTimeHPC > rhs->m_elapsedTimeHPC)
+	{
+		isLHSLess = true;
+	}
+
+	return isLHSLess;
+}
+
+
+
+bool SortFunction_SelfTime(const ReportNode* lhs, const ReportNode* rhs)
+{
+	bool isLHSLess = false;
+
+	if (lhs->m_selfTimeHPC > rhs->m_selfTimeHPC)
+	{
+		isLHSLess = true;
+	}
+
+	return isLHSLess;
+}
+
+
+
+bool SortFunction_SelfAllocations(const ReportNode* lhs, const ReportNode* rhs)
+{
+	bool isLHSLess = false;
+
+	if (lhs->m_selfMemory.m_numAllocations > rhs->m_selfMemory.m_numAllocations)
+	{
+		isLHSLess = true;
+	}
+
+	return isLHSLess;
+}
+
+
+
+bool SortFunction_SelfBytesAllocated(const ReportNode* lhs, const ReportNode* rhs)
+{
+	bool isLHSLess = false;
+
+	if (lhs->m_selfMemory.m_bytesAllocated > rhs->m_selfMemory.m_bytesAllocated)
+	{
+		isLHSLess = true;
+	}
+
+	return isLHSLess;
+}
+
+
+
+bool SortFunction_TotalBytesAllocated(const ReportNode* lhs, const ReportNode* rhs)
+{
+	bool isLHSLess = false;
+
+	if (lhs->m_memory.m_bytesAllocated > rhs->m_memory.m_bytesAllocated)
+	{
+		isLHSLess = true;
+	}
+
+	return isLHSLess;
+}
+
+
+
+// Report Tree Generation------------------------------------------------------------------------------
+// Open addressing table used to merge report nodes, nothing is ever removed so there are no tombstones
+//	Tree reports key on (parent index, name ID), flat reports key on the name ID alone
+class ReportHashTable
+{
+public:
+	struct Slot
+	{
+		uint64_t	m_key	= EMPTY_KEY;
+		ReportNode*	m_node	= nullptr;
+		uint32_t	m_index	= 0;
+	};
+
+	ReportHashTable(size_t maxNumKeys)
+		: m_slots(t_slots)
+	{
+		// Keeping the table at most half full keeps the probe chains short
+		size_t capacity = 16;
+		m_shift = 60;
+		while (capacity < maxNumKeys * 2)
+		{
+			capacity *= 2;
+			--m_shift;
+		}
+
+		// The slots are reused between reports, only a report bigger than any before it touches fresh memory
+		m_slots.assign(capacity, Slot());
+		m_mask = capacity - 1;
+	}
+
+	// Returns the slot for the key, a new slot has a null m_node
+	Slot& FindOrAdd(uint64_t key)
+	{
+		// Fibonacci hashing spreads out the small sequential name IDs
+		size_t index = (size_t)((key * 11400714819323198485ull) >> m_shift);
+		while (true)
+		{
+			Slot& slot = m_slots[index];
+			if (slot.m_key == key)
+			{
+				return slot;
+			}
+			if (slot.m_key == EMPTY_KEY)
+			{
+				slot.m_key = key;
+				return slot;
+			}
+
+			index = (index + 1) & m_mask;
+		}
+	}
+
+private:
+	static constexpr uint64_t EMPTY_KEY = ~0ull;
+	static thread_local std::vector<Slot> t_slots;
+
+	std::vector<Slot>&	m_slots;
+	size_t				m_mask;
+	int					m_shift;
+};
+
+thread_local std::vector<ReportHashTable::Slot> ReportHashTable::t_slots;
+
+
+
+template<typename NodeType>
+size_t Report_CountNodes_Recursive(const NodeType* node)
+{
+	size_t numNodes = 1;
+	for (const NodeType* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
+	{
+		numNodes += Report_CountNodes_Recursive(child);
+	}
+
+	return numNodes;
+}
+
+
+
+struct ReportBuildContext
+{
+	ProfilerArena*		m_pool;
+	ReportHashTable*	m_table;
+	uint32_t			m_numNodes;
+};
+
+
+
+// What a profiler node's children add up to, the caller takes it off the node's own totals for its self values
+struct ReportChildTotals
+{
+	uint64_t				m_elapsedHPC = 0;
+	ProfilerMemoryCounts	m_memory;
+	ProfilerHardwareCounts	m_counters;
+};
+
+
+
+void Report_GenerateChildren_Recursively(ReportBuildContext& context, ReportNode* parentNode, uint32_t parentIndex, const ProfilerNode* nodeToExtractDataFrom, ReportChildTotals& outChildTotals)
+{
+
+	for (const ProfilerNode* profilerChildNode = nodeToExtractDataFrom->m_firstChild; profilerChildNode != nullptr; profilerChildNode = profilerChildNode->m_nextSibling)
+	{
+		// Trees built by hand may not carry IDs, the intern table's thread cache makes this cheap
+		uint32_t nameID = profilerChildNode->m_nameID;
+		if (nameID == PROFILER_INVALID_NAME_ID)
+		{
+			InternName(profilerChildNode->m_name, nameID);
+		}
+
+		uint64_t key = ((uint64_t)parentIndex << 32) | (uint64_t)nameID;
+		ReportHashTable::Slot& slot = context.m_table->FindOrAdd(key);
+
+		// First time we've seen this name under this parent, later ones merge into it
+		if (slot.m_node == nullptr)
+		{
+			slot.m_node = context.m_pool->Create<ReportNode>();
+			slot.m_node->m_name = profilerChildNode->m_name;
+			slot.m_node->m_nameID = nameID;
+			slot.m_index = context.m_numNodes++;
+			parentNode->AddChild(slot.m_node);
+		}
+
+		// The table never grows, so the slot is still good after the recursion
+		uint64_t elapsedHPC = profilerChildNode->GetElapsedTimeHPC();
+		ReportChildTotals grandchildTotals;
+		Report_GenerateChildren_Recursively(context, slot.m_node, slot.m_index, profilerChildNode, grandchildTotals);
+
+		slot.m_node->m_callCount += 1;
+		slot.m_node->m_elapsedTimeHPC += elapsedHPC;
+		slot.m_node->m_selfTimeHPC += ProfilerClock_RemoveOverhead(elapsedHPC - grandchildTotals.m_elapsedHPC, profilerChildNode->m_childCount);
+		slot.m_node->m_memory += profilerChildNode->m_memory;
+		slot.m_node->m_selfMemory += profilerChildNode->m_memory - grandchildTotals.m_memory;
+		slot.m_node->m_counters += profilerChildNode->m_counters;
+		slot.m_node->m_selfCounters += profilerChildNode->m_counters - grandchildTotals.m_counters;
+
+		outChildTotals.m_elapsedHPC += elapsedHPC;
+		outChildTotals.m_memory += profilerChildNode->m_memory;
+		outChildTotals.m_counters += profilerChildNode->m_counters;
+	}
+}
+
+
+
+ReportNode*	Profiler_GenerateReportTree(ProfilerNode* node)
+{
+	GUARANTEE_OR_DIE(node != nullptr, "Cannot generate a report tree for a nullptr");
+
+	// Merging can only shrink the tree, so the profiler tree's size bounds the table
+	size_t maxNumNodes = Report_CountNodes_Recursive(node);
+
+	ReportNode* report = new ReportNode(node);
+	report->m_pool = AcquireReportPool();
+
+	// Frame names live in their frame's arena, which can be recycled before the report is deleted
+	report->m_name = report->m_pool->CopyString(node->m_name);
+
+	ReportHashTable table(maxNumNodes);
+	ReportBuildContext context;
+	context.m_pool = report->m_pool;
+	context.m_table = &table;
+	context.m_numNodes = 1;
+
+	ReportChildTotals childTotals;
+	Report_GenerateChildren_Recursively(context, report, 0, node, childTotals);
+
+	return report;
+}
+
+
+
+void Report_MergeChildren_Recursively(ProfilerArena* pool, ReportNode* parentNode, const ProfilerNode* nodeToExtractDataFrom, ReportChildTotals& outChildTotals)
+{
+	for (const ProfilerNode* profilerChildNode = nodeToExtractDataFrom->m_firstChild; profilerChildNode != nullptr; profilerChildNode = profilerChildNode->m_nextSibling)
+	{
+		uint32_t nameID = profilerChildNode->m_nameID;
+		if (nameID == PROFILER_INVALID_NAME_ID)
+		{
+			InternName(profilerChildNode->m_name, nameID);
+		}
+
+		// Siblings are few, a scan beats building a table over the whole report for every merge
+		ReportNode* reportChild = parentNode->m_firstChild;
+		while (reportChild != nullptr && reportChild->m_nameID != nameID)
+		{
+			reportChild = reportChild->m_nextSibling;
+		}
+		if (reportChild == nullptr)
+		{
+			reportChild = pool->Create<ReportNode>();
+			reportChild->m_name = profilerChildNode->m_name;
+			reportChild->m_nameID = nameID;
+			parentNode->AddChild(reportChild);
+		}
+
+		uint64_t elapsedHPC = profilerChildNode->GetElapsedTimeHPC();
+		ReportChildTotals grandchildTotals;
+		Report_MergeChildren_Recursively(pool, reportChild, profilerChildNode, grandchildTotals);
+
+		reportChild->m_callCount += 1;
+		reportChild->m_elapsedTimeHPC += elapsedHPC;
+		reportChild->m_selfTimeHPC += ProfilerClock_RemoveOverhead(elapsedHPC - grandchildTotals.m_elapsedHPC, profilerChildNode->m_childCount);
+		reportChild->m_memory += profilerChildNode->m_memory;
+		reportChild->m_selfMemory += profilerChildNode->m_memory - grandchildTotals.m_memory;
+		reportChild->m_counters += profilerChildNode->m_counters;
+		reportChild->m_selfCounters += profilerChildNode->m_counters - grandchildTotals.m_counters;
+
+		outChildTotals.m_elapsedHPC += elapsedHPC;
+		outChildTotals.m_memory += profilerChildNode->m_memory;
+		outChildTotals.m_counters += profilerChildNode->m_counters;
+	}
+}
+
+
+
+void Profiler_MergeIntoReportTree(ReportNode* report, ProfilerNode* tree)
+{
+	GUARANTEE_OR_DIE(report != nullptr && tree != nullptr, "Cannot merge a nullptr report tree");
+	GUARANTEE_OR_DIE(report->m_pool != nullptr, "Can only merge into a root returned by Profiler_GenerateReportTree");
+
+	report->m_callCount += 1;
+	report->m_elapsedTimeHPC += tree->GetElapsedTimeHPC();
+	report->m_selfTimeHPC += tree->GetSelfTimeHPC();
+	report->m_memory += tree->m_memory;
+	report->m_selfMemory += tree->GetSelfMemory();
+	report->m_counters += tree->m_counters;
+	report->m_selfCounters += tree->GetSelfCounters();
+
+	ReportChildTotals childTotals;
+	Report_MergeChildren_Recursively(report->m_pool, report, tree, childTotals);
+}
+
+
+
+// Hybrid Report---------------------------------------------------------------------------------------
+// Walks the report down the same path Profiler_FindSampleScope takes through the tree
+ReportNode* Report_FindSampleScope(ReportNode* report, const ProfilerNode* tree, const ProfilerSample& sample)
 {
-	bool isLHSLess = false;
+	ReportNode* reportNode = report;
 
-	if (lhs->m_elapsedTimeHPC > rhs->m_elapsedTimeHPC)
+	const ProfilerNode* child = tree->m_firstChild;
+	while (child != nullptr)
 	{
-		isLHSLess = true;
+		if (sample.m_ticks >= child->m_startHPC && sample.m_ticks < child->m_endHPC)
+		{
+			uint32_t nameID = child->m_nameID;
+			if (nameID == PROFILER_INVALID_NAME_ID)
+			{
+				InternName(child->m_name, nameID);
+			}
+
+			ReportNode* reportChild = reportNode->m_firstChild;
+			while (reportChild != nullptr && (reportChild->m_isSampled || reportChild->m_nameID != nameID))
+			{
+				reportChild = reportChild->m_nextSibling;
+			}
+			if (reportChild == nullptr)
+			{
+				break;
+			}
+
+			reportNode = reportChild;
+			child = child->m_firstChild;
+		}
+		else
+		{
+			child = child->m_nextSibling;
+		}
 	}
 
-	return isLHSLess;
+	return reportNode;
 }
 
 
 
-bool SortFunction_SelfTime(const ReportNode* lhs, const ReportNode* rhs)
+// Every scope's self time is handed to the functions sampled inside it, by share of its samples
+void Report_SplitSelfTimeBySamples_Recursive(ReportNode* node)
 {
-	bool isLHSLess = false;
-
-	if (lhs->m_selfTimeHPC > rhs->m_selfTimeHPC)
+	if (node->m_numSamples > 0)
 	{
-		isLHSLess = true;
+		uint64_t selfTimeHPC = node->m_selfTimeHPC;
+		uint64_t attributedHPC = 0;
+		for (ReportNode* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
+		{
+			if (child->m_isSampled)
+			{
+				uint64_t childHPC = (uint64_t)((double)selfTimeHPC * (double)child->m_callCount / (double)node->m_numSamples);
+				child->m_elapsedTimeHPC = childHPC;
+				child->m_selfTimeHPC = childHPC;
+				attributedHPC += childHPC;
+			}
+		}
+
+		// Only rounding is left behind
+		node->m_selfTimeHPC = (selfTimeHPC > attributedHPC) ? (selfTimeHPC - attributedHPC) : 0;
 	}
 
-	return isLHSLess;
+	for (ReportNode* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
+	{
+		if (!child->m_isSampled)
+		{
+			Report_SplitSelfTimeBySamples_Recursive(child);
+		}
+	}
 }
 
 
 
-// Report Tree Generation------------------------------------------------------------------------------
-ReportNode* Report_GenerateNode_Recursively(ReportNode* parentNode, ProfilerNode* nodeToExtractDataFrom)
+ReportNode* Profiler_GenerateHybridReportTree(unsigned int xTreesAgo)
 {
-	ReportNode* node = new ReportNode(nodeToExtractDataFrom);
+	ProfilerNode* tree = Profiler_GetPreviousTree(xTreesAgo);
+	if (tree == nullptr)
+	{
+		return nullptr;
+	}
 
-	if (parentNode != nullptr)
+	ReportNode* report = Profiler_GenerateReportTree(tree);
+	const ProfilerTimeline* timeline = s_oldTrees[s_oldTrees.size() - 1 - xTreesAgo]->m_timelines[0];
+
+	// The innermost frame is what was actually running, that is the function the time goes to
+	for (int i = 0; i < timeline->m_numSamples; ++i)
 	{
-		node->m_parent = parentNode;
-		
-		auto foundChild = parentNode->m_children.find(node->m_name);
-		if (foundChild == parentNode->m_children.end())
+		const ProfilerSample& sample = timeline->m_samples[i];
+		ReportNode* scope = Report_FindSampleScope(report, tree, sample);
+
+		uint32_t nameID = PROFILER_INVALID_NAME_ID;
+		const char* functionName = InternName((sample.m_numFrames > 0) ? Profiler_GetSampleFrameName(sample.m_frames[0]) : "[Unknown]", nameID);
+
+		ReportNode* function = scope->m_firstChild;
+		while (function != nullptr && (!function->m_isSampled || function->m_nameID != nameID))
 		{
-			// No node with this name in the map
-			parentNode->m_children[node->m_name] = node;
+			function = function->m_nextSibling;
 		}
-		else
+		if (function == nullptr)
 		{
-			// There is a node with this name in the map
-			ReportNode* childNode = parentNode->m_children[node->m_name];
-			childNode->m_callCount += 1;
-			childNode->m_elapsedTimeHPC += node->m_elapsedTimeHPC;
-			childNode->m_selfTimeHPC += node->m_selfTimeHPC;
-
-			delete node;
-			node = childNode;
+			function = report->m_pool->Create<ReportNode>();
+			function->m_name = functionName;
+			function->m_nameID = nameID;
+			function->m_isSampled = true;
+			scope->AddChild(function);
 		}
 
+		++function->m_callCount;
+		++scope->m_numSamples;
 	}
 
-	// Process Children
-	for (int i = 0; i < (int)nodeToExtractDataFrom->m_children.size(); ++i)
+	Report_SplitSelfTimeBySamples_Recursive(report);
+	return report;
+}
+
+
+
+// Printable Lines -------------------------------------------------------------------------------------
+void Report_SplitName(const char* name, PrintableReportLine& prl)
+{
+	const char* delimiter = strrchr(name, ':');
+	if (delimiter != nullptr)
 	{
-		ProfilerNode* profilerChildNode = nodeToExtractDataFrom->m_children[i];
-		Report_GenerateNode_Recursively(node, profilerChildNode);
+		prl.m_nameFront.assign(name, (delimiter + 1) - name);
+		prl.m_nameBack.assign(delimiter + 1);
+	}
+	else
+	{
+		prl.m_nameFront = name;
+		prl.m_nameBack.clear();
 	}
-
-	return node;
 }
 
 
 
-ReportNode*	Profiler_GenerateReportTree(ProfilerNode* node)
+PrintableReportLine Report_GeneratePrintableLine(const ReportNode* node, const ReportNode* treeRoot, int level)
 {
-	GUARANTEE_OR_DIE(node != nullptr, "Cannot generate a report tree for a nullptr");
+	PrintableReportLine prl;
 
-	ReportNode* report = Report_GenerateNode_Recursively(nullptr, node);
-	return report;
+	prl.m_indent = level;
+
+	// Name
+	Report_SplitName(node->m_name, prl);
+
+	// Call Count
+	prl.m_callCount = node->m_callCount;
+
+	// Total %
+	float elapsedPercent = ((float)node->m_elapsedTimeHPC / (float)treeRoot->m_elapsedTimeHPC) * 100.0f;
+	prl.m_totalTimePercent_intPart = (int)elapsedPercent;
+	prl.m_totalTimePercent_floatPart = elapsedPercent - (float)prl.m_totalTimePercent_intPart;
+
+	// Total Time
+	ParseTime((float)Profiler_ConvertTicksToSeconds(node->m_elapsedTimeHPC), prl.m_totalTime_intPart, prl.m_totalTime_floatPart, prl.m_totalTime_units);
+
+	// Self %
+	float selfPercent;
+	if (node->m_elapsedTimeHPC == 0)
+	{
+		selfPercent = 100.0f;
+	}
+	else
+	{
+		selfPercent = ((float)node->m_selfTimeHPC / (float)node->m_elapsedTimeHPC) * 100.0f;
+	}
+	prl.m_selfTimePercent_intPart = (int)selfPercent;
+	prl.m_selfTimePercent_floatPart = selfPercent - (float)prl.m_selfTimePercent_intPart;
+
+	// Self Time
+	ParseTime((float)Profiler_ConvertTicksToSeconds(node->m_selfTimeHPC), prl.m_selfTime_intPart, prl.m_selfTime_floatPart, prl.m_selfTime_units);
+
+	// Memory
+	prl.m_numAllocations = node->m_memory.m_numAllocations;
+	prl.m_bytesAllocated = node->m_memory.m_bytesAllocated;
+	prl.m_bytesFreed = node->m_memory.m_bytesFreed;
+	prl.m_selfNumAllocations = node->m_selfMemory.m_numAllocations;
+	prl.m_selfBytesAllocated = node->m_selfMemory.m_bytesAllocated;
+	prl.m_selfBytesFreed = node->m_selfMemory.m_bytesFreed;
+
+	// Hardware Counters
+	prl.m_counters = node->m_counters;
+	prl.m_selfCounters = node->m_selfCounters;
+
+	prl.m_isSampled = node->m_isSampled;
+
+	return prl;
 }
 
 
 
 // Flat Report------------------------------------------------------------------------------------------
-void FlatReport_GenerateNode_Recursive(std::map<std::string, ReportNode*>& report, ReportNode* node)
+void FlatReport_GenerateNode_Recursive(ProfilerArena& pool, ReportHashTable& table, std::vector<ReportNode*>& sortableReport, const ReportNode* node)
 {
-	// Get the node from the report
-	ReportNode* reportNode = report[node->m_name];
+	// Get the node from the report, a sampled function never merges with a scope of the same name
+	uint64_t key = (uint64_t)node->m_nameID | (node->m_isSampled ? (1ull << 32) : 0ull);
+	ReportHashTable::Slot& slot = table.FindOrAdd(key);
 
 	// If one doesn't exist yet create it
-	if (reportNode == nullptr)
+	if (slot.m_node == nullptr)
 	{
-		report[node->m_name] = new ReportNode();
-		reportNode = report[node->m_name];
-		reportNode->m_name = node->m_name;
+		slot.m_node = pool.Create<ReportNode>();
+		slot.m_node->m_name = node->m_name;
+		slot.m_node->m_nameID = node->m_nameID;
+		slot.m_node->m_isSampled = node->m_isSampled;
+		sortableReport.push_back(slot.m_node);
 	}
 
+	ReportNode* reportNode = slot.m_node;
 	reportNode->m_callCount += node->m_callCount;
 	reportNode->m_elapsedTimeHPC += node->m_elapsedTimeHPC;
 	reportNode->m_selfTimeHPC += node->m_selfTimeHPC;
+	reportNode->m_memory += node->m_memory;
+	reportNode->m_selfMemory += node->m_selfMemory;
+	reportNode->m_counters += node->m_counters;
+	reportNode->m_selfCounters += node->m_selfCounters;
 
-	for (auto iter = node->m_children.begin(); iter != node->m_children.end(); ++iter)
+	for (const ReportNode* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
 	{
-		FlatReport_GenerateNode_Recursive(report, iter->second);
+		FlatReport_GenerateNode_Recursive(pool, table, sortableReport, child);
 	}
 }
 
@@ -472,20 +3307,20 @@ std::vector<PrintableReportLine> Profiler_GenerateFlatReportFromTree(ReportNode*
 
 
 	// Generate the report
-	std::map<std::string, ReportNode*> report;
-	FlatReport_GenerateNode_Recursive(report, tree);
+	//	The flat nodes only live until the strings are made, so their pool is kept and reused
+	static thread_local ProfilerArena t_flatReportPool;
+	ProfilerArena& pool = t_flatReportPool;
+	pool.Reset();
 
+	size_t maxNumNodes = Report_CountNodes_Recursive(tree);
+	ReportHashTable table(maxNumNodes);
 
-	// Move the map into a vector so we can sort it
 	std::vector<ReportNode*> sortableReport;
-	sortableReport.reserve(report.size());
-	for (auto iter = report.begin(); iter != report.end(); ++iter)
-	{
-		sortableReport.push_back(iter->second);
-	}
+	sortableReport.reserve(maxNumNodes);
+	FlatReport_GenerateNode_Recursive(pool, table, sortableReport, tree);
 
 
-	// Sort the map
+	// Sort the report
 	switch(sortMode)
 	{
 	case FLAT_REPORT_SORT_MODE_SELF_TIME:
@@ -498,11 +3333,26 @@ std::vector<PrintableReportLine> Profiler_GenerateFlatReportFromTree(ReportNode*
 		std::sort(sortableReport.begin(), sortableReport.end(), SortFunction_TotalTime);
 		break;
 	}
+	case FLAT_REPORT_SORT_MODE_SELF_ALLOCATIONS:
+	{
+		std::sort(sortableReport.begin(), sortableReport.end(), SortFunction_SelfAllocations);
+		break;
+	}
+	case FLAT_REPORT_SORT_MODE_SELF_BYTES_ALLOCATED:
+	{
+		std::sort(sortableReport.begin(), sortableReport.end(), SortFunction_SelfBytesAllocated);
+		break;
+	}
+	case FLAT_REPORT_SORT_MODE_TOTAL_BYTES_ALLOCATED:
+	{
+		std::sort(sortableReport.begin(), sortableReport.end(), SortFunction_TotalBytesAllocated);
+		break;
+	}
 	case FLAT_REPORT_SORT_MODE_INVALID:
 	case FLAT_REPORT_SORT_MODE_COUNT:
 	default:
 	{
-		GUARANTEE_OR_DIE(false, "Please use flat report sort mode self or total time");
+		GUARANTEE_OR_DIE(false, "Please use a valid flat report sort mode");
 		break;
 	}
 	}
@@ -510,132 +3360,138 @@ std::vector<PrintableReportLine> Profiler_GenerateFlatReportFromTree(ReportNode*
 
 	// Generate the strings
 	std::vector<PrintableReportLine> printableReport;
-	//printableReport.push_back(Stringf("%-*s %-*s %-*s %-*s %-*s %-*s", NAME_SIZE, "FUNCTION NAME", CALL_COUNT_SIZE, "CALLS", ELAPSED_PERCENT_SIZE, "TOTAL%", ELAPSED_TIME_SIZE, "TOTAL TIME", SELF_PERCENT_SIZE, "Self%", SELF_TIME_SIZE, "SELF TIME"));
+	printableReport.reserve(sortableReport.size());
 	for (int i = 0; i < (int)sortableReport.size(); ++i)
 	{
-		ReportNode* node = sortableReport[i];
-
-		PrintableReportLine prl;
+		printableReport.push_back(Report_GeneratePrintableLine(sortableReport[i], tree, 0));
+	}
 
-		// Name
-		size_t delimiter = node->m_name.find_last_of(':');
-		if (delimiter != std::string::npos)
-		{
-			prl.m_nameFront = node->m_name.substr(0, delimiter + 1);
-			prl.m_nameBack = node->m_name.substr(delimiter+1);
-		}
-		else
-		{
-			prl.m_nameFront = node->m_name;
-		}
 
-		// Call Count
-		prl.m_callCount = node->m_callCount;
+	return printableReport;
+}
 
-		// Total %
-		float elapsedPercent = ((float)node->m_elapsedTimeHPC / (float)tree->m_elapsedTimeHPC) * 100.0f;
-		prl.m_totalTimePercent_intPart = (int)elapsedPercent;
-		prl.m_totalTimePercent_floatPart = elapsedPercent - (float)prl.m_totalTimePercent_intPart;
 
-		// Total Time
-		ParseTime((float)ConvertHPCtoSeconds(node->m_elapsedTimeHPC), prl.m_totalTime_intPart, prl.m_totalTime_floatPart, prl.m_totalTime_units);
+// Nested Report-----------------------------------------------------------------------------------
+bool SortFunction_Name(const ReportNode* lhs, const ReportNode* rhs)
+{
+	return strcmp(lhs->m_name, rhs->m_name) < 0;
+}
 
-		// Self %
-		float selfPercent;
-		if (node->m_elapsedTimeHPC == 0)
-		{
-			selfPercent = 100.0f;
-		}
-		else
-		{
-			selfPercent = ((float)node->m_selfTimeHPC / (float)node->m_elapsedTimeHPC) * 100.0f;
-		}
-		prl.m_selfTimePercent_intPart = (int)selfPercent;
-		prl.m_selfTimePercent_floatPart = selfPercent - (float)prl.m_selfTimePercent_intPart;
 
-		// Self Time
-		ParseTime((float)ConvertHPCtoSeconds(node->m_selfTimeHPC), prl.m_selfTime_intPart, prl.m_selfTime_floatPart, prl.m_selfTime_units);
-		
-		printableReport.push_back(prl);
-	}
 
+void NestedReport_AddNodeToReport_Recursive(std::vector<PrintableReportLine>& report, std::vector<const ReportNode*>& scratch, const ReportNode* node, const ReportNode* treeRoot, int level = 0)
+{
+	report.push_back(Report_GeneratePrintableLine(node, treeRoot, level));
 
-	// Free the memory we allocated to create the report
-	for (auto iter = report.begin(); iter != report.end(); ++iter)
+	// Children are listed alphabetically, the order they had back when they were keyed by name
+	//	They are sorted in a shared scratch vector, each level only ever works on the end of it
+	size_t firstChild = scratch.size();
+	for (const ReportNode* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
 	{
-		delete iter->second;
+		scratch.push_back(child);
 	}
-	report.clear();
-	sortableReport.clear();
+	size_t endChild = scratch.size();
+	std::sort(scratch.begin() + firstChild, scratch.end(), SortFunction_Name);
 
+	for (size_t i = firstChild; i < endChild; ++i)
+	{
+		NestedReport_AddNodeToReport_Recursive(report, scratch, scratch[i], treeRoot, level + 1);
+	}
 
-	return printableReport;
+	scratch.resize(firstChild);
 }
 
 
-// Nested Report-----------------------------------------------------------------------------------
-void NestedReport_AddNodeToReport_Recursive(std::vector<PrintableReportLine>& report, ReportNode* node, ReportNode* treeRoot, int level = 0)
+std::vector<PrintableReportLine> Profiler_GenerateNestedReportFromTree(ReportNode* tree)
 {
-	PrintableReportLine prl;
+	std::vector<PrintableReportLine> report;
+	report.reserve(Report_CountNodes_Recursive(tree));
 
-	prl.m_indent = level;
+	// Generate Report
+	std::vector<const ReportNode*> scratch;
+	NestedReport_AddNodeToReport_Recursive(report, scratch, tree, tree);
+	
+	return report;
+}
 
-	// Name
-	size_t delimiter = node->m_name.find_last_of(':');
-	if (delimiter != std::string::npos)
-	{
-		prl.m_nameFront = node->m_name.substr(0, delimiter + 1);
-		prl.m_nameBack = node->m_name.substr(delimiter+1);
-	}
-	else
-	{
-		prl.m_nameFront = node->m_name;
-	}
 
-	// Call Count
-	prl.m_callCount = node->m_callCount;
+
+// Rolling Report----------------------------------------------------------------------------------
+void RollingReport_FormatLine(PrintableReportLine& prl, const RollingValues& values, const RollingValues& frameValues)
+{
+	prl.m_callCount = (int)(values.m_callCount + 0.5);
 
 	// Total %
-	float elapsedPercent = ((float)node->m_elapsedTimeHPC / (float)treeRoot->m_elapsedTimeHPC) * 100.0f;
+	float elapsedPercent = (frameValues.m_elapsedHPC > 0.0) ? (float)((values.m_elapsedHPC / frameValues.m_elapsedHPC) * 100.0) : 0.0f;
 	prl.m_totalTimePercent_intPart = (int)elapsedPercent;
 	prl.m_totalTimePercent_floatPart = elapsedPercent - (float)prl.m_totalTimePercent_intPart;
 
 	// Total Time
-	ParseTime((float)ConvertHPCtoSeconds(node->m_elapsedTimeHPC), prl.m_totalTime_intPart, prl.m_totalTime_floatPart, prl.m_totalTime_units);
+	ParseTime((float)Profiler_ConvertTicksToSeconds((uint64_t)values.m_elapsedHPC), prl.m_totalTime_intPart, prl.m_totalTime_floatPart, prl.m_totalTime_units);
 
 	// Self %
-	float selfPercent;
-	if (node->m_elapsedTimeHPC == 0)
-	{
-		selfPercent = 100.0f;
-	}
-	else
-	{
-		selfPercent = ((float)node->m_selfTimeHPC / (float)node->m_elapsedTimeHPC) * 100.0f;
-	}
+	float selfPercent = (values.m_elapsedHPC > 0.0) ? (float)((values.m_selfHPC / values.m_elapsedHPC) * 100.0) : 100.0f;
 	prl.m_selfTimePercent_intPart = (int)selfPercent;
 	prl.m_selfTimePercent_floatPart = selfPercent - (float)prl.m_selfTimePercent_intPart;
 
 	// Self Time
-	ParseTime((float)ConvertHPCtoSeconds(node->m_selfTimeHPC), prl.m_selfTime_intPart, prl.m_selfTime_floatPart, prl.m_selfTime_units);
+	ParseTime((float)Profiler_ConvertTicksToSeconds((uint64_t)values.m_selfHPC), prl.m_selfTime_intPart, prl.m_selfTime_floatPart, prl.m_selfTime_units);
+
+	// Memory
+	prl.m_numAllocations		= (uint64_t)(values.m_numAllocations + 0.5);
+	prl.m_bytesAllocated		= (uint64_t)(values.m_bytesAllocated + 0.5);
+	prl.m_bytesFreed			= (uint64_t)(values.m_bytesFreed + 0.5);
+	prl.m_selfNumAllocations	= (uint64_t)(values.m_selfNumAllocations + 0.5);
+	prl.m_selfBytesAllocated	= (uint64_t)(values.m_selfBytesAllocated + 0.5);
+	prl.m_selfBytesFreed		= (uint64_t)(values.m_selfBytesFreed + 0.5);
+}
+
+
+
+// Names are only written when the order changes, the numbers once per frame however often the lines are read
+void RollingReport_FormatLines(std::vector<PrintableReportLine>& lines, unsigned int& linesOrderVersion, unsigned int& linesFrame, const std::vector<RollingScope>& scopes, const std::vector<int>& order, unsigned int orderVersion, unsigned int numFramesAveraged, bool isNested)
+{
+	bool hasOrderChanged = (linesOrderVersion != orderVersion);
+	if (!hasOrderChanged && linesFrame == numFramesAveraged)
+	{
+		return;
+	}
 
-	report.push_back(prl);
+	lines.resize(order.size());
+	const RollingValues& frameValues = scopes[0].m_average;
 
-	for (auto iter = node->m_children.begin(); iter != node->m_children.end(); ++iter)
+	for (int i = 0; i < (int)order.size(); ++i)
 	{
-		NestedReport_AddNodeToReport_Recursive(report, iter->second, treeRoot, level + 1);
+		const RollingScope& scope = scopes[order[i]];
+		PrintableReportLine& prl = lines[i];
+
+		if (hasOrderChanged)
+		{
+			prl.m_indent = isNested ? scope.m_depth : 0;
+			Report_SplitName(scope.m_name, prl);
+		}
+
+		RollingReport_FormatLine(prl, scope.m_average, frameValues);
 	}
+
+	linesOrderVersion = orderVersion;
+	linesFrame = numFramesAveraged;
 }
 
 
-std::vector<PrintableReportLine> Profiler_GenerateNestedReportFromTree(ReportNode* tree)
+
+const std::vector<PrintableReportLine>& Profiler_GetRollingFlatReport(ProfilerRollingReport* report)
 {
-	std::vector<PrintableReportLine> report;
+	RollingReport_FormatLines(report->m_flatLines, report->m_flatLinesOrderVersion, report->m_flatLinesFrame, report->m_flatScopes, report->m_flatOrder, report->m_flatOrderVersion, report->m_numFramesAveraged, false);
+	return report->m_flatLines;
+}
 
-	// Generate Report
-	NestedReport_AddNodeToReport_Recursive(report, tree, tree);
-	
-	return report;
+
+
+const std::vector<PrintableReportLine>& Profiler_GetRollingNestedReport(ProfilerRollingReport* report)
+{
+	RollingReport_FormatLines(report->m_nestedLines, report->m_nestedLinesOrderVersion, report->m_nestedLinesFrame, report->m_nestedScopes, report->m_nestedOrder, report->m_nestedOrderVersion, report->m_numFramesAveraged, true);
+	return report->m_nestedLines;
 }
 
 
@@ -661,7 +3517,7 @@ ProfilerNode* Profiler_GetPreviousTree(unsigned int xTreesAgo)
 
 	if (s_oldTrees.size() > xTreesAgo)
 	{
-		node = s_oldTrees[s_oldTrees.size() - 1 - xTreesAgo];
+		node = GetMaterializedFrame(xTreesAgo)->m_timelines[0]->m_root;
 	}
 
 	return node;
@@ -669,13 +3525,32 @@ ProfilerNode* Profiler_GetPreviousTree(unsigned int xTreesAgo)
 
 
 
+std::vector<ProfilerNode*> Profiler_GetPreviousThreadTrees(unsigned int xTreesAgo)
+{
+	std::vector<ProfilerNode*> threadTrees;
+
+	if (s_oldTrees.size() > xTreesAgo)
+	{
+		ProfilerFrame* frame = GetMaterializedFrame(xTreesAgo);
+		for (int i = 0; i < (int)frame->m_timelines.size(); ++i)
+		{
+			threadTrees.push_back(frame->m_timelines[i]->m_root);
+		}
+	}
+
+	return threadTrees;
+}
+
+
+
 std::vector<ProfilerNode*> Profiler_GetAllPreviousTrees()
 {
 	std::vector<ProfilerNode*> oldTrees;
 
 	for (int i = 0; i < (int)s_oldTrees.size(); ++i)
 	{
-		oldTrees.push_back(s_oldTrees[i]);
+		unsigned int xTreesAgo = (unsigned int)(s_oldTrees.size() - 1 - i);
+		oldTrees.push_back(GetMaterializedFrame(xTreesAgo)->m_timelines[0]->m_root);
 	}
 
 	return oldTrees;
@@ -683,6 +3558,155 @@ std::vector<ProfilerNode*> Profiler_GetAllPreviousTrees()
 
 
 
+// Benchmarking -----------------------------------------------------------------------------------
+double Profiler_MeasurePushPopCost(int numPairs)
+{
+	GUARANTEE_OR_DIE(numPairs > 0, "Profiler benchmark needs at least one Push/Pop pair");
+
+	// Everything recorded here lands in the current frame, so it shows up in that frame's reports as well
+	Profiler_Push("Profiler_Benchmark");
+
+	uint64_t startHPC = GetCurrentTimeInHPC();
+	for (int i = 0; i < numPairs; ++i)
+	{
+		Profiler_Push("Profiler_Benchmark_Pair");
+		Profiler_Pop();
+	}
+	uint64_t endHPC = GetCurrentTimeInHPC();
+
+	Profiler_Pop();
+
+	double nsPerPair = (ConvertHPCtoSeconds(endHPC - startHPC) * 1000000000.0) / (double)numPairs;
+	return nsPerPair;
+}
+
+
+
+double Profiler_MeasureScopeCost(int numScopes)
+{
+	GUARANTEE_OR_DIE(numScopes > 0, "Profiler benchmark needs at least one scope");
+
+	PROFILE_SCOPE("Profiler_Benchmark");
+
+	uint64_t startHPC = GetCurrentTimeInHPC();
+	for (int i = 0; i < numScopes; ++i)
+	{
+		PROFILE_SCOPE("Profiler_Benchmark_Scope");
+	}
+	uint64_t endHPC = GetCurrentTimeInHPC();
+
+	double nsPerScope = (ConvertHPCtoSeconds(endHPC - startHPC) * 1000000000.0) / (double)numScopes;
+	return nsPerScope;
+}
+
+
+
+void Benchmark_AssignTimes_Recursive(ProfilerNode* node, uint64_t& currentHPC)
+{
+	node->m_startHPC = currentHPC++;
+	for (ProfilerNode* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
+	{
+		Benchmark_AssignTimes_Recursive(child, currentHPC);
+	}
+	node->m_endHPC = currentHPC++;
+}
+
+
+
+// A random tree over a small set of names, so plenty of siblings merge like repeated calls do in a real frame
+ProfilerNode* Benchmark_BuildTree(ProfilerArena& arena, int numNodes)
+{
+	const int NUM_NAMES = 64;
+	uint32_t nameIDs[NUM_NAMES];
+	const char* names[NUM_NAMES];
+	for (int i = 0; i < NUM_NAMES; ++i)
+	{
+		names[i] = InternName(Stringf("ProfilerReportBenchmark::Scope%02d", i).c_str(), nameIDs[i]);
+	}
+
+	std::vector<ProfilerNode*> nodes;
+	nodes.reserve(numNodes);
+	nodes.push_back(arena.Create<ProfilerNode>("ProfilerReportBenchmark"));
+
+	uint32_t seed = 12345;
+	for (int i = 1; i < numNodes; ++i)
+	{
+		seed = (seed * 1664525u) + 1013904223u;
+		ProfilerNode* parent = nodes[(seed >> 8) % nodes.size()];
+
+		seed = (seed * 1664525u) + 1013904223u;
+		int nameIndex = (seed >> 8) % NUM_NAMES;
+
+		ProfilerNode* node = arena.Create<ProfilerNode>(names[nameIndex], nameIDs[nameIndex]);
+		parent->AddChild(node);
+		nodes.push_back(node);
+	}
+
+	// Nest the times so self times come out sane
+	uint64_t currentHPC = 0;
+	Benchmark_AssignTimes_Recursive(nodes[0], currentHPC);
+
+	return nodes[0];
+}
+
+
+
+void Profiler_MeasureReportCost(int numNodes, double& outTreeMS, double& outFlatMS, double& outNestedMS)
+{
+	GUARANTEE_OR_DIE(numNodes > 0, "Profiler report benchmark needs at least one node");
+
+	ProfilerArena arena;
+	ProfilerNode* tree = Benchmark_BuildTree(arena, numNodes);
+
+
+	uint64_t startHPC = GetCurrentTimeInHPC();
+	ReportNode* report = Profiler_GenerateReportTree(tree);
+	uint64_t treeHPC = GetCurrentTimeInHPC();
+	std::vector<PrintableReportLine> flatReport = Profiler_GenerateFlatReportFromTree(report, FLAT_REPORT_SORT_MODE_SELF_TIME);
+	uint64_t flatHPC = GetCurrentTimeInHPC();
+	std::vector<PrintableReportLine> nestedReport = Profiler_GenerateNestedReportFromTree(report);
+	uint64_t nestedHPC = GetCurrentTimeInHPC();
+
+	delete report;
+
+	outTreeMS	= ConvertHPCtoSeconds(treeHPC - startHPC) * 1000.0;
+	outFlatMS	= ConvertHPCtoSeconds(flatHPC - treeHPC) * 1000.0;
+	outNestedMS	= ConvertHPCtoSeconds(nestedHPC - flatHPC) * 1000.0;
+}
+
+
+
+void Profiler_MeasureRollingReportCost(int numNodes, double& outUpdateMS, double& outFlatMS, double& outNestedMS)
+{
+	GUARANTEE_OR_DIE(numNodes > 0, "Profiler report benchmark needs at least one node");
+
+	ProfilerArena arena;
+	ProfilerNode* tree = Benchmark_BuildTree(arena, numNodes);
+
+	// Not registered, so the real frames don't feed it while we measure
+	//	The first frame adds every scope, what we're after is the steady state after it
+	ProfilerRollingReport report;
+	RollingReport_Reset(&report);
+	RollingReport_Update(&report, tree);
+	Profiler_GetRollingFlatReport(&report);
+	Profiler_GetRollingNestedReport(&report);
+
+
+	uint64_t startHPC = GetCurrentTimeInHPC();
+	RollingReport_Update(&report, tree);
+	uint64_t updateHPC = GetCurrentTimeInHPC();
+	Profiler_GetRollingFlatReport(&report);
+	uint64_t flatHPC = GetCurrentTimeInHPC();
+	Profiler_GetRollingNestedReport(&report);
+	uint64_t nestedHPC = GetCurrentTimeInHPC();
+
+	outUpdateMS	= ConvertHPCtoSeconds(updateHPC - startHPC) * 1000.0;
+	outFlatMS	= ConvertHPCtoSeconds(flatHPC - updateHPC) * 1000.0;
+	outNestedMS	= ConvertHPCtoSeconds(nestedHPC - flatHPC) * 1000.0;
+}
+
+
+
 bool Profiler_IsCompiledIn()
 {
 	return true;
@@ -701,6 +3725,7 @@ void Profiler_BeginFrame() {}
 void Profiler_EndFrame() {}
 
 void Profiler_Push(char const* name) {UNUSED(name);}
+void Profiler_PushScope(const ProfilerScopeDescriptor& scope) {UNUSED(scope);}
 void Profiler_Pop() {}
 
 bool Profiler_IsPaused() {return false;}
@@ -709,14 +3734,67 @@ void Profiler_Unpause() {}
 
 unsigned int Profiler_GetFrameNumber() {return 0;}
 
+void					Profiler_SetFrameSpikeThreshold(double seconds) {UNUSED(seconds);}
+double					Profiler_GetFrameSpikeThreshold() {return 0.0;}
+bool					Profiler_SetScopeSpikeThreshold(const char* name, double seconds) {UNUSED(name); UNUSED(seconds); return false;}
+void					Profiler_SetSpikeCaptureNeighbours(int numNeighbours) {UNUSED(numNeighbours);}
+int						Profiler_GetNumSpikeCaptures() {return 0;}
+ProfilerSpikeCapture	Profiler_GetSpikeCapture(int captureIndex) {UNUSED(captureIndex); return ProfilerSpikeCapture();}
+void					Profiler_ClearSpikeCaptures() {}
+
+void Profiler_SetThreadName(const char* name) {UNUSED(name);}
+
+void Profiler_SetMemoryTracking(bool isTracking) {UNUSED(isTracking);}
+bool Profiler_IsMemoryTracking() {return false;}
+
+bool						Profiler_StartSampling(int samplesPerSecond) {UNUSED(samplesPerSecond); return false;}
+void						Profiler_StopSampling() {}
+bool						Profiler_IsSampling() {return false;}
+unsigned int				Profiler_GetNumDroppedSamples() {return 0;}
+std::vector<ProfilerSample>	Profiler_GetPreviousSamples(unsigned int xTreesAgo, int threadIndex) {UNUSED(xTreesAgo); UNUSED(threadIndex); return std::vector<ProfilerSample>();}
+ProfilerNode*				Profiler_FindSampleScope(ProfilerNode* tree, const ProfilerSample& sample) {UNUSED(sample); return tree;}
+
+void				Profiler_SetRecordMode(eProfilerRecordMode mode) {UNUSED(mode);}
+eProfilerRecordMode	Profiler_GetRecordMode() {return PROFILER_RECORD_MODE_TREE;}
+void				Profiler_SetEventBufferCapacity(unsigned int numEvents) {UNUSED(numEvents);}
+unsigned int		Profiler_GetPreviousNumLostEvents(unsigned int xTreesAgo, int threadIndex) {UNUSED(xTreesAgo); UNUSED(threadIndex); return 0;}
+
+const char* Profiler_InternName(const char* name) {return name;}
+
+ProfilerScopeDescriptor::ProfilerScopeDescriptor(const char* name, const char* file, int line, uint32_t nameHash)
+	: m_name(name)
+	, m_nameID(PROFILER_INVALID_NAME_ID)
+	, m_nameHash(nameHash)
+	, m_file(file)
+	, m_line(line)
+{
+}
+
 ReportNode*						 Profiler_GenerateReportTree(ProfilerNode* tree) {UNUSED(tree); return nullptr;}
+ReportNode*						 Profiler_GenerateHybridReportTree(unsigned int xTreesAgo) {UNUSED(xTreesAgo); return nullptr;}
+void							 Profiler_MergeIntoReportTree(ReportNode* report, ProfilerNode* tree) {UNUSED(report); UNUSED(tree);}
 std::vector<PrintableReportLine> Profiler_GenerateFlatReportFromTree(ReportNode* tree, eFlatReportSortMode sortMode) {UNUSED(tree); UNUSED(sortMode); return std::vector<PrintableReportLine>();}
 std::vector<PrintableReportLine> Profiler_GenerateNestedReportFromTree(ReportNode* tree) {UNUSED(tree); return std::vector<PrintableReportLine>();}
 
+const std::vector<PrintableReportLine> NO_ROLLING_LINES;
+ProfilerRollingReport*					Profiler_CreateRollingReport(eFlatReportSortMode sortMode, float smoothing) {UNUSED(sortMode); UNUSED(smoothing); return nullptr;}
+void									Profiler_DestroyRollingReport(ProfilerRollingReport* report) {UNUSED(report);}
+void									Profiler_SetRollingReportSortMode(ProfilerRollingReport* report, eFlatReportSortMode sortMode) {UNUSED(report); UNUSED(sortMode);}
+void									Profiler_ClearRollingReport(ProfilerRollingReport* report) {UNUSED(report);}
+const std::vector<PrintableReportLine>&	Profiler_GetRollingFlatReport(ProfilerRollingReport* report) {UNUSED(report); return NO_ROLLING_LINES;}
+const std::vector<PrintableReportLine>&	Profiler_GetRollingNestedReport(ProfilerRollingReport* report) {UNUSED(report); return NO_ROLLING_LINES;}
+unsigned int							Profiler_GetRollingReportOrderVersion(ProfilerRollingReport* report) {UNUSED(report); return 0;}
+
 int							Profiler_GetMaxNumPreviousTrees() {return 0;}
 int							Profiler_GetNumPreviousTrees() {return 0;}
 ProfilerNode*				Profiler_GetPreviousTree(unsigned int xFramesAgo) {UNUSED(xFramesAgo); return nullptr;}
+std::vector<ProfilerNode*>	Profiler_GetPreviousThreadTrees(unsigned int xFramesAgo) {UNUSED(xFramesAgo); return std::vector<ProfilerNode*>();}
 std::vector<ProfilerNode*>	Profiler_GetAllPreviousTrees() {return std::vector<ProfilerNode*>();}
 
+double						Profiler_MeasurePushPopCost(int numPairs) {UNUSED(numPairs); return 0.0;}
+double						Profiler_MeasureScopeCost(int numScopes) {UNUSED(numScopes); return 0.0;}
+void						Profiler_MeasureReportCost(int numNodes, double& outTreeMS, double& outFlatMS, double& outNestedMS) {UNUSED(numNodes); outTreeMS = 0.0; outFlatMS = 0.0; outNestedMS = 0.0;}
+void						Profiler_MeasureRollingReportCost(int numNodes, double& outUpdateMS, double& outFlatMS, double& outNestedMS) {UNUSED(numNodes); outUpdateMS = 0.0; outFlatMS = 0.0; outNestedMS = 0.0;}
+
 bool						Profiler_IsCompiledIn() {return false;};
 #endif
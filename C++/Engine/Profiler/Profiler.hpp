@@ -3,26 +3,131 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <cstdint>
 
+class ProfilerArena;
+class ProfilerRollingReport;
 
 
+
+// Comment out to compile the profiler out, PROFILE_SCOPE then expands to nothing and the functions below become stubs
+#define PROFILER_ENABLED
+
+// Uncomment to replace the global operator new/delete and fill in the allocation columns, they read zero otherwise
+//#define PROFILER_MEMORY_TRACKING
+
+
+
+// Allocator traffic while a scope was open, see Profiler_SetMemoryTracking
+class ProfilerMemoryCounts
+{
+public:
+	uint64_t	m_numAllocations = 0;
+	uint64_t	m_bytesAllocated = 0;
+	uint64_t	m_bytesFreed = 0;
+
+	ProfilerMemoryCounts& operator+=(const ProfilerMemoryCounts& other)
+	{
+		m_numAllocations += other.m_numAllocations;
+		m_bytesAllocated += other.m_bytesAllocated;
+		m_bytesFreed += other.m_bytesFreed;
+		return *this;
+	}
+
+	// Clamps at zero, tracking can be switched on while a scope is open
+	ProfilerMemoryCounts operator-(const ProfilerMemoryCounts& other) const
+	{
+		ProfilerMemoryCounts difference;
+		difference.m_numAllocations = (m_numAllocations > other.m_numAllocations) ? (m_numAllocations - other.m_numAllocations) : 0;
+		difference.m_bytesAllocated = (m_bytesAllocated > other.m_bytesAllocated) ? (m_bytesAllocated - other.m_bytesAllocated) : 0;
+		difference.m_bytesFreed = (m_bytesFreed > other.m_bytesFreed) ? (m_bytesFreed - other.m_bytesFreed) : 0;
+		return difference;
+	}
+};
+
+
+
+// Hardware counter deltas while a scope was open, see Profiler_SetHardwareCounters
+class ProfilerHardwareCounts
+{
+public:
+	uint64_t	m_cycles = 0;
+	uint64_t	m_instructions = 0;
+	uint64_t	m_l1DataMisses = 0;
+	uint64_t	m_llcMisses = 0;
+	uint64_t	m_branchMisses = 0;
+
+	ProfilerHardwareCounts& operator+=(const ProfilerHardwareCounts& other)
+	{
+		m_cycles += other.m_cycles;
+		m_instructions += other.m_instructions;
+		m_l1DataMisses += other.m_l1DataMisses;
+		m_llcMisses += other.m_llcMisses;
+		m_branchMisses += other.m_branchMisses;
+		return *this;
+	}
+
+	// Clamps at zero, a counter group the kernel couldn't schedule reads as zero for a while
+	ProfilerHardwareCounts operator-(const ProfilerHardwareCounts& other) const
+	{
+		ProfilerHardwareCounts difference;
+		difference.m_cycles = (m_cycles > other.m_cycles) ? (m_cycles - other.m_cycles) : 0;
+		difference.m_instructions = (m_instructions > other.m_instructions) ? (m_instructions - other.m_instructions) : 0;
+		difference.m_l1DataMisses = (m_l1DataMisses > other.m_l1DataMisses) ? (m_l1DataMisses - other.m_l1DataMisses) : 0;
+		difference.m_llcMisses = (m_llcMisses > other.m_llcMisses) ? (m_llcMisses - other.m_llcMisses) : 0;
+		difference.m_branchMisses = (m_branchMisses > other.m_branchMisses) ? (m_branchMisses - other.m_branchMisses) : 0;
+		return difference;
+	}
+};
+
+
+
+constexpr uint32_t PROFILER_INVALID_NAME_ID = 0xFFFFFFFF;
+
+
+
+// One call stack the sampler caught, see Profiler_StartSampling
+//	Frames are return addresses innermost first, they live with the frame's tree and are recycled with it
+constexpr int PROFILER_MAX_SAMPLE_DEPTH = 32;
+struct ProfilerSample
+{
+	uint64_t		m_ticks = 0;		// Profiler clock, when the signal landed
+	int				m_numFrames = 0;
+	void* const*	m_frames = nullptr;
+};
+
+
+
+// Nodes are bump allocated out of their frame's arena and are recycled with it, never delete one
 class ProfilerNode
 {
 public:
-	ProfilerNode(const char* name);
+	ProfilerNode(const char* name, uint32_t nameID = PROFILER_INVALID_NAME_ID);
 	~ProfilerNode();
 
-	std::string					m_name;
+	const char*					m_name;			// Interned, see Profiler_InternName
+	uint32_t					m_nameID;		// Index into the intern table, roots don't have one
 	
-	uint64_t					m_startHPC;
+	uint64_t					m_startHPC;		// Profiler clock ticks, see Profiler_ConvertTicksToSeconds
 	uint64_t					m_endHPC;
 
+	ProfilerMemoryCounts		m_memory;		// Children included, holds the thread's running totals until the scope pops
+	ProfilerHardwareCounts		m_counters;		// Same as m_memory
+
 	ProfilerNode*				m_parent;
-	std::vector<ProfilerNode*>	m_children;
+	ProfilerNode*				m_firstChild;
+	ProfilerNode*				m_lastChild;
+	ProfilerNode*				m_nextSibling;
+	int							m_childCount;
+
+	void	 AddChild(ProfilerNode* child);
 
-	uint64_t GetSelfTimeHPC() const;
+	uint64_t GetSelfTimeHPC() const;	// Minus the clock's own overhead, see Profiler_SetClockOverheadCompensation
 	uint64_t GetElapsedTimeHPC() const {return m_endHPC - m_startHPC;};
 
+	ProfilerMemoryCounts GetSelfMemory() const;
+	ProfilerHardwareCounts GetSelfCounters() const;
+
 
 
 private:
@@ -30,6 +135,7 @@ private:
 
 
 
+// Report nodes are pooled in an arena owned by the root, only ever delete the root Profiler_GenerateReportTree returned
 class ReportNode
 {
 public:
@@ -37,17 +143,43 @@ public:
 	ReportNode(const ProfilerNode* profilerNode);
 	~ReportNode();
 
-	std::string m_name;
+	void		AddChild(ReportNode* child);
+
+	const char*	m_name = nullptr;
+	uint32_t	m_nameID = PROFILER_INVALID_NAME_ID;
 	int			m_callCount = 0;
 
-	uint64_t	m_elapsedTimeHPC;
-	uint64_t	m_selfTimeHPC;
+	uint64_t	m_elapsedTimeHPC = 0;
+	uint64_t	m_selfTimeHPC = 0;
+
+	ProfilerMemoryCounts m_memory;
+	ProfilerMemoryCounts m_selfMemory;
+
+	ProfilerHardwareCounts m_counters;
+	ProfilerHardwareCounts m_selfCounters;
+
+	// Hybrid reports only, see Profiler_GenerateHybridReportTree
+	bool		m_isSampled = false;	// A function the sampler caught, m_callCount is its number of samples
+	int			m_numSamples = 0;		// Samples that landed in this scope's self time
+
 
 
+	ReportNode*	m_parent = nullptr;
+	ReportNode*	m_firstChild = nullptr;
+	ReportNode*	m_lastChild = nullptr;
+	ReportNode*	m_nextSibling = nullptr;
+	int			m_childCount = 0;
 
-	ReportNode*							m_parent = nullptr;
-	std::map<std::string, ReportNode*>	m_children;
 private:
+	friend ReportNode* Profiler_GenerateReportTree(ProfilerNode* tree);
+	friend void Profiler_MergeIntoReportTree(ReportNode* report, ProfilerNode* tree);
+	friend ReportNode* Profiler_GenerateHybridReportTree(unsigned int xTreesAgo);
+
+	ProfilerArena*	m_pool = nullptr;	// Only the root has one
+
+	// No copying, a copied root would free the pool twice
+	ReportNode(const ReportNode&) = delete;
+	ReportNode& operator=(const ReportNode&) = delete;
 };
 
 
@@ -76,17 +208,106 @@ public:
 	float		m_selfTime_floatPart;
 	std::string m_selfTime_units;
 
+	uint64_t	m_numAllocations = 0;
+	uint64_t	m_bytesAllocated = 0;
+	uint64_t	m_bytesFreed = 0;
+
+	uint64_t	m_selfNumAllocations = 0;
+	uint64_t	m_selfBytesAllocated = 0;
+	uint64_t	m_selfBytesFreed = 0;
+
+	ProfilerHardwareCounts m_counters;
+	ProfilerHardwareCounts m_selfCounters;
+
+	bool		m_isSampled = false;
+
 private:
 };
 
 
 
+// A spike the profiler caught on its own along with the frames around it, see Profiler_SetFrameSpikeThreshold
+//	Captured frames are held apart from the frame ring, so they outlive it by as long as you like
+class ProfilerSpikeCapture
+{
+public:
+	unsigned int							m_spikeFrameNumber = 0;
+	const char*								m_scopeName = nullptr;		// The scope that went over, nullptr when it was the whole frame
+	double									m_spikeSeconds = 0.0;
+	double									m_thresholdSeconds = 0.0;
+
+	std::vector<ProfilerNode*>				m_frameTrees;				// Main thread trees oldest first, frames after the spike show up as they close
+	std::vector<std::vector<ProfilerNode*>>	m_threadTrees;				// Every thread's tree for each of those frames, main thread first
+	int										m_spikeIndex = 0;			// Which of the frames is the spike
+};
+
+
+
+// One per PROFILE_SCOPE call site, built the first time the scope runs
+//	Everything the hot path needs is resolved here so recording never touches the string again
+class ProfilerScopeDescriptor
+{
+public:
+	ProfilerScopeDescriptor(const char* name, const char* file, int line, uint32_t nameHash);
+
+	const char*	m_name;			// Interned
+	uint32_t	m_nameID;
+	uint32_t	m_nameHash;		// Profiler_HashName, stable across runs unlike the ID
+	const char*	m_file;
+	int			m_line;
+};
+
+
+
+// FNV-1a, folds to a constant for string literals
+constexpr uint32_t Profiler_HashName(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	for (; *name != '\0'; ++name)
+	{
+		hash = (hash ^ (uint32_t)(unsigned char)*name) * 16777619u;
+	}
+
+	return hash;
+}
+
+
+
+enum eProfilerRecordMode
+{
+	PROFILER_RECORD_MODE_INVALID = -1,
+
+	PROFILER_RECORD_MODE_TREE = 0,		// Builds ProfilerNode trees as scopes push/pop
+	PROFILER_RECORD_MODE_EVENTS,		// Appends fixed size records to a per thread ring, trees are built when asked for
+
+	PROFILER_RECORD_MODE_COUNT
+};
+
+
+
+enum eProfilerClock
+{
+	PROFILER_CLOCK_INVALID = -1,
+
+	PROFILER_CLOCK_HPC = 0,				// GetCurrentTimeInHPC, always available and the default
+	PROFILER_CLOCK_MONOTONIC_RAW,		// clock_gettime(CLOCK_MONOTONIC_RAW), Linux only
+	PROFILER_CLOCK_TSC,					// rdtsc calibrated against CLOCK_MONOTONIC_RAW (the HPC off Linux), needs an invariant TSC
+	PROFILER_CLOCK_TSCP,				// rdtscp, waits for earlier instructions so it is a little slower but never reads early
+
+	PROFILER_CLOCK_COUNT
+};
+
+
+
 enum eFlatReportSortMode
 {
 	FLAT_REPORT_SORT_MODE_INVALID = -1,
 
 	FLAT_REPORT_SORT_MODE_SELF_TIME = 0,
 	FLAT_REPORT_SORT_MODE_TOTAL_TIME,
+	FLAT_REPORT_SORT_MODE_SELF_ALLOCATIONS,
+	FLAT_REPORT_SORT_MODE_SELF_BYTES_ALLOCATED,
+	FLAT_REPORT_SORT_MODE_TOTAL_BYTES_ALLOCATED,
 
 	FLAT_REPORT_SORT_MODE_COUNT
 };
@@ -102,9 +323,59 @@ void Profiler_BeginFrame();
 void Profiler_EndFrame();
 
 // Current Frame Stack Manipulation
+// NOTE: Safe to call from any thread, each thread records its own tree per frame
+//	Prefer PROFILE_SCOPE, Profiler_Push has to look its name up every call
 void Profiler_Push(char const* name); 
+void Profiler_PushScope(const ProfilerScopeDescriptor& scope);
 void Profiler_Pop(); 
 
+// Threads
+void Profiler_SetThreadName(const char* name); // Names the calling thread's trees, defaults to "Thread N"
+
+// Recording Mode
+// NOTE: Each thread switches the next time it has no scopes open
+void				Profiler_SetRecordMode(eProfilerRecordMode mode);
+eProfilerRecordMode	Profiler_GetRecordMode();
+void				Profiler_SetEventBufferCapacity(unsigned int numEvents); // Power of two, applies to threads that haven't recorded an event yet
+unsigned int		Profiler_GetPreviousNumLostEvents(unsigned int xTreesAgo = 0, int threadIndex = 0); // Events the ring overwrote before the frame's tree was built, that tree is missing them
+
+// Clock
+// NOTE: Choose before Profiler_Initialize, the default is the HPC
+//		 Any other clock puts its own ticks in every m_*HPC the profiler hands out, convert those with Profiler_ConvertTicksToSeconds
+bool			Profiler_SetClock(eProfilerClock clock); // False if this machine doesn't have it
+eProfilerClock	Profiler_GetClock();
+const char*		Profiler_GetClockName(eProfilerClock clock);
+double			Profiler_GetClockTicksPerSecond();
+double			Profiler_GetClockOverheadNanoseconds(); // What one sample costs, measured by Profiler_Initialize
+void			Profiler_SetClockOverheadCompensation(bool isCompensated); // Subtract sample costs from self times, on by default
+bool			Profiler_IsClockOverheadCompensated();
+double			Profiler_ConvertTicksToSeconds(uint64_t ticks);
+
+// Memory
+// NOTE: Needs PROFILER_MEMORY_TRACKING, the counts come from the replaced global operator new/delete
+//	Only tree mode records them, events mode keeps its records small and reports zeros
+void Profiler_SetMemoryTracking(bool isTracking);
+bool Profiler_IsMemoryTracking();
+
+// Hardware Counters
+// NOTE: Linux only through perf_event_open, choose before Profiler_Initialize
+//	Every push/pop reads its thread's counter group with a syscall, so scopes cost about a microsecond more while counting
+//	Where the kernel won't hand the counters out (perf_event_paranoid, containers, other platforms) the profiler records time only
+bool Profiler_SetHardwareCounters(bool isCounting); // False if they can't be opened on this machine
+bool Profiler_IsCountingHardware();
+
+// Sampling
+// NOTE: Linux only, a SIGPROF timer catches call stacks at a fixed rate of CPU time so code no scope covers still shows up
+//	Each sample is kept with the thread's tree for the frame it landed in, its timestamp ties it to the scope that was open
+//	Stacks are walked through frame pointers inside the signal handler, build with -fno-omit-frame-pointer or samples stop at the first function without one
+bool						Profiler_StartSampling(int samplesPerSecond = 1000); // False where there is no sampler
+void						Profiler_StopSampling();
+bool						Profiler_IsSampling();
+unsigned int				Profiler_GetNumDroppedSamples(); // Lost to a full per thread ring
+std::vector<ProfilerSample>	Profiler_GetPreviousSamples(unsigned int xTreesAgo = 0, int threadIndex = 0); // Same thread order as Profiler_GetPreviousThreadTrees
+ProfilerNode*				Profiler_FindSampleScope(ProfilerNode* tree, const ProfilerSample& sample); // The deepest scope open when the sample landed
+const char*					Profiler_GetSampleFrameName(void* address); // Symbolized once per address, the string lives until exit
+
 // Pausing
 bool Profiler_IsPaused();
 void Profiler_Pause();
@@ -113,16 +384,79 @@ void Profiler_Unpause();
 // Frame Number
 unsigned int Profiler_GetFrameNumber();
 
+// Spike Capture
+// NOTE: Thresholds are in seconds and 0 turns one off, set them after Profiler_Initialize
+//	When the store is full the mildest capture (relative to its threshold) makes room
+void					Profiler_SetFrameSpikeThreshold(double seconds);
+double					Profiler_GetFrameSpikeThreshold();
+bool					Profiler_SetScopeSpikeThreshold(const char* name, double seconds); // Any single call over it counts, false if the name can't be tracked
+void					Profiler_SetSpikeCaptureNeighbours(int numNeighbours); // Frames kept on each side of a spike
+int						Profiler_GetNumSpikeCaptures();
+ProfilerSpikeCapture	Profiler_GetSpikeCapture(int captureIndex); // Oldest first
+void					Profiler_ClearSpikeCaptures();
+
+// Names
+const char* Profiler_InternName(const char* name);
+
 // Reports
 ReportNode*						 Profiler_GenerateReportTree(ProfilerNode* tree);
+void							 Profiler_MergeIntoReportTree(ReportNode* report, ProfilerNode* tree); // Adds another frame to a root Profiler_GenerateReportTree returned
+ReportNode*						 Profiler_GenerateHybridReportTree(unsigned int xTreesAgo = 0); // The main thread's report with sampled functions under each scope, splitting its self time between them
 std::vector<PrintableReportLine> Profiler_GenerateFlatReportFromTree(ReportNode* tree, eFlatReportSortMode sortMode);
 std::vector<PrintableReportLine> Profiler_GenerateNestedReportFromTree(ReportNode* tree);
 
+// Rolling Reports
+// NOTE: Main thread only, Profiler_BeginFrame updates every live one from the main thread's tree as each frame closes
+//	Lines hold per frame exponential moving averages, smoothing is the weight of the newest frame
+//	The returned lines belong to the report and are only reformatted once per frame, the flat ones are only re-ranked when the order changes
+ProfilerRollingReport*					Profiler_CreateRollingReport(eFlatReportSortMode sortMode = FLAT_REPORT_SORT_MODE_SELF_TIME, float smoothing = 0.1f);
+void									Profiler_DestroyRollingReport(ProfilerRollingReport* report);
+void									Profiler_SetRollingReportSortMode(ProfilerRollingReport* report, eFlatReportSortMode sortMode);
+void									Profiler_ClearRollingReport(ProfilerRollingReport* report);
+const std::vector<PrintableReportLine>&	Profiler_GetRollingFlatReport(ProfilerRollingReport* report);
+const std::vector<PrintableReportLine>&	Profiler_GetRollingNestedReport(ProfilerRollingReport* report);
+unsigned int							Profiler_GetRollingReportOrderVersion(ProfilerRollingReport* report); // Changes when a flat line is added or moves
+
 // Access Old Reports
 int							Profiler_GetMaxNumPreviousTrees();
 int							Profiler_GetNumPreviousTrees();
 ProfilerNode*				Profiler_GetPreviousTree(unsigned int xTreesAgo = 0); 
+std::vector<ProfilerNode*>	Profiler_GetPreviousThreadTrees(unsigned int xTreesAgo = 0); // One root per thread, the main thread is first
 std::vector<ProfilerNode*>	Profiler_GetAllPreviousTrees();
 
+// Benchmarking
+double						Profiler_MeasurePushPopCost(int numPairs); // Nanoseconds per Push/Pop pair
+double						Profiler_MeasureScopeCost(int numScopes); // Nanoseconds per PROFILE_SCOPE
+void						Profiler_MeasureReportCost(int numNodes, double& outTreeMS, double& outFlatMS, double& outNestedMS); // Builds reports for a synthetic tree
+void						Profiler_MeasureRollingReportCost(int numNodes, double& outUpdateMS, double& outFlatMS, double& outNestedMS); // One frame of a rolling report over the same tree
+
 // Compiled In
-bool						Profiler_IsCompiledIn();
\ No newline at end of file
+bool						Profiler_IsCompiledIn();
+
+
+
+// Scopes
+//	PROFILE_SCOPE("Name"); profiles from that line until the end of the enclosing block
+class ProfilerScope
+{
+public:
+	ProfilerScope(const ProfilerScopeDescriptor& scope) { Profiler_PushScope(scope); }
+	~ProfilerScope() { Profiler_Pop(); }
+
+private:
+	ProfilerScope(const ProfilerScope&) = delete;
+	ProfilerScope& operator=(const ProfilerScope&) = delete;
+};
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+#ifdef PROFILER_ENABLED
+	#define PROFILE_SCOPE(name)																												\
+		static const ProfilerScopeDescriptor PROFILER_CONCAT(s_profilerScopeDescriptor_, __LINE__)(name, __FILE__, __LINE__, Profiler_HashName(name));	\
+		ProfilerScope PROFILER_CONCAT(profilerScope_, __LINE__)(PROFILER_CONCAT(s_profilerScopeDescriptor_, __LINE__))
+#else
+	#define PROFILE_SCOPE(name)
+#endif
+
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
\ No newline at end of file
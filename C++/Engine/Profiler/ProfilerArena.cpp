@@ -0,0 +1,157 @@
+#include "Engine/Profiler/ProfilerArena.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Composition ----------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+ProfilerArena::ProfilerArena(size_t blockSize)
+	: m_blockSize(blockSize)
+{
+}
+
+
+
+ProfilerArena::~ProfilerArena()
+{
+	Block* block = m_firstBlock;
+	while (block != nullptr)
+	{
+		Block* next = block->m_next;
+		free(block);
+		block = next;
+	}
+
+	m_firstBlock = nullptr;
+	m_currentBlock = nullptr;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Allocation -----------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+void* ProfilerArena::Allocate(size_t size, size_t alignment)
+{
+	// Walk forward through the blocks we already own before asking the heap for more
+	//	After a Reset the current block is the first block and the rest of the chain is free to reuse
+	while (m_currentBlock != nullptr)
+	{
+		uintptr_t base		= (uintptr_t)m_currentBlock->GetData();
+		uintptr_t aligned	= (base + m_currentBlock->m_used + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+		size_t newUsed		= (size_t)(aligned - base) + size;
+
+		if (newUsed <= m_currentBlock->m_size)
+		{
+			m_currentBlock->m_used = newUsed;
+			return (void*)aligned;
+		}
+
+		if (m_currentBlock->m_next == nullptr)
+		{
+			break;
+		}
+		m_currentBlock = m_currentBlock->m_next;
+		m_currentBlock->m_used = 0;
+	}
+
+
+	// Out of space, chain on a new block
+	Block* block = AllocateBlock(size + alignment);
+	if (m_currentBlock == nullptr)
+	{
+		m_firstBlock = block;
+	}
+	else
+	{
+		// Splice it in after the current block so any blocks further down the chain are still reused
+		block->m_next = m_currentBlock->m_next;
+		m_currentBlock->m_next = block;
+	}
+	m_currentBlock = block;
+
+	uintptr_t base		= (uintptr_t)block->GetData();
+	uintptr_t aligned	= (base + (alignment - 1)) & ~(uintptr_t)(alignment - 1);
+	block->m_used		= (size_t)(aligned - base) + size;
+
+	return (void*)aligned;
+}
+
+
+
+const char* ProfilerArena::CopyString(const char* str)
+{
+	size_t length = strlen(str) + 1;
+
+	char* copy = (char*)Allocate(length, 1);
+	memcpy(copy, str, length);
+
+	return copy;
+}
+
+
+
+void ProfilerArena::Reset()
+{
+	m_currentBlock = m_firstBlock;
+	if (m_currentBlock != nullptr)
+	{
+		m_currentBlock->m_used = 0;
+	}
+}
+
+
+
+ProfilerArena::Block* ProfilerArena::AllocateBlock(size_t minSize)
+{
+	size_t size = (minSize > m_blockSize) ? minSize : m_blockSize;
+
+	Block* block = (Block*)malloc(sizeof(Block) + size);
+	GUARANTEE_OR_DIE(block != nullptr, "Profiler arena failed to allocate a block");
+
+	block->m_next = nullptr;
+	block->m_size = size;
+	block->m_used = 0;
+
+	return block;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Stats ----------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+size_t ProfilerArena::GetNumBytesUsed() const
+{
+	size_t used = 0;
+
+	for (Block* block = m_firstBlock; block != nullptr; block = block->m_next)
+	{
+		used += block->m_used;
+		if (block == m_currentBlock)
+		{
+			break;
+		}
+	}
+
+	return used;
+}
+
+
+
+size_t ProfilerArena::GetNumBytesReserved() const
+{
+	size_t reserved = 0;
+
+	for (Block* block = m_firstBlock; block != nullptr; block = block->m_next)
+	{
+		reserved += block->m_size;
+	}
+
+	return reserved;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+
+
+// A linear (bump) allocator, the profiler keeps one per retained frame
+//	Nothing allocated from the arena is ever freed individually, Reset() recycles everything at once
+//	Blocks are kept across resets so a recycled arena settles at its high water mark and stops touching the heap
+class ProfilerArena
+{
+public:
+	ProfilerArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+	~ProfilerArena();
+
+	void*		Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	const char* CopyString(const char* str);
+	void		Reset();
+
+	template<typename T, typename... Args>
+	T*			Create(Args&&... args) { return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...); }
+
+	size_t		GetNumBytesUsed() const;
+	size_t		GetNumBytesReserved() const;
+
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+
+
+private:
+	struct Block
+	{
+		Block*	m_next;
+		size_t	m_size;
+		size_t	m_used;
+
+		char*	GetData() { return (char*)(this + 1); }
+	};
+
+	Block*		AllocateBlock(size_t minSize);
+
+	size_t		m_blockSize;
+	Block*		m_firstBlock	= nullptr;
+	Block*		m_currentBlock	= nullptr;
+
+	// No copying, the nodes inside point at each other
+	ProfilerArena(const ProfilerArena&) = delete;
+	ProfilerArena& operator=(const ProfilerArena&) = delete;
+};
\ No newline at end of file
@@ -0,0 +1,916 @@
+#include "Engine/Profiler/ProfilerCapture.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include "Engine/Core/EngineCommon.h"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+#include "Engine/Profiler/ProfilerArena.hpp"
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Format ---------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Header, then chunks in the order they were written, then (once stopped) the index
+//	Header:	magic, version, reserved, seconds per tick (double), index offset (0 until the capture is stopped)
+//	String:	'S', varint ID, varint length, the bytes, a NUL so the mapping can hand them out as is
+//	Frame:	'F', payload size (uint32), payload
+//	Index:	magic, string count, frame count, every string as (uint32 length, bytes, NUL), every frame as (uint64 offset, uint32 size, uint32 number)
+//
+// Frame payload, all varints:
+//	frame number, flags, thread count, then per thread
+//		thread name ID (ignored for the main thread, its root is "Frame N"), root start ticks, root duration, root body
+//	A body is [allocation counts if flagged][hardware counts if flagged] child count, then each child as
+//		name ID, zigzag start relative to the cursor, duration, body
+//	The cursor starts at the parent's start and moves to each child's end, so in order siblings come out as small numbers
+//
+// Everything is little endian, which is every platform the engine runs on
+constexpr char		CAPTURE_MAGIC[8]			= {'P', 'R', 'F', 'C', 'A', 'P', 'T', '\0'};
+constexpr char		CAPTURE_INDEX_MAGIC[8]		= {'P', 'R', 'F', 'I', 'N', 'D', 'X', '\0'};
+constexpr uint32_t	CAPTURE_VERSION				= 1;
+constexpr size_t	CAPTURE_HEADER_SIZE			= 32;
+constexpr size_t	CAPTURE_INDEX_OFFSET_OFFSET	= 24;
+
+constexpr uint8_t	CAPTURE_CHUNK_STRING		= 'S';
+constexpr uint8_t	CAPTURE_CHUNK_FRAME			= 'F';
+
+constexpr uint64_t	CAPTURE_FLAG_MEMORY			= 1 << 0;
+constexpr uint64_t	CAPTURE_FLAG_COUNTERS		= 1 << 1;
+
+constexpr uint32_t	CAPTURE_FRAME_NAME_ID		= 0;	// Always the first string
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// State ----------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// One frame's worth of bytes on its way to the writer
+//	Strings the frame introduced come first, if the frame has to be dropped they are still written
+struct CaptureChunk
+{
+	std::vector<uint8_t>				m_bytes;
+	size_t								m_frameOffset = 0;
+	unsigned int						m_frameNumber = 0;
+};
+
+struct CaptureFrameEntry
+{
+	uint64_t							m_offset;
+	uint32_t							m_payloadSize;
+	uint32_t							m_frameNumber;
+};
+
+constexpr size_t						MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+
+// Shared with the writer
+std::mutex								s_captureMutex;
+std::condition_variable					s_captureWakeup;
+std::deque<CaptureChunk*>				s_queuedChunks;
+std::vector<CaptureChunk*>				s_freeChunks;
+size_t									s_numQueuedBytes = 0;
+bool									s_isWriterStopping = false;
+
+// Main thread
+bool									s_isCapturing = false;
+FILE*									s_captureFile = nullptr;
+std::thread								s_captureWriter;
+std::unordered_map<const char*, uint32_t>	s_captureNameIDs;		// Names are interned so the pointer is the identity
+std::vector<const char*>				s_captureNames;
+unsigned int							s_numCapturedFrames = 0;
+unsigned int							s_numDroppedCaptureFrames = 0;
+
+// Writer, handed back to the main thread once it has been joined
+uint64_t								s_captureFileOffset = 0;
+std::vector<CaptureFrameEntry>			s_capturedFrameEntries;
+bool									s_hasCaptureWriteFailed = false;
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Encoding -------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+void Capture_WriteVarint(std::vector<uint8_t>& bytes, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		bytes.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	bytes.push_back((uint8_t)value);
+}
+
+
+
+void Capture_WriteZigZag(std::vector<uint8_t>& bytes, int64_t value)
+{
+	Capture_WriteVarint(bytes, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+
+
+uint32_t Capture_GetNameID(CaptureChunk* chunk, const char* name)
+{
+	auto found = s_captureNameIDs.find(name);
+	if (found != s_captureNameIDs.end())
+	{
+		return found->second;
+	}
+
+	uint32_t nameID = (uint32_t)s_captureNames.size();
+	s_captureNameIDs.emplace(name, nameID);
+	s_captureNames.push_back(name);
+
+	// Ahead of the frame that uses it
+	size_t length = strlen(name);
+	std::vector<uint8_t>& bytes = chunk->m_bytes;
+	bytes.push_back(CAPTURE_CHUNK_STRING);
+	Capture_WriteVarint(bytes, nameID);
+	Capture_WriteVarint(bytes, length);
+	bytes.insert(bytes.end(), (const uint8_t*)name, (const uint8_t*)name + length);
+	bytes.push_back('\0');
+
+	return nameID;
+}
+
+
+
+void Capture_WriteNodeBody_Recursive(CaptureChunk* chunk, std::vector<uint8_t>& frameBytes, const ProfilerNode* node, uint64_t flags)
+{
+	if ((flags & CAPTURE_FLAG_MEMORY) != 0)
+	{
+		Capture_WriteVarint(frameBytes, node->m_memory.m_numAllocations);
+		Capture_WriteVarint(frameBytes, node->m_memory.m_bytesAllocated);
+		Capture_WriteVarint(frameBytes, node->m_memory.m_bytesFreed);
+	}
+	if ((flags & CAPTURE_FLAG_COUNTERS) != 0)
+	{
+		Capture_WriteVarint(frameBytes, node->m_counters.m_cycles);
+		Capture_WriteVarint(frameBytes, node->m_counters.m_instructions);
+		Capture_WriteVarint(frameBytes, node->m_counters.m_l1DataMisses);
+		Capture_WriteVarint(frameBytes, node->m_counters.m_llcMisses);
+		Capture_WriteVarint(frameBytes, node->m_counters.m_branchMisses);
+	}
+
+	Capture_WriteVarint(frameBytes, (uint64_t)node->m_childCount);
+
+	uint64_t cursor = node->m_startHPC;
+	for (const ProfilerNode* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
+	{
+		Capture_WriteVarint(frameBytes, Capture_GetNameID(chunk, child->m_name));
+		Capture_WriteZigZag(frameBytes, (int64_t)(child->m_startHPC - cursor));
+		Capture_WriteVarint(frameBytes, child->GetElapsedTimeHPC());
+		Capture_WriteNodeBody_Recursive(chunk, frameBytes, child, flags);
+
+		cursor = child->m_endHPC;
+	}
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Writing --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+void Capture_Write(const void* data, size_t size)
+{
+	s_hasCaptureWriteFailed |= (fwrite(data, 1, size, s_captureFile) != size);
+	s_captureFileOffset += size;
+}
+
+
+
+void Capture_WriterThread()
+{
+	for (;;)
+	{
+		CaptureChunk* chunk = nullptr;
+		{
+			std::unique_lock<std::mutex> captureLock(s_captureMutex);
+			s_captureWakeup.wait(captureLock, []() { return !s_queuedChunks.empty() || s_isWriterStopping; });
+
+			// Everything queued before the stop still goes out
+			if (s_queuedChunks.empty())
+			{
+				break;
+			}
+
+			chunk = s_queuedChunks.front();
+			s_queuedChunks.pop_front();
+		}
+
+		if (chunk->m_frameOffset < chunk->m_bytes.size())
+		{
+			// Past the 'F' and the size
+			CaptureFrameEntry entry;
+			entry.m_offset = s_captureFileOffset + chunk->m_frameOffset + 1 + sizeof(uint32_t);
+			entry.m_payloadSize = (uint32_t)(chunk->m_bytes.size() - chunk->m_frameOffset - 1 - sizeof(uint32_t));
+			entry.m_frameNumber = chunk->m_frameNumber;
+			s_capturedFrameEntries.push_back(entry);
+		}
+		Capture_Write(chunk->m_bytes.data(), chunk->m_bytes.size());
+
+		std::lock_guard<std::mutex> captureLock(s_captureMutex);
+		s_numQueuedBytes -= chunk->m_bytes.size();
+		s_freeChunks.push_back(chunk);
+	}
+
+	fflush(s_captureFile);
+}
+
+
+
+void ProfilerCapture_AddFrame(unsigned int frameNumber, const std::vector<ProfilerNode*>& threadTrees)
+{
+	if (!s_isCapturing || threadTrees.empty())
+	{
+		return;
+	}
+
+	CaptureChunk* chunk = nullptr;
+	{
+		std::lock_guard<std::mutex> captureLock(s_captureMutex);
+		if (!s_freeChunks.empty())
+		{
+			chunk = s_freeChunks.back();
+			s_freeChunks.pop_back();
+		}
+	}
+	if (chunk == nullptr)
+	{
+		chunk = new CaptureChunk();
+	}
+
+
+	// The frame is built on the side since its strings have to land in front of it
+	static std::vector<uint8_t> s_frameBytes;
+	s_frameBytes.clear();
+	chunk->m_bytes.clear();
+	chunk->m_frameNumber = frameNumber;
+
+	uint64_t flags = 0;
+	flags |= Profiler_IsMemoryTracking() ? CAPTURE_FLAG_MEMORY : 0;
+	flags |= Profiler_IsCountingHardware() ? CAPTURE_FLAG_COUNTERS : 0;
+
+	Capture_WriteVarint(s_frameBytes, frameNumber);
+	Capture_WriteVarint(s_frameBytes, flags);
+	Capture_WriteVarint(s_frameBytes, threadTrees.size());
+	for (int i = 0; i < (int)threadTrees.size(); ++i)
+	{
+		const ProfilerNode* root = threadTrees[i];
+		Capture_WriteVarint(s_frameBytes, (i == 0) ? CAPTURE_FRAME_NAME_ID : Capture_GetNameID(chunk, root->m_name));
+		Capture_WriteVarint(s_frameBytes, root->m_startHPC);
+		Capture_WriteVarint(s_frameBytes, root->GetElapsedTimeHPC());
+		Capture_WriteNodeBody_Recursive(chunk, s_frameBytes, root, flags);
+	}
+
+	chunk->m_frameOffset = chunk->m_bytes.size();
+	uint32_t payloadSize = (uint32_t)s_frameBytes.size();
+	chunk->m_bytes.push_back(CAPTURE_CHUNK_FRAME);
+	chunk->m_bytes.insert(chunk->m_bytes.end(), (const uint8_t*)&payloadSize, (const uint8_t*)&payloadSize + sizeof(payloadSize));
+	chunk->m_bytes.insert(chunk->m_bytes.end(), s_frameBytes.begin(), s_frameBytes.end());
+
+
+	// Hand it over, unless the disk can't keep up
+	std::lock_guard<std::mutex> captureLock(s_captureMutex);
+	if (s_numQueuedBytes + chunk->m_bytes.size() > MAX_QUEUED_BYTES)
+	{
+		chunk->m_bytes.resize(chunk->m_frameOffset);
+		++s_numDroppedCaptureFrames;
+	}
+	else
+	{
+		++s_numCapturedFrames;
+	}
+
+	if (chunk->m_bytes.empty())
+	{
+		s_freeChunks.push_back(chunk);
+		return;
+	}
+
+	s_numQueuedBytes += chunk->m_bytes.size();
+	s_queuedChunks.push_back(chunk);
+	s_captureWakeup.notify_one();
+}
+
+
+
+bool Profiler_StartCapture(const std::string& filepath)
+{
+	if (s_isCapturing)
+	{
+		return false;
+	}
+
+	s_captureFile = fopen(filepath.c_str(), "wb");
+	if (s_captureFile == nullptr)
+	{
+		return false;
+	}
+	setvbuf(s_captureFile, nullptr, _IOFBF, 1024 * 1024);
+
+
+	// Header, the index offset is filled in by Profiler_StopCapture
+	s_captureFileOffset = 0;
+	s_capturedFrameEntries.clear();
+	s_hasCaptureWriteFailed = false;
+
+	uint8_t header[CAPTURE_HEADER_SIZE] = {};
+	double secondsPerTick = Profiler_ConvertTicksToSeconds(1000000000ull) / 1000000000.0;
+	memcpy(header, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+	memcpy(header + 8, &CAPTURE_VERSION, sizeof(CAPTURE_VERSION));
+	memcpy(header + 16, &secondsPerTick, sizeof(secondsPerTick));
+	Capture_Write(header, sizeof(header));
+
+
+	// Every capture's string 0 names the main thread roots
+	s_captureNameIDs.clear();
+	s_captureNames.clear();
+	s_captureNames.push_back("Frame");
+
+	CaptureChunk firstStrings;
+	firstStrings.m_bytes.push_back(CAPTURE_CHUNK_STRING);
+	Capture_WriteVarint(firstStrings.m_bytes, CAPTURE_FRAME_NAME_ID);
+	Capture_WriteVarint(firstStrings.m_bytes, 5);
+	firstStrings.m_bytes.insert(firstStrings.m_bytes.end(), (const uint8_t*)"Frame", (const uint8_t*)"Frame" + 6);
+	Capture_Write(firstStrings.m_bytes.data(), firstStrings.m_bytes.size());
+
+
+	s_numCapturedFrames = 0;
+	s_numDroppedCaptureFrames = 0;
+	s_isWriterStopping = false;
+	s_isCapturing = true;
+	s_captureWriter = std::thread(Capture_WriterThread);
+
+	return true;
+}
+
+
+
+void Profiler_StopCapture()
+{
+	if (!s_isCapturing)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> captureLock(s_captureMutex);
+		s_isWriterStopping = true;
+	}
+	s_captureWakeup.notify_one();
+	s_captureWriter.join();
+	s_isCapturing = false;
+
+
+	// Index
+	uint64_t indexOffset = s_captureFileOffset;
+	uint32_t numStrings = (uint32_t)s_captureNames.size();
+	uint32_t numFrames = (uint32_t)s_capturedFrameEntries.size();
+	Capture_Write(CAPTURE_INDEX_MAGIC, sizeof(CAPTURE_INDEX_MAGIC));
+	Capture_Write(&numStrings, sizeof(numStrings));
+	Capture_Write(&numFrames, sizeof(numFrames));
+	for (uint32_t i = 0; i < numStrings; ++i)
+	{
+		uint32_t length = (uint32_t)strlen(s_captureNames[i]);
+		Capture_Write(&length, sizeof(length));
+		Capture_Write(s_captureNames[i], length + 1);
+	}
+	for (uint32_t i = 0; i < numFrames; ++i)
+	{
+		const CaptureFrameEntry& entry = s_capturedFrameEntries[i];
+		Capture_Write(&entry.m_offset, sizeof(entry.m_offset));
+		Capture_Write(&entry.m_payloadSize, sizeof(entry.m_payloadSize));
+		Capture_Write(&entry.m_frameNumber, sizeof(entry.m_frameNumber));
+	}
+
+	// Only now is the file complete enough to point at the index
+	s_hasCaptureWriteFailed |= (fseek(s_captureFile, (long)CAPTURE_INDEX_OFFSET_OFFSET, SEEK_SET) != 0);
+	s_hasCaptureWriteFailed |= (fwrite(&indexOffset, 1, sizeof(indexOffset), s_captureFile) != sizeof(indexOffset));
+	s_hasCaptureWriteFailed |= (fclose(s_captureFile) != 0);
+	s_captureFile = nullptr;
+
+
+	// Give the chunks back
+	for (int i = 0; i < (int)s_freeChunks.size(); ++i)
+	{
+		delete s_freeChunks[i];
+	}
+	s_freeChunks.clear();
+	s_capturedFrameEntries.clear();
+	s_captureNameIDs.clear();
+	s_captureNames.clear();
+}
+
+
+
+bool Profiler_IsCapturing()
+{
+	return s_isCapturing;
+}
+
+
+
+unsigned int Profiler_GetNumCapturedFrames()
+{
+	return s_numCapturedFrames;
+}
+
+
+
+unsigned int Profiler_GetNumDroppedCaptureFrames()
+{
+	return s_numDroppedCaptureFrames;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Decoding -------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Never reads past the end, a truncated or corrupt capture just fails
+class CaptureReader
+{
+public:
+	CaptureReader(const uint8_t* begin, const uint8_t* end) : m_cursor(begin), m_end(end) {}
+
+	bool HasFailed() const			{ return m_hasFailed; }
+	bool IsAtEnd() const			{ return m_cursor >= m_end; }
+	const uint8_t* GetCursor() const	{ return m_cursor; }
+	void Fail()						{ m_hasFailed = true; m_cursor = m_end; }
+
+	uint64_t ReadVarint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (m_cursor >= m_end)
+			{
+				break;
+			}
+
+			uint8_t byte = *m_cursor++;
+			value |= (uint64_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return value;
+			}
+		}
+
+		m_hasFailed = true;
+		return 0;
+	}
+
+	int64_t ReadZigZag()
+	{
+		uint64_t value = ReadVarint();
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+
+	void Read(void* data, size_t size)
+	{
+		if ((size_t)(m_end - m_cursor) < size)
+		{
+			m_hasFailed = true;
+			m_cursor = m_end;
+			memset(data, 0, size);
+			return;
+		}
+
+		memcpy(data, m_cursor, size);
+		m_cursor += size;
+	}
+
+	const char* ReadString(size_t length)
+	{
+		// The NUL is part of the string on disk
+		if ((size_t)(m_end - m_cursor) < length + 1 || m_cursor[length] != '\0')
+		{
+			m_hasFailed = true;
+			m_cursor = m_end;
+			return nullptr;
+		}
+
+		const char* str = (const char*)m_cursor;
+		m_cursor += length + 1;
+		return str;
+	}
+
+private:
+	const uint8_t*	m_cursor;
+	const uint8_t*	m_end;
+	bool			m_hasFailed = false;
+};
+
+
+
+struct CaptureDecodeContext
+{
+	CaptureReader*						m_reader;
+	ProfilerArena*						m_arena;
+	const std::vector<const char*>*		m_names;
+	uint64_t							m_flags;
+	double								m_tickScale;
+};
+
+
+
+uint64_t Capture_ScaleTicks(const CaptureDecodeContext& context, uint64_t ticks)
+{
+	return (context.m_tickScale == 1.0) ? ticks : (uint64_t)((double)ticks * context.m_tickScale);
+}
+
+
+
+void Capture_ReadNodeBody_Recursive(CaptureDecodeContext& context, ProfilerNode* node, uint64_t startTicks, int depth)
+{
+	CaptureReader& reader = *context.m_reader;
+
+	if ((context.m_flags & CAPTURE_FLAG_MEMORY) != 0)
+	{
+		node->m_memory.m_numAllocations	= reader.ReadVarint();
+		node->m_memory.m_bytesAllocated	= reader.ReadVarint();
+		node->m_memory.m_bytesFreed		= reader.ReadVarint();
+	}
+	if ((context.m_flags & CAPTURE_FLAG_COUNTERS) != 0)
+	{
+		node->m_counters.m_cycles		= reader.ReadVarint();
+		node->m_counters.m_instructions	= reader.ReadVarint();
+		node->m_counters.m_l1DataMisses	= reader.ReadVarint();
+		node->m_counters.m_llcMisses	= reader.ReadVarint();
+		node->m_counters.m_branchMisses	= reader.ReadVarint();
+	}
+
+	// Deeper than any real stack means the data is bad, stop before we run out of ours
+	const int MAX_DEPTH = 1024;
+	uint64_t numChildren = reader.ReadVarint();
+	if (depth > MAX_DEPTH)
+	{
+		reader.Fail();
+		return;
+	}
+
+	uint64_t cursor = startTicks;
+	for (uint64_t i = 0; i < numChildren && !reader.HasFailed(); ++i)
+	{
+		uint64_t nameID = reader.ReadVarint();
+		uint64_t childStart = cursor + (uint64_t)reader.ReadZigZag();
+		uint64_t childEnd = childStart + reader.ReadVarint();
+
+		const char* name = (nameID < context.m_names->size()) ? (*context.m_names)[(size_t)nameID] : nullptr;
+		if (name == nullptr)
+		{
+			reader.Fail();
+			return;
+		}
+
+		ProfilerNode* child = context.m_arena->Create<ProfilerNode>(name);
+		child->m_startHPC = Capture_ScaleTicks(context, childStart);
+		child->m_endHPC = Capture_ScaleTicks(context, childEnd);
+		node->AddChild(child);
+
+		Capture_ReadNodeBody_Recursive(context, child, childStart, depth + 1);
+		cursor = childEnd;
+	}
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Capture File ---------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+ProfilerCaptureFile::~ProfilerCaptureFile()
+{
+	Close();
+}
+
+
+
+bool ProfilerCaptureFile::Open(const std::string& filepath)
+{
+	Close();
+
+
+	// Map it, the handles aren't needed once the view exists
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= (LONGLONG)CAPTURE_HEADER_SIZE)
+	{
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	if (mapping != nullptr)
+	{
+		m_data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		m_size = (size_t)fileSize.QuadPart;
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+#else
+	int file = open(filepath.c_str(), O_RDONLY);
+	if (file == -1)
+	{
+		return false;
+	}
+
+	struct stat fileStats;
+	if (fstat(file, &fileStats) == 0 && fileStats.st_size >= (off_t)CAPTURE_HEADER_SIZE)
+	{
+		void* view = mmap(nullptr, (size_t)fileStats.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (view != MAP_FAILED)
+		{
+			m_data = (const uint8_t*)view;
+			m_size = (size_t)fileStats.st_size;
+		}
+	}
+	close(file);
+#endif
+
+	if (m_data == nullptr)
+	{
+		m_size = 0;
+		return false;
+	}
+
+
+	// Header
+	uint32_t version = 0;
+	double secondsPerTick = 0.0;
+	uint64_t indexOffset = 0;
+	memcpy(&version, m_data + 8, sizeof(version));
+	memcpy(&secondsPerTick, m_data + 16, sizeof(secondsPerTick));
+	memcpy(&indexOffset, m_data + CAPTURE_INDEX_OFFSET_OFFSET, sizeof(indexOffset));
+	if (memcmp(m_data, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 || version != CAPTURE_VERSION)
+	{
+		Close();
+		return false;
+	}
+
+	// The capture's clock may not be ours, ticks are converted so our reports read them right
+	double ourSecondsPerTick = Profiler_ConvertTicksToSeconds(1000000000ull) / 1000000000.0;
+	m_tickScale = 1.0;
+	if (secondsPerTick > 0.0 && ourSecondsPerTick > 0.0 && secondsPerTick != ourSecondsPerTick)
+	{
+		m_tickScale = secondsPerTick / ourSecondsPerTick;
+	}
+
+
+	// A capture that never got stopped has no index, walk it instead
+	bool isIndexed = (indexOffset != 0) ? ReadIndex(indexOffset) : RebuildIndex();
+	if (!isIndexed || m_names.empty())
+	{
+		Close();
+		return false;
+	}
+
+	// Interned so reports built from the capture can outlive it
+	for (int i = 0; i < (int)m_names.size(); ++i)
+	{
+		if (m_names[i] != nullptr)
+		{
+			m_names[i] = Profiler_InternName(m_names[i]);
+		}
+	}
+
+	return true;
+}
+
+
+
+void ProfilerCaptureFile::Close()
+{
+	if (m_data != nullptr)
+	{
+#if defined(_WIN32)
+		UnmapViewOfFile(m_data);
+#else
+		munmap((void*)m_data, m_size);
+#endif
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_names.clear();
+	m_frames.clear();
+}
+
+
+
+bool ProfilerCaptureFile::ReadIndex(uint64_t indexOffset)
+{
+	if (indexOffset > m_size)
+	{
+		return false;
+	}
+
+	CaptureReader reader(m_data + indexOffset, m_data + m_size);
+
+	char magic[sizeof(CAPTURE_INDEX_MAGIC)];
+	uint32_t numStrings = 0;
+	uint32_t numFrames = 0;
+	reader.Read(magic, sizeof(magic));
+	reader.Read(&numStrings, sizeof(numStrings));
+	reader.Read(&numFrames, sizeof(numFrames));
+	if (reader.HasFailed() || memcmp(magic, CAPTURE_INDEX_MAGIC, sizeof(magic)) != 0)
+	{
+		return false;
+	}
+
+	m_names.reserve(numStrings);
+	for (uint32_t i = 0; i < numStrings && !reader.HasFailed(); ++i)
+	{
+		uint32_t length = 0;
+		reader.Read(&length, sizeof(length));
+		m_names.push_back(reader.ReadString(length));
+	}
+
+	m_frames.reserve(numFrames);
+	for (uint32_t i = 0; i < numFrames && !reader.HasFailed(); ++i)
+	{
+		FrameEntry entry;
+		reader.Read(&entry.m_offset, sizeof(entry.m_offset));
+		reader.Read(&entry.m_payloadSize, sizeof(entry.m_payloadSize));
+		reader.Read(&entry.m_frameNumber, sizeof(entry.m_frameNumber));
+		// Checked without adding, an offset near the top of the range would wrap past it
+		if (entry.m_offset > indexOffset || entry.m_payloadSize > indexOffset - entry.m_offset)
+		{
+			return false;
+		}
+		m_frames.push_back(entry);
+	}
+
+	return !reader.HasFailed();
+}
+
+
+
+bool ProfilerCaptureFile::RebuildIndex()
+{
+	// Stops at the first chunk that doesn't make sense, which is where the writer was cut off
+	CaptureReader reader(m_data + CAPTURE_HEADER_SIZE, m_data + m_size);
+	while (!reader.IsAtEnd())
+	{
+		uint8_t chunkType = 0;
+		reader.Read(&chunkType, sizeof(chunkType));
+
+		if (chunkType == CAPTURE_CHUNK_STRING)
+		{
+			uint64_t nameID = reader.ReadVarint();
+			uint64_t length = reader.ReadVarint();
+			const char* name = reader.HasFailed() ? nullptr : reader.ReadString((size_t)length);
+			if (reader.HasFailed() || nameID > m_names.size())
+			{
+				break;
+			}
+
+			if (nameID == m_names.size())
+			{
+				m_names.push_back(name);
+			}
+		}
+		else if (chunkType == CAPTURE_CHUNK_FRAME)
+		{
+			uint32_t payloadSize = 0;
+			reader.Read(&payloadSize, sizeof(payloadSize));
+			const uint8_t* payload = reader.GetCursor();
+			if (reader.HasFailed() || (size_t)(m_data + m_size - payload) < payloadSize)
+			{
+				break;
+			}
+
+			CaptureReader payloadReader(payload, payload + payloadSize);
+			FrameEntry entry;
+			entry.m_offset = (uint64_t)(payload - m_data);
+			entry.m_payloadSize = payloadSize;
+			entry.m_frameNumber = (uint32_t)payloadReader.ReadVarint();
+			m_frames.push_back(entry);
+
+			reader = CaptureReader(payload + payloadSize, m_data + m_size);
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return true;
+}
+
+
+
+unsigned int ProfilerCaptureFile::GetFrameNumber(int frameIndex) const
+{
+	GUARANTEE_OR_DIE(frameIndex >= 0 && frameIndex < (int)m_frames.size(), "Capture frame index out of range");
+	return m_frames[frameIndex].m_frameNumber;
+}
+
+
+
+std::vector<ProfilerNode*> ProfilerCaptureFile::DecodeFrame(int frameIndex, ProfilerArena& arena) const
+{
+	GUARANTEE_OR_DIE(frameIndex >= 0 && frameIndex < (int)m_frames.size(), "Capture frame index out of range");
+
+	const FrameEntry& entry = m_frames[frameIndex];
+	CaptureReader reader(m_data + entry.m_offset, m_data + entry.m_offset + entry.m_payloadSize);
+
+	CaptureDecodeContext context;
+	context.m_reader = &reader;
+	context.m_arena = &arena;
+	context.m_names = &m_names;
+	context.m_tickScale = m_tickScale;
+
+	unsigned int frameNumber = (unsigned int)reader.ReadVarint();
+	context.m_flags = reader.ReadVarint();
+	uint64_t numThreads = reader.ReadVarint();
+
+	std::vector<ProfilerNode*> threadTrees;
+	for (uint64_t i = 0; i < numThreads && !reader.HasFailed(); ++i)
+	{
+		uint64_t threadNameID = reader.ReadVarint();
+		uint64_t rootStart = reader.ReadVarint();
+		uint64_t rootEnd = rootStart + reader.ReadVarint();
+
+		const char* rootName = nullptr;
+		if (i == 0)
+		{
+			char frameName[32];
+			snprintf(frameName, sizeof(frameName), "Frame %u", frameNumber);
+			rootName = arena.CopyString(frameName);
+		}
+		else if (threadNameID < m_names.size())
+		{
+			rootName = m_names[(size_t)threadNameID];
+		}
+		if (rootName == nullptr)
+		{
+			break;
+		}
+
+		ProfilerNode* root = arena.Create<ProfilerNode>(rootName);
+		root->m_startHPC = Capture_ScaleTicks(context, rootStart);
+		root->m_endHPC = Capture_ScaleTicks(context, rootEnd);
+		Capture_ReadNodeBody_Recursive(context, root, rootStart, 0);
+		threadTrees.push_back(root);
+	}
+
+	// A frame we couldn't read all of isn't handed out half built
+	if (reader.HasFailed())
+	{
+		threadTrees.clear();
+	}
+
+	return threadTrees;
+}
+
+
+
+ReportNode* ProfilerCaptureFile::GenerateReportTree(int firstFrameIndex, int numFrames) const
+{
+	GUARANTEE_OR_DIE(firstFrameIndex >= 0 && numFrames > 0 && firstFrameIndex + numFrames <= (int)m_frames.size(), "Capture frame range out of range");
+
+	ReportNode* report = nullptr;
+	ProfilerArena arena;
+
+	for (int frameIndex = firstFrameIndex; frameIndex < firstFrameIndex + numFrames; ++frameIndex)
+	{
+		arena.Reset();
+
+		std::vector<ProfilerNode*> threadTrees = DecodeFrame(frameIndex, arena);
+		if (threadTrees.empty())
+		{
+			continue;
+		}
+
+		if (report == nullptr)
+		{
+			report = Profiler_GenerateReportTree(threadTrees[0]);
+		}
+		else
+		{
+			Profiler_MergeIntoReportTree(report, threadTrees[0]);
+		}
+	}
+
+	return report;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Engine/Profiler/Profiler.hpp"
+
+class ProfilerArena;
+
+
+
+// Streams every closed frame, every thread, to a binary capture for soak tests that outlast the frame ring
+//	Profiler_BeginFrame encodes the frame (names as string table IDs, timestamps as varint deltas, about 6 bytes a scope)
+//	and a background thread writes it out, if the disk falls more than 64MB behind frames are dropped and counted
+//	Returns false if the file couldn't be opened or a capture is already running
+bool			Profiler_StartCapture(const std::string& filepath);
+void			Profiler_StopCapture(); // Waits for the writer, then writes the index a loader needs to skip straight to any frame
+bool			Profiler_IsCapturing();
+unsigned int	Profiler_GetNumCapturedFrames();
+unsigned int	Profiler_GetNumDroppedCaptureFrames();
+
+// Called by Profiler_BeginFrame with one root per thread, the main thread first
+void			ProfilerCapture_AddFrame(unsigned int frameNumber, const std::vector<ProfilerNode*>& threadTrees);
+
+
+
+// A capture mapped into memory, frames are only decoded when asked for so the file can be far bigger than RAM
+//	Captures that were never stopped (the game crashed) are still readable, their chunks are walked to rebuild the index
+//	Timestamps are rescaled to this process's profiler clock so the usual report functions read them correctly
+class ProfilerCaptureFile
+{
+public:
+	ProfilerCaptureFile() {};
+	~ProfilerCaptureFile();
+
+	bool			Open(const std::string& filepath);
+	void			Close();
+	bool			IsOpen() const { return m_data != nullptr; }
+
+	int				GetNumFrames() const { return (int)m_frames.size(); }
+	unsigned int	GetFrameNumber(int frameIndex) const;
+
+	// One root per thread, the main thread first, everything is allocated from the arena
+	std::vector<ProfilerNode*>	DecodeFrame(int frameIndex, ProfilerArena& arena) const;
+
+	// Main thread trees of [firstFrameIndex, firstFrameIndex + numFrames) merged into one report, see Profiler_MergeIntoReportTree
+	//	Only one frame is decoded at a time
+	ReportNode*		GenerateReportTree(int firstFrameIndex, int numFrames) const;
+
+private:
+	struct FrameEntry
+	{
+		uint64_t		m_offset;		// Of the frame's payload
+		uint32_t		m_payloadSize;
+		uint32_t		m_frameNumber;
+	};
+
+	bool			ReadIndex(uint64_t indexOffset);
+	bool			RebuildIndex();
+
+	const uint8_t*				m_data = nullptr;
+	size_t						m_size = 0;
+
+	double						m_tickScale = 1.0;			// Capture ticks to this process's ticks
+	std::vector<const char*>	m_names;					// Interned, by capture string ID
+	std::vector<FrameEntry>		m_frames;
+
+	// No copying, the mapping would be unmapped twice
+	ProfilerCaptureFile(const ProfilerCaptureFile&) = delete;
+	ProfilerCaptureFile& operator=(const ProfilerCaptureFile&) = delete;
+};
@@ -0,0 +1,303 @@
+#include "Engine/Profiler/ProfilerClock.hpp"
+
+#include <algorithm>
+
+#if defined(PROFILER_CLOCK_HAS_TSC) && !defined(_MSC_VER)
+	#include <cpuid.h>
+#endif
+
+#include "Engine/Core/EngineCommon.h"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// State ----------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+eProfilerClock	g_profilerClock					= PROFILER_CLOCK_HPC;
+
+bool			s_isClockInitialized			= false;
+double			s_secondsPerTick				= 0.0;		// Unused by the HPC, it converts through Time.hpp
+uint64_t		s_overheadTicks					= 0;
+bool			s_isOverheadCompensated			= true;
+
+constexpr double CALIBRATION_SECONDS			= 0.02;
+constexpr int	 NUM_OVERHEAD_BATCHES			= 64;
+constexpr int	 NUM_OVERHEAD_SAMPLES_PER_BATCH	= 256;
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Support --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+bool IsInvariantTSCSupported()
+{
+	// An invariant TSC ticks at a constant rate through frequency changes and sleep states and is synced across cores
+	//	Without it TSC deltas aren't time, so we won't hand it out
+#if defined(PROFILER_CLOCK_HAS_TSC) && defined(_MSC_VER)
+	int registers[4];
+	__cpuid(registers, 0x80000000);
+	if ((unsigned int)registers[0] < 0x80000007)
+	{
+		return false;
+	}
+
+	__cpuid(registers, 0x80000007);
+	return (registers[3] & (1 << 8)) != 0;
+#elif defined(PROFILER_CLOCK_HAS_TSC)
+	unsigned int eax = 0;
+	unsigned int ebx = 0;
+	unsigned int ecx = 0;
+	unsigned int edx = 0;
+	if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+	{
+		return false;
+	}
+
+	return (edx & (1u << 8)) != 0;
+#else
+	return false;
+#endif
+}
+
+
+
+bool IsClockSupported(eProfilerClock clock)
+{
+	bool isSupported = false;
+
+	switch (clock)
+	{
+	case PROFILER_CLOCK_HPC:
+	{
+		isSupported = true;
+		break;
+	}
+	case PROFILER_CLOCK_MONOTONIC_RAW:
+	{
+#ifdef PROFILER_CLOCK_HAS_MONOTONIC_RAW
+		isSupported = true;
+#endif
+		break;
+	}
+	case PROFILER_CLOCK_TSC:
+	case PROFILER_CLOCK_TSCP:
+	{
+		isSupported = IsInvariantTSCSupported();
+		break;
+	}
+	case PROFILER_CLOCK_INVALID:
+	case PROFILER_CLOCK_COUNT:
+	default:
+	{
+		break;
+	}
+	}
+
+	return isSupported;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Calibration ----------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// What the TSC is measured against
+//	CLOCK_MONOTONIC_RAW is never slewed by NTP, so an adjustment landing mid spin can't skew the rate
+//	Elsewhere the HPC is QueryPerformanceCounter, which is the monotonic clock there
+double GetCalibrationReferenceSeconds()
+{
+#ifdef PROFILER_CLOCK_HAS_MONOTONIC_RAW
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+	return (double)time.tv_sec + ((double)time.tv_nsec / 1000000000.0);
+#else
+	return ConvertHPCtoSeconds(GetCurrentTimeInHPC());
+#endif
+}
+
+
+
+void CalibrateClock()
+{
+	switch (g_profilerClock)
+	{
+	case PROFILER_CLOCK_TSC:
+	case PROFILER_CLOCK_TSCP:
+	{
+		// Count ticks against the reference for a short spin, sleeping would only add the scheduler's error
+		double startSeconds = GetCalibrationReferenceSeconds();
+		uint64_t startTicks = ProfilerClock_GetCurrentTicks();
+
+		double endSeconds = startSeconds;
+		while (endSeconds - startSeconds < CALIBRATION_SECONDS)
+		{
+			endSeconds = GetCalibrationReferenceSeconds();
+		}
+		uint64_t endTicks = ProfilerClock_GetCurrentTicks();
+
+		s_secondsPerTick = (endSeconds - startSeconds) / (double)(endTicks - startTicks);
+		break;
+	}
+	case PROFILER_CLOCK_MONOTONIC_RAW:
+	{
+		s_secondsPerTick = 1.0 / 1000000000.0;
+		break;
+	}
+	case PROFILER_CLOCK_HPC:
+	case PROFILER_CLOCK_INVALID:
+	case PROFILER_CLOCK_COUNT:
+	default:
+	{
+		break;
+	}
+	}
+}
+
+
+
+void MeasureClockOverhead()
+{
+	// The cheapest batch is the one nothing interrupted, that's the cost we want
+	uint64_t sink = 0;
+	double bestTicksPerSample = 1.0e30;
+
+	for (int batchIndex = 0; batchIndex < NUM_OVERHEAD_BATCHES; ++batchIndex)
+	{
+		uint64_t startTicks = ProfilerClock_GetCurrentTicks();
+		for (int i = 0; i < NUM_OVERHEAD_SAMPLES_PER_BATCH; ++i)
+		{
+			sink ^= ProfilerClock_GetCurrentTicks();
+		}
+		uint64_t endTicks = ProfilerClock_GetCurrentTicks();
+
+		double ticksPerSample = (double)(endTicks - startTicks) / (double)(NUM_OVERHEAD_SAMPLES_PER_BATCH + 1);
+		bestTicksPerSample = std::min(bestTicksPerSample, ticksPerSample);
+	}
+
+	// Keep the loop honest
+	volatile uint64_t keepSink = sink;
+	UNUSED(keepSink);
+
+	s_overheadTicks = (uint64_t)bestTicksPerSample;
+}
+
+
+
+void ProfilerClock_Initialize()
+{
+	// The HPC unless Profiler_SetClock chose otherwise, anything outside the profiler converting m_*HPC with ConvertHPCtoSeconds stays right
+	CalibrateClock();
+	MeasureClockOverhead();
+
+	s_isClockInitialized = true;
+}
+
+
+
+uint64_t ProfilerClock_ConvertSecondsToTicks(double seconds)
+{
+	double secondsPerTick = Profiler_ConvertTicksToSeconds(1000000000ull) / 1000000000.0;
+	return (uint64_t)(seconds / secondsPerTick);
+}
+
+
+
+uint64_t ProfilerClock_RemoveOverhead(uint64_t selfTicks, int numChildren)
+{
+	if (!s_isOverheadCompensated)
+	{
+		return selfTicks;
+	}
+
+	uint64_t overheadTicks = s_overheadTicks * (uint64_t)(numChildren + 1);
+	return (selfTicks > overheadTicks) ? (selfTicks - overheadTicks) : 0;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Public ---------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+bool Profiler_SetClock(eProfilerClock clock)
+{
+	GUARANTEE_OR_DIE(!s_isClockInitialized, "The profiler clock has to be chosen before Profiler_Initialize");
+
+	if (!IsClockSupported(clock))
+	{
+		return false;
+	}
+
+	g_profilerClock = clock;
+	return true;
+}
+
+
+
+eProfilerClock Profiler_GetClock()
+{
+	return g_profilerClock;
+}
+
+
+
+const char* Profiler_GetClockName(eProfilerClock clock)
+{
+	const char* name = "Invalid";
+
+	switch (clock)
+	{
+	case PROFILER_CLOCK_HPC:			name = "HPC";			break;
+	case PROFILER_CLOCK_MONOTONIC_RAW:	name = "MonotonicRaw";	break;
+	case PROFILER_CLOCK_TSC:			name = "TSC";			break;
+	case PROFILER_CLOCK_TSCP:			name = "TSCP";			break;
+	case PROFILER_CLOCK_INVALID:
+	case PROFILER_CLOCK_COUNT:
+	default:
+	{
+		break;
+	}
+	}
+
+	return name;
+}
+
+
+
+double Profiler_GetClockTicksPerSecond()
+{
+	return 1000000.0 / Profiler_ConvertTicksToSeconds(1000000);
+}
+
+
+
+double Profiler_GetClockOverheadNanoseconds()
+{
+	return Profiler_ConvertTicksToSeconds(s_overheadTicks) * 1000000000.0;
+}
+
+
+
+void Profiler_SetClockOverheadCompensation(bool isCompensated)
+{
+	s_isOverheadCompensated = isCompensated;
+}
+
+
+
+bool Profiler_IsClockOverheadCompensated()
+{
+	return s_isOverheadCompensated;
+}
+
+
+
+double Profiler_ConvertTicksToSeconds(uint64_t ticks)
+{
+	if (g_profilerClock == PROFILER_CLOCK_HPC)
+	{
+		return ConvertHPCtoSeconds(ticks);
+	}
+
+	return (double)ticks * s_secondsPerTick;
+}
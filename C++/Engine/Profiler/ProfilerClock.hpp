@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Engine/Core/Time.hpp"
+#include "Engine/Profiler/Profiler.hpp"
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define PROFILER_CLOCK_HAS_TSC
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+#endif
+
+#if defined(__linux__)
+	#define PROFILER_CLOCK_HAS_MONOTONIC_RAW
+	#include <time.h>
+#endif
+
+
+
+// The profiler's timestamp source, see Profiler_SetClock for the public side
+//	Every m_*HPC the profiler records is in these ticks, convert them with Profiler_ConvertTicksToSeconds
+//	The clock is only ever changed before Profiler_Initialize so the switch below always goes the same way
+extern eProfilerClock g_profilerClock;
+
+
+
+inline uint64_t ProfilerClock_GetCurrentTicks()
+{
+	switch (g_profilerClock)
+	{
+#ifdef PROFILER_CLOCK_HAS_TSC
+	case PROFILER_CLOCK_TSC:
+	{
+		return __rdtsc();
+	}
+	case PROFILER_CLOCK_TSCP:
+	{
+		unsigned int processorID;
+		return __rdtscp(&processorID);
+	}
+#endif
+#ifdef PROFILER_CLOCK_HAS_MONOTONIC_RAW
+	case PROFILER_CLOCK_MONOTONIC_RAW:
+	{
+		timespec time;
+		clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+		return ((uint64_t)time.tv_sec * 1000000000ull) + (uint64_t)time.tv_nsec;
+	}
+#endif
+	case PROFILER_CLOCK_HPC:
+	default:
+	{
+		return GetCurrentTimeInHPC();
+	}
+	}
+}
+
+
+
+// Calibrates the chosen clock and measures what a sample costs
+void		ProfilerClock_Initialize();
+
+// For thresholds compared against raw ticks on the hot path, only meaningful once the clock is calibrated
+uint64_t	ProfilerClock_ConvertSecondsToTicks(double seconds);
+
+// Takes the clock's own cost back out of a node's self time
+//	A node's elapsed time holds one sample's worth of clock, and every child leaves one more behind in its parent
+uint64_t	ProfilerClock_RemoveOverhead(uint64_t selfTicks, int numChildren);
@@ -0,0 +1,191 @@
+#include "Engine/Profiler/ProfilerCounters.hpp"
+
+#include <cstring>
+
+#ifdef PROFILER_COUNTERS_HAS_PERF_EVENTS
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+#include "Engine/Core/EngineCommon.h"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// State ----------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+bool	g_isCountingHardware		= false;
+bool	s_areCountersInitialized	= false;
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Groups ---------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+#ifdef PROFILER_COUNTERS_HAS_PERF_EVENTS
+struct CounterDescription
+{
+	uint32_t	m_type;
+	uint64_t	m_config;
+};
+
+// Same order as the fields of ProfilerHardwareCounts, the first one that opens leads the group
+const CounterDescription COUNTER_DESCRIPTIONS[PROFILER_NUM_HARDWARE_COUNTERS] =
+{
+	{PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES},
+	{PERF_TYPE_HARDWARE,	PERF_COUNT_HW_INSTRUCTIONS},
+	{PERF_TYPE_HW_CACHE,	PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+	{PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_MISSES},
+	{PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+
+
+int OpenCounter(const CounterDescription& description, int groupFD)
+{
+	perf_event_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+	attributes.size				= sizeof(attributes);
+	attributes.type				= description.m_type;
+	attributes.config			= description.m_config;
+	attributes.read_format		= PERF_FORMAT_GROUP;
+	attributes.disabled			= (groupFD == -1) ? 1 : 0;	// The leader starts the whole group once it's built
+	attributes.exclude_kernel	= 1;						// Also what lets an unprivileged process open them
+	attributes.exclude_hv		= 1;
+
+	// This thread, any CPU
+	return (int)syscall(__NR_perf_event_open, &attributes, 0, -1, groupFD, 0);
+}
+#endif
+
+
+
+void ProfilerCounters_OpenGroup(ProfilerCounterGroup& group)
+{
+#ifdef PROFILER_COUNTERS_HAS_PERF_EVENTS
+	for (int i = 0; i < PROFILER_NUM_HARDWARE_COUNTERS; ++i)
+	{
+		int fd = OpenCounter(COUNTER_DESCRIPTIONS[i], group.m_leaderFD);
+		if (fd == -1)
+		{
+			continue;
+		}
+
+		if (group.m_leaderFD == -1)
+		{
+			group.m_leaderFD = fd;
+		}
+		group.m_fds[i] = fd;
+		group.m_valueIndices[i] = group.m_numValues;
+		++group.m_numValues;
+	}
+
+	if (group.m_leaderFD != -1)
+	{
+		ioctl(group.m_leaderFD, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(group.m_leaderFD, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+#else
+	UNUSED(group);
+#endif
+}
+
+
+
+void ProfilerCounters_CloseGroup(ProfilerCounterGroup& group)
+{
+#ifdef PROFILER_COUNTERS_HAS_PERF_EVENTS
+	// Members go first, the leader holds the group together
+	for (int i = 0; i < PROFILER_NUM_HARDWARE_COUNTERS; ++i)
+	{
+		if (group.m_fds[i] != -1 && group.m_fds[i] != group.m_leaderFD)
+		{
+			close(group.m_fds[i]);
+		}
+	}
+	if (group.m_leaderFD != -1)
+	{
+		close(group.m_leaderFD);
+	}
+#endif
+
+	group = ProfilerCounterGroup();
+}
+
+
+
+ProfilerHardwareCounts ProfilerCounters_Read(const ProfilerCounterGroup& group)
+{
+	ProfilerHardwareCounts counts;
+
+#ifdef PROFILER_COUNTERS_HAS_PERF_EVENTS
+	if (group.m_leaderFD == -1)
+	{
+		return counts;
+	}
+
+	// PERF_FORMAT_GROUP reads as the number of counters then each value in the order they were opened
+	uint64_t values[1 + PROFILER_NUM_HARDWARE_COUNTERS];
+	ssize_t numBytesRead = read(group.m_leaderFD, values, sizeof(uint64_t) * (size_t)(1 + group.m_numValues));
+	if (numBytesRead < (ssize_t)sizeof(uint64_t) || values[0] != (uint64_t)group.m_numValues)
+	{
+		return counts;
+	}
+
+	uint64_t* counterValues = values + 1;
+	uint64_t* fields[PROFILER_NUM_HARDWARE_COUNTERS] = {&counts.m_cycles, &counts.m_instructions, &counts.m_l1DataMisses, &counts.m_llcMisses, &counts.m_branchMisses};
+	for (int i = 0; i < PROFILER_NUM_HARDWARE_COUNTERS; ++i)
+	{
+		if (group.m_valueIndices[i] != -1)
+		{
+			*fields[i] = counterValues[group.m_valueIndices[i]];
+		}
+	}
+#else
+	UNUSED(group);
+#endif
+
+	return counts;
+}
+
+
+
+void ProfilerCounters_Initialize()
+{
+	s_areCountersInitialized = true;
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Public ---------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+bool Profiler_SetHardwareCounters(bool isCounting)
+{
+	GUARANTEE_OR_DIE(!s_areCountersInitialized, "Hardware counters have to be chosen before Profiler_Initialize");
+
+	if (!isCounting)
+	{
+		g_isCountingHardware = false;
+		return true;
+	}
+
+	// See if the kernel will give us anything at all before promising counts
+	ProfilerCounterGroup testGroup;
+	ProfilerCounters_OpenGroup(testGroup);
+	bool isAvailable = (testGroup.m_leaderFD != -1);
+	ProfilerCounters_CloseGroup(testGroup);
+
+	g_isCountingHardware = isAvailable;
+	return isAvailable;
+}
+
+
+
+bool Profiler_IsCountingHardware()
+{
+	return g_isCountingHardware;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Engine/Profiler/Profiler.hpp"
+
+#if defined(__linux__)
+	#define PROFILER_COUNTERS_HAS_PERF_EVENTS
+#endif
+
+
+
+// Hardware counters through perf_event_open, see Profiler_SetHardwareCounters for the public side
+//	Counting is only ever switched on before Profiler_Initialize, so the hot path checks a plain bool
+extern bool g_isCountingHardware;
+
+
+
+// One thread's counters, perf only counts the thread that opened them so every thread opens its own
+//	They are opened as a group so one read gets all of them from the same instant
+//	Counters the CPU or kernel don't have are left out and read as zero
+constexpr int PROFILER_NUM_HARDWARE_COUNTERS = 5;
+struct ProfilerCounterGroup
+{
+	int		m_leaderFD = -1;
+	int		m_fds[PROFILER_NUM_HARDWARE_COUNTERS] = {-1, -1, -1, -1, -1};
+	int		m_valueIndices[PROFILER_NUM_HARDWARE_COUNTERS] = {-1, -1, -1, -1, -1};	// Where each counter lands in a group read
+	int		m_numValues = 0;
+};
+
+
+
+// Opens the calling thread's group, a group that fails to open just reads zeros
+void					ProfilerCounters_OpenGroup(ProfilerCounterGroup& group);
+void					ProfilerCounters_CloseGroup(ProfilerCounterGroup& group);
+
+// Running totals for the group's thread, safe from any thread
+ProfilerHardwareCounts	ProfilerCounters_Read(const ProfilerCounterGroup& group);
+
+// Locks the choice in, called by Profiler_Initialize
+void					ProfilerCounters_Initialize();
@@ -0,0 +1,557 @@
+#include "Engine/Profiler/ProfilerExport.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <map>
+
+#include "Engine/Core/EngineCommon.h"
+#include "Engine/Profiler/Profiler.hpp"
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Buffered Writing -----------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+class ExportWriter
+{
+public:
+	ExportWriter(const std::string& filepath) : m_buffer(BUFFER_SIZE)	{ m_file = fopen(filepath.c_str(), "wb"); }
+	~ExportWriter()								{ Close(); }
+
+	bool IsOpen() const							{ return m_file != nullptr; }
+	bool HasFailed() const						{ return m_hasFailed; }
+
+	void Write(const void* data, size_t size)
+	{
+		if (m_used + size > BUFFER_SIZE)
+		{
+			Flush();
+		}
+
+		// Anything bigger than the whole buffer skips it
+		if (size > BUFFER_SIZE)
+		{
+			m_hasFailed |= (fwrite(data, 1, size, m_file) != size);
+			return;
+		}
+
+		memcpy(m_buffer.data() + m_used, data, size);
+		m_used += size;
+	}
+
+	void Write(const char* str)					{ Write(str, strlen(str)); }
+	void Write(const std::string& str)			{ Write(str.data(), str.size()); }
+
+	// snprintf's result is what it wanted to write, anything cut off or an encoding error fails the export instead of reading past the buffer
+	void WritePrinted(const char* buffer, size_t bufferSize, int length)
+	{
+		if (length < 0 || (size_t)length >= bufferSize)
+		{
+			m_hasFailed = true;
+			length = (length < 0) ? 0 : (int)(bufferSize - 1);
+		}
+		Write(buffer, (size_t)length);
+	}
+
+	void Flush()
+	{
+		if (m_used > 0)
+		{
+			m_hasFailed |= (fwrite(m_buffer.data(), 1, m_used, m_file) != m_used);
+			m_used = 0;
+		}
+	}
+
+	void Close()
+	{
+		if (m_file != nullptr)
+		{
+			Flush();
+			m_hasFailed |= (fclose(m_file) != 0);
+			m_file = nullptr;
+		}
+	}
+
+private:
+	static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+	FILE*				m_file = nullptr;
+	bool				m_hasFailed = false;
+	size_t				m_used = 0;
+	std::vector<char>	m_buffer;
+};
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Tracks ---------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Threads only show up in the frames they recorded something in, the root name is what ties them together
+//	The main thread's root is named after the frame so it is always track 0
+struct ExportFrameTree
+{
+	int				m_trackIndex;
+	ProfilerNode*	m_root;
+};
+
+
+
+void GatherExportTrees(std::vector<ExportFrameTree>& outTrees, std::vector<std::string>& outTrackNames, uint64_t& outFirstHPC)
+{
+	std::map<std::string, int> trackIndices;
+	outTrackNames.push_back("Main");
+	outFirstHPC = 0;
+
+	// Oldest first so timestamps are mostly increasing
+	for (int xTreesAgo = Profiler_GetNumPreviousTrees() - 1; xTreesAgo >= 0; --xTreesAgo)
+	{
+		std::vector<ProfilerNode*> threadTrees = Profiler_GetPreviousThreadTrees((unsigned int)xTreesAgo);
+		for (int i = 0; i < (int)threadTrees.size(); ++i)
+		{
+			ExportFrameTree tree;
+			tree.m_root = threadTrees[i];
+			tree.m_trackIndex = 0;
+
+			if (i != 0)
+			{
+				auto found = trackIndices.find(tree.m_root->m_name);
+				if (found == trackIndices.end())
+				{
+					found = trackIndices.emplace(tree.m_root->m_name, (int)outTrackNames.size()).first;
+					outTrackNames.push_back(tree.m_root->m_name);
+				}
+				tree.m_trackIndex = found->second;
+			}
+
+			if (outTrees.empty() || tree.m_root->m_startHPC < outFirstHPC)
+			{
+				outFirstHPC = tree.m_root->m_startHPC;
+			}
+			outTrees.push_back(tree);
+		}
+	}
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Chrome Trace ---------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+void ChromeTrace_WriteString(ExportWriter& writer, const char* str)
+{
+	writer.Write("\"", 1);
+
+	const char* runStart = str;
+	for (const char* c = str; *c != '\0'; ++c)
+	{
+		if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20)
+		{
+			writer.Write(runStart, (size_t)(c - runStart));
+
+			char escaped[8];
+			int length = snprintf(escaped, sizeof(escaped), (*c == '"' || *c == '\\') ? "\\%c" : "\\u%04x", (unsigned char)*c);
+			writer.WritePrinted(escaped, sizeof(escaped), length);
+
+			runStart = c + 1;
+		}
+	}
+	writer.Write(runStart, strlen(runStart));
+
+	writer.Write("\"", 1);
+}
+
+
+
+void ChromeTrace_WriteNode_Recursive(ExportWriter& writer, const ProfilerNode* node, int trackIndex, uint64_t firstHPC, bool& isFirstEvent)
+{
+	double startMicroseconds	= Profiler_ConvertTicksToSeconds(node->m_startHPC - firstHPC) * 1000000.0;
+	double durationMicroseconds = Profiler_ConvertTicksToSeconds(node->GetElapsedTimeHPC()) * 1000000.0;
+
+	char line[128];
+	int length = snprintf(line, sizeof(line), "%s\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":", isFirstEvent ? "" : ",", trackIndex, startMicroseconds, durationMicroseconds);
+	writer.WritePrinted(line, sizeof(line), length);
+	ChromeTrace_WriteString(writer, node->m_name);
+	writer.Write("}", 1);
+	isFirstEvent = false;
+
+	for (const ProfilerNode* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
+	{
+		ChromeTrace_WriteNode_Recursive(writer, child, trackIndex, firstHPC, isFirstEvent);
+	}
+}
+
+
+
+bool Profiler_ExportChromeTrace(const std::string& filepath)
+{
+	ExportWriter writer(filepath);
+	if (!writer.IsOpen())
+	{
+		return false;
+	}
+
+	std::vector<ExportFrameTree> trees;
+	std::vector<std::string> trackNames;
+	uint64_t firstHPC = 0;
+	GatherExportTrees(trees, trackNames, firstHPC);
+
+	writer.Write("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	bool isFirstEvent = true;
+
+
+	// Track names
+	for (int i = 0; i < (int)trackNames.size(); ++i)
+	{
+		char line[96];
+		int length = snprintf(line, sizeof(line), "%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", isFirstEvent ? "" : ",", i);
+		writer.WritePrinted(line, sizeof(line), length);
+		ChromeTrace_WriteString(writer, trackNames[i].c_str());
+		writer.Write("}}");
+		isFirstEvent = false;
+	}
+
+
+	// Slices
+	//	Worker roots just span the frame, only the main thread's root (the frame itself) is worth a slice
+	for (int i = 0; i < (int)trees.size(); ++i)
+	{
+		const ExportFrameTree& tree = trees[i];
+		if (tree.m_trackIndex == 0)
+		{
+			ChromeTrace_WriteNode_Recursive(writer, tree.m_root, tree.m_trackIndex, firstHPC, isFirstEvent);
+		}
+		else
+		{
+			for (const ProfilerNode* child = tree.m_root->m_firstChild; child != nullptr; child = child->m_nextSibling)
+			{
+				ChromeTrace_WriteNode_Recursive(writer, child, tree.m_trackIndex, firstHPC, isFirstEvent);
+			}
+		}
+	}
+
+	writer.Write("\n]}\n");
+	writer.Close();
+
+	return !writer.HasFailed();
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Perfetto Trace -------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Just enough protobuf to write the perfetto.protos.Trace messages we need
+//	Field numbers are from perfetto/protos/perfetto/trace/trace_packet.proto and friends
+enum ePerfettoField
+{
+	// Trace
+	PERFETTO_TRACE_PACKET						= 1,
+
+	// TracePacket
+	PERFETTO_PACKET_TIMESTAMP					= 8,
+	PERFETTO_PACKET_TRUSTED_SEQUENCE_ID			= 10,
+	PERFETTO_PACKET_TRACK_EVENT					= 11,
+	PERFETTO_PACKET_INTERNED_DATA				= 12,
+	PERFETTO_PACKET_SEQUENCE_FLAGS				= 13,
+	PERFETTO_PACKET_TRACK_DESCRIPTOR			= 60,
+
+	// TrackDescriptor
+	PERFETTO_TRACK_UUID							= 1,
+	PERFETTO_TRACK_PROCESS						= 3,
+	PERFETTO_TRACK_THREAD						= 4,
+
+	// ProcessDescriptor
+	PERFETTO_PROCESS_PID						= 1,
+	PERFETTO_PROCESS_NAME						= 6,
+
+	// ThreadDescriptor
+	PERFETTO_THREAD_PID							= 1,
+	PERFETTO_THREAD_TID							= 2,
+	PERFETTO_THREAD_NAME						= 5,
+
+	// TrackEvent
+	PERFETTO_EVENT_TYPE							= 9,
+	PERFETTO_EVENT_NAME_IID						= 10,
+	PERFETTO_EVENT_TRACK_UUID					= 11,
+
+	// InternedData
+	PERFETTO_INTERNED_EVENT_NAMES				= 2,
+
+	// EventName
+	PERFETTO_EVENT_NAME_IID_FIELD				= 1,
+	PERFETTO_EVENT_NAME_NAME					= 2,
+};
+
+constexpr uint64_t PERFETTO_EVENT_TYPE_SLICE_BEGIN			= 1;
+constexpr uint64_t PERFETTO_EVENT_TYPE_SLICE_END			= 2;
+constexpr uint64_t PERFETTO_SEQUENCE_INCREMENTAL_CLEARED	= 1;
+constexpr uint64_t PERFETTO_SEQUENCE_NEEDS_INCREMENTAL		= 2;
+constexpr uint64_t PERFETTO_SEQUENCE_ID						= 1;
+constexpr uint64_t PERFETTO_PID								= 1;
+constexpr uint64_t PERFETTO_PROCESS_TRACK_UUID				= 1;
+constexpr uint64_t PERFETTO_FIRST_THREAD_TRACK_UUID			= 100;
+
+
+
+class ProtoBuffer
+{
+public:
+	void Clear()										{ m_bytes.clear(); }
+	const std::vector<unsigned char>& GetBytes() const	{ return m_bytes; }
+
+	void WriteVarint(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			m_bytes.push_back((unsigned char)(value | 0x80));
+			value >>= 7;
+		}
+		m_bytes.push_back((unsigned char)value);
+	}
+
+	void WriteVarintField(int field, uint64_t value)
+	{
+		WriteVarint((uint64_t)(field << 3));
+		WriteVarint(value);
+	}
+
+	void WriteBytesField(int field, const void* data, size_t size)
+	{
+		WriteVarint((uint64_t)((field << 3) | 2));
+		WriteVarint(size);
+		m_bytes.insert(m_bytes.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+	}
+
+	void WriteStringField(int field, const char* str)				{ WriteBytesField(field, str, strlen(str)); }
+	void WriteMessageField(int field, const ProtoBuffer& message)	{ WriteBytesField(field, message.m_bytes.data(), message.m_bytes.size()); }
+
+private:
+	std::vector<unsigned char> m_bytes;
+};
+
+
+
+// Packets are built in reused scratch buffers and streamed out one at a time as Trace.packet fields
+class PerfettoStream
+{
+public:
+	PerfettoStream(ExportWriter& writer) : m_writer(writer) {}
+
+	void WritePacket(const ProtoBuffer& packet)
+	{
+		m_frame.Clear();
+		m_frame.WriteMessageField(PERFETTO_TRACE_PACKET, packet);
+		m_writer.Write(m_frame.GetBytes().data(), m_frame.GetBytes().size());
+	}
+
+	void WriteSlice_Recursive(const ProfilerNode* node, uint64_t trackUUID, uint64_t firstHPC)
+	{
+		WriteSliceEvent(node, PERFETTO_EVENT_TYPE_SLICE_BEGIN, node->m_startHPC, trackUUID, firstHPC);
+
+		for (const ProfilerNode* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
+		{
+			WriteSlice_Recursive(child, trackUUID, firstHPC);
+		}
+
+		WriteSliceEvent(node, PERFETTO_EVENT_TYPE_SLICE_END, node->m_endHPC, trackUUID, firstHPC);
+	}
+
+private:
+	void WriteSliceEvent(const ProfilerNode* node, uint64_t type, uint64_t hpc, uint64_t trackUUID, uint64_t firstHPC)
+	{
+		m_packet.Clear();
+		m_event.Clear();
+		m_event.WriteVarintField(PERFETTO_EVENT_TYPE, type);
+		m_event.WriteVarintField(PERFETTO_EVENT_TRACK_UUID, trackUUID);
+
+		// Slice ends are matched by track so they don't need a name
+		if (type == PERFETTO_EVENT_TYPE_SLICE_BEGIN)
+		{
+			// Interned profiler names are unique pointers, the first use of each one carries the string
+			auto found = m_nameIIDs.find(node->m_name);
+			if (found == m_nameIIDs.end())
+			{
+				found = m_nameIIDs.emplace(node->m_name, (uint64_t)m_nameIIDs.size() + 1).first;
+
+				m_eventName.Clear();
+				m_eventName.WriteVarintField(PERFETTO_EVENT_NAME_IID_FIELD, found->second);
+				m_eventName.WriteStringField(PERFETTO_EVENT_NAME_NAME, node->m_name);
+
+				m_internedData.Clear();
+				m_internedData.WriteMessageField(PERFETTO_INTERNED_EVENT_NAMES, m_eventName);
+				m_packet.WriteMessageField(PERFETTO_PACKET_INTERNED_DATA, m_internedData);
+			}
+			m_event.WriteVarintField(PERFETTO_EVENT_NAME_IID, found->second);
+		}
+
+		m_packet.WriteVarintField(PERFETTO_PACKET_TIMESTAMP, (uint64_t)(Profiler_ConvertTicksToSeconds(hpc - firstHPC) * 1000000000.0));
+		m_packet.WriteVarintField(PERFETTO_PACKET_TRUSTED_SEQUENCE_ID, PERFETTO_SEQUENCE_ID);
+		m_packet.WriteVarintField(PERFETTO_PACKET_SEQUENCE_FLAGS, PERFETTO_SEQUENCE_NEEDS_INCREMENTAL);
+		m_packet.WriteMessageField(PERFETTO_PACKET_TRACK_EVENT, m_event);
+
+		WritePacket(m_packet);
+	}
+
+	ExportWriter&						m_writer;
+	ProtoBuffer							m_frame;
+	ProtoBuffer							m_packet;
+	ProtoBuffer							m_event;
+	ProtoBuffer							m_internedData;
+	ProtoBuffer							m_eventName;
+	std::map<const char*, uint64_t>		m_nameIIDs;
+};
+
+
+
+bool Profiler_ExportPerfettoTrace(const std::string& filepath)
+{
+	ExportWriter writer(filepath);
+	if (!writer.IsOpen())
+	{
+		return false;
+	}
+
+	std::vector<ExportFrameTree> trees;
+	std::vector<std::string> trackNames;
+	uint64_t firstHPC = 0;
+	GatherExportTrees(trees, trackNames, firstHPC);
+
+	PerfettoStream stream(writer);
+	ProtoBuffer packet;
+	ProtoBuffer descriptor;
+	ProtoBuffer details;
+
+
+	// Process track, this packet also starts the sequence so the interned names have somewhere to live
+	details.WriteVarintField(PERFETTO_PROCESS_PID, PERFETTO_PID);
+	details.WriteStringField(PERFETTO_PROCESS_NAME, "Engine");
+	descriptor.WriteVarintField(PERFETTO_TRACK_UUID, PERFETTO_PROCESS_TRACK_UUID);
+	descriptor.WriteMessageField(PERFETTO_TRACK_PROCESS, details);
+	packet.WriteVarintField(PERFETTO_PACKET_TRUSTED_SEQUENCE_ID, PERFETTO_SEQUENCE_ID);
+	packet.WriteVarintField(PERFETTO_PACKET_SEQUENCE_FLAGS, PERFETTO_SEQUENCE_INCREMENTAL_CLEARED);
+	packet.WriteMessageField(PERFETTO_PACKET_TRACK_DESCRIPTOR, descriptor);
+	stream.WritePacket(packet);
+
+
+	// Thread tracks
+	for (int i = 0; i < (int)trackNames.size(); ++i)
+	{
+		details.Clear();
+		details.WriteVarintField(PERFETTO_THREAD_PID, PERFETTO_PID);
+		details.WriteVarintField(PERFETTO_THREAD_TID, (uint64_t)(i + 1));
+		details.WriteStringField(PERFETTO_THREAD_NAME, trackNames[i].c_str());
+
+		descriptor.Clear();
+		descriptor.WriteVarintField(PERFETTO_TRACK_UUID, PERFETTO_FIRST_THREAD_TRACK_UUID + i);
+		descriptor.WriteMessageField(PERFETTO_TRACK_THREAD, details);
+
+		packet.Clear();
+		packet.WriteVarintField(PERFETTO_PACKET_TRUSTED_SEQUENCE_ID, PERFETTO_SEQUENCE_ID);
+		packet.WriteMessageField(PERFETTO_PACKET_TRACK_DESCRIPTOR, descriptor);
+		stream.WritePacket(packet);
+	}
+
+
+	// Slices, same rules as the chrome trace
+	for (int i = 0; i < (int)trees.size(); ++i)
+	{
+		const ExportFrameTree& tree = trees[i];
+		uint64_t trackUUID = PERFETTO_FIRST_THREAD_TRACK_UUID + tree.m_trackIndex;
+
+		if (tree.m_trackIndex == 0)
+		{
+			stream.WriteSlice_Recursive(tree.m_root, trackUUID, firstHPC);
+		}
+		else
+		{
+			for (const ProfilerNode* child = tree.m_root->m_firstChild; child != nullptr; child = child->m_nextSibling)
+			{
+				stream.WriteSlice_Recursive(child, trackUUID, firstHPC);
+			}
+		}
+	}
+
+	writer.Close();
+	return !writer.HasFailed();
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Folded Stacks --------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Folded names are split on ';', anything else in a symbol is fine
+void FoldedStacks_AppendName(std::string& stack, const char* name)
+{
+	if (!stack.empty())
+	{
+		stack += ';';
+	}
+
+	for (const char* c = name; *c != '\0'; ++c)
+	{
+		stack += (*c == ';') ? ':' : *c;
+	}
+}
+
+
+
+bool Profiler_ExportFoldedStacks(const std::string& filepath)
+{
+	ExportWriter writer(filepath);
+	if (!writer.IsOpen())
+	{
+		return false;
+	}
+
+
+	// Identical stacks from every frame fold into one line, so the file is sorted and small
+	std::map<std::string, int> stackCounts;
+	std::vector<const ProfilerNode*> scopePath;
+	std::string stack;
+
+	for (int xTreesAgo = Profiler_GetNumPreviousTrees() - 1; xTreesAgo >= 0; --xTreesAgo)
+	{
+		std::vector<ProfilerNode*> threadTrees = Profiler_GetPreviousThreadTrees((unsigned int)xTreesAgo);
+		for (int threadIndex = 0; threadIndex < (int)threadTrees.size(); ++threadIndex)
+		{
+			std::vector<ProfilerSample> samples = Profiler_GetPreviousSamples((unsigned int)xTreesAgo, threadIndex);
+			for (int i = 0; i < (int)samples.size(); ++i)
+			{
+				const ProfilerSample& sample = samples[i];
+
+				scopePath.clear();
+				for (const ProfilerNode* scope = Profiler_FindSampleScope(threadTrees[threadIndex], sample); scope != nullptr; scope = scope->m_parent)
+				{
+					scopePath.push_back(scope);
+				}
+
+				// The main thread's root is named after its frame, every frame should land on the same stack
+				stack.clear();
+				FoldedStacks_AppendName(stack, (threadIndex == 0) ? "Main" : threadTrees[threadIndex]->m_name);
+				for (int j = (int)scopePath.size() - 2; j >= 0; --j)
+				{
+					FoldedStacks_AppendName(stack, scopePath[j]->m_name);
+				}
+				for (int j = sample.m_numFrames - 1; j >= 0; --j)
+				{
+					FoldedStacks_AppendName(stack, Profiler_GetSampleFrameName(sample.m_frames[j]));
+				}
+
+				++stackCounts[stack];
+			}
+		}
+	}
+
+
+	for (auto stackIter = stackCounts.begin(); stackIter != stackCounts.end(); ++stackIter)
+	{
+		char count[16];
+		int length = snprintf(count, sizeof(count), " %d\n", stackIter->second);
+		writer.Write(stackIter->first);
+		writer.WritePrinted(count, sizeof(count), length);
+	}
+
+	writer.Close();
+	return !writer.HasFailed();
+}
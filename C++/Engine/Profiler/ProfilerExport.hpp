@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+
+
+// Writes every retained frame out for a timeline viewer, one track per thread
+//	Both formats are streamed through a small buffer, the document is never built in memory
+//	Returns false if the file couldn't be opened or written
+
+// Chrome Trace Event JSON, opens in chrome://tracing and ui.perfetto.dev
+bool Profiler_ExportChromeTrace(const std::string& filepath);
+
+// Perfetto protobuf trace, names are interned so it is several times smaller than the JSON
+bool Profiler_ExportPerfettoTrace(const std::string& filepath);
+
+// Folded stacks from the sampler (one "A;B;C count" line per distinct stack) for flamegraph.pl or speedscope
+//	Each stack is the thread, the instrumented scopes that were open, then the sampled frames outermost first
+bool Profiler_ExportFoldedStacks(const std::string& filepath);
\ No newline at end of file
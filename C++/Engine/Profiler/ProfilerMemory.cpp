@@ -0,0 +1,141 @@
+#include "Engine/Profiler/ProfilerMemory.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+	#include <malloc.h>
+#elif defined(__APPLE__)
+	#include <malloc/malloc.h>
+#else
+	#include <malloc.h>
+#endif
+
+#include "Engine/Profiler/Profiler.hpp"
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Callback -------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Plain function pointer behind an atomic, every allocation in the process reads it
+std::atomic<ProfilerAllocationCallback> s_allocationCallback(nullptr);
+
+
+
+void ProfilerMemory_SetAllocationCallback(ProfilerAllocationCallback callback)
+{
+	s_allocationCallback.store(callback, std::memory_order_release);
+}
+
+
+
+#if defined(PROFILER_ENABLED) && defined(PROFILER_MEMORY_TRACKING)
+// ----------------------------------------------------------------------------------------------------------------
+// Allocation -----------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+size_t GetUsableSize(void* memory)
+{
+#if defined(_MSC_VER)
+	return _msize(memory);
+#elif defined(__APPLE__)
+	return malloc_size(memory);
+#else
+	return malloc_usable_size(memory);
+#endif
+}
+
+
+
+void* ProfilerMemory_Allocate(size_t numBytes)
+{
+	// new of zero bytes still has to hand back a unique pointer
+	void* memory = malloc((numBytes == 0) ? 1 : numBytes);
+
+	if (memory != nullptr)
+	{
+		ProfilerAllocationCallback callback = s_allocationCallback.load(std::memory_order_acquire);
+		if (callback != nullptr)
+		{
+			callback(memory, GetUsableSize(memory), true);
+		}
+	}
+
+	return memory;
+}
+
+
+
+void ProfilerMemory_Free(void* memory)
+{
+	if (memory == nullptr)
+	{
+		return;
+	}
+
+	ProfilerAllocationCallback callback = s_allocationCallback.load(std::memory_order_acquire);
+	if (callback != nullptr)
+	{
+		callback(memory, GetUsableSize(memory), false);
+	}
+
+	free(memory);
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Global Operators -----------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// NOTE: The over aligned overloads are left alone, they allocate and free in pairs through the runtime's own versions
+// Like the runtime's own, a failed allocation calls the new handler and tries again until there isn't one
+void* ProfilerMemory_AllocateOrThrow(size_t numBytes)
+{
+	for (;;)
+	{
+		void* memory = ProfilerMemory_Allocate(numBytes);
+		if (memory != nullptr)
+		{
+			return memory;
+		}
+
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+
+
+void* ProfilerMemory_AllocateOrNull(size_t numBytes) noexcept
+{
+	try
+	{
+		return ProfilerMemory_AllocateOrThrow(numBytes);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+
+
+void* operator new(size_t numBytes)										{ return ProfilerMemory_AllocateOrThrow(numBytes); }
+void* operator new[](size_t numBytes)									{ return ProfilerMemory_AllocateOrThrow(numBytes); }
+void* operator new(size_t numBytes, const std::nothrow_t&) noexcept		{ return ProfilerMemory_AllocateOrNull(numBytes); }
+void* operator new[](size_t numBytes, const std::nothrow_t&) noexcept	{ return ProfilerMemory_AllocateOrNull(numBytes); }
+
+
+
+void operator delete(void* memory) noexcept							{ ProfilerMemory_Free(memory); }
+void operator delete[](void* memory) noexcept						{ ProfilerMemory_Free(memory); }
+void operator delete(void* memory, size_t) noexcept					{ ProfilerMemory_Free(memory); }
+void operator delete[](void* memory, size_t) noexcept				{ ProfilerMemory_Free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept		{ ProfilerMemory_Free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept	{ ProfilerMemory_Free(memory); }
+#endif
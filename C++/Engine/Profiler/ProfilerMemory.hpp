@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+
+
+// With PROFILER_MEMORY_TRACKING defined ProfilerMemory.cpp replaces the global operator new/delete
+//	They go straight to malloc/free and tell the installed callback about every block
+//	Sizes are the allocator's usable size for the block so an allocation and its free always report the same number
+typedef void (*ProfilerAllocationCallback)(void* memory, size_t numBytes, bool isAllocation);
+
+// nullptr to stop, the profiler installs its own through Profiler_SetMemoryTracking
+void ProfilerMemory_SetAllocationCallback(ProfilerAllocationCallback callback);
@@ -0,0 +1,321 @@
+#include "Engine/Profiler/ProfilerSampling.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#ifdef PROFILER_SAMPLING_HAS_SIGPROF
+	#include <cerrno>
+	#include <csignal>
+	#include <cxxabi.h>
+	#include <dlfcn.h>
+	#include <pthread.h>
+	#include <sys/time.h>
+	#include <ucontext.h>
+#endif
+
+#include "Engine/Core/EngineCommon.h"
+#include "Engine/Core/StringUtils.hpp"
+#include "Engine/Profiler/ProfilerClock.hpp"
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// State ----------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+std::atomic<bool>									s_isSamplerRunning(false);
+std::atomic<uint32_t>								s_numDroppedSamples(0);
+bool												s_isSampleHandlerInstalled = false;
+
+// Static TLS, reading it from the handler never goes through __tls_get_addr, which can allocate
+#if defined(__GNUC__)
+	#define PROFILER_SAMPLING_TLS __attribute__((tls_model("initial-exec")))
+#else
+	#define PROFILER_SAMPLING_TLS
+#endif
+thread_local std::atomic<ProfilerSampleBuffer*>*	t_sampleBufferSlot PROFILER_SAMPLING_TLS = nullptr;
+thread_local uintptr_t								t_sampleStackLow PROFILER_SAMPLING_TLS = 0;		// The handler never follows a frame pointer outside these
+thread_local uintptr_t								t_sampleStackHigh PROFILER_SAMPLING_TLS = 0;
+
+// Symbols
+std::mutex											s_sampleFrameNamesMutex;
+std::unordered_map<void*, std::string>				s_sampleFrameNames;	// Node based so the c_str()s never move
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Signal Handler -------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+#ifdef PROFILER_SAMPLING_HAS_SIGPROF
+// Where the thread was when the signal landed
+void* GetInterruptedAddress(void* context)
+{
+	const ucontext_t* userContext = (const ucontext_t*)context;
+
+#if defined(__x86_64__)
+	return (void*)userContext->uc_mcontext.gregs[REG_RIP];
+#elif defined(__aarch64__)
+	return (void*)userContext->uc_mcontext.pc;
+#else
+	UNUSED(userContext);
+	return nullptr;
+#endif
+}
+
+
+
+uintptr_t GetInterruptedFramePointer(void* context)
+{
+	const ucontext_t* userContext = (const ucontext_t*)context;
+
+#if defined(__x86_64__)
+	return (uintptr_t)userContext->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+	return (uintptr_t)userContext->uc_mcontext.regs[29];
+#else
+	UNUSED(userContext);
+	return 0;
+#endif
+}
+
+
+
+// Everything in here has to be async signal safe, atomics and plain loads and stores only
+//	The stack is walked by hand from the interrupted registers, backtrace() can take the unwinder's locks and allocate
+void SampleSignalHandler(int signalNumber, siginfo_t* info, void* context)
+{
+	UNUSED(signalNumber);
+	UNUSED(info);
+
+	// Checked first, the profiler may be tearing the thread states down
+	if (!s_isSamplerRunning.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	std::atomic<ProfilerSampleBuffer*>* bufferSlot = t_sampleBufferSlot;
+	ProfilerSampleBuffer* buffer = (bufferSlot != nullptr) ? bufferSlot->load(std::memory_order_acquire) : nullptr;
+	if (buffer == nullptr)
+	{
+		return;
+	}
+
+	uint32_t writeIndex = buffer->m_writeIndex.load(std::memory_order_relaxed);
+	if (writeIndex - buffer->m_readIndex.load(std::memory_order_acquire) >= (uint32_t)PROFILER_SAMPLE_BUFFER_CAPACITY)
+	{
+		s_numDroppedSamples.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	int savedErrno = errno;
+
+	ProfilerSampleSlot& slot = buffer->m_slots[writeIndex & (PROFILER_SAMPLE_BUFFER_CAPACITY - 1)];
+	slot.m_ticks = ProfilerClock_GetCurrentTicks();
+
+	slot.m_numFrames = 0;
+	void* interruptedAddress = GetInterruptedAddress(context);
+	if (interruptedAddress != nullptr)
+	{
+		slot.m_frames[slot.m_numFrames++] = interruptedAddress;
+	}
+
+	// Each frame starts with the caller's frame pointer then the return address, and callers are always further up the stack
+	//	Code built without frame pointers leaves anything in the register, the bounds and ordering checks stop the walk before it reads outside the stack
+	uintptr_t stackLow = t_sampleStackLow;
+	uintptr_t stackHigh = t_sampleStackHigh;
+	uintptr_t framePointer = GetInterruptedFramePointer(context);
+	while (slot.m_numFrames < PROFILER_MAX_SAMPLE_DEPTH)
+	{
+		if (framePointer < stackLow || framePointer >= stackHigh || stackHigh - framePointer < 2 * sizeof(uintptr_t) || (framePointer & (sizeof(uintptr_t) - 1)) != 0)
+		{
+			break;
+		}
+
+		const uintptr_t* frame = (const uintptr_t*)framePointer;
+		uintptr_t callerFramePointer = frame[0];
+		uintptr_t returnAddress = frame[1];
+		if (returnAddress == 0)
+		{
+			break;
+		}
+		slot.m_frames[slot.m_numFrames++] = (void*)returnAddress;
+
+		if (callerFramePointer <= framePointer)
+		{
+			break;
+		}
+		framePointer = callerFramePointer;
+	}
+
+	buffer->m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+	errno = savedErrno;
+}
+#endif
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Sampler --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+void ProfilerSampling_RegisterThread(std::atomic<ProfilerSampleBuffer*>* bufferSlot)
+{
+#ifdef PROFILER_SAMPLING_HAS_SIGPROF
+	// Looked up here since pthread_getattr_np allocates, a thread it can't describe only gets the interrupted address
+	uintptr_t stackLow = 0;
+	uintptr_t stackHigh = 0;
+	pthread_attr_t attributes;
+	if (pthread_getattr_np(pthread_self(), &attributes) == 0)
+	{
+		void* stackAddress = nullptr;
+		size_t stackSize = 0;
+		if (pthread_attr_getstack(&attributes, &stackAddress, &stackSize) == 0)
+		{
+			stackLow = (uintptr_t)stackAddress;
+			stackHigh = stackLow + stackSize;
+		}
+		pthread_attr_destroy(&attributes);
+	}
+	t_sampleStackLow = stackLow;
+	t_sampleStackHigh = stackHigh;
+
+	// A signal landing between the stores has to see the bounds before the slot
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+	t_sampleBufferSlot = bufferSlot;
+}
+
+
+
+void ProfilerSampling_UnregisterThread()
+{
+	t_sampleBufferSlot = nullptr;
+}
+
+
+
+bool ProfilerSampling_Start(int samplesPerSecond)
+{
+#ifdef PROFILER_SAMPLING_HAS_SIGPROF
+	if (samplesPerSecond <= 0)
+	{
+		return false;
+	}
+
+	// Installed once and left installed, SIGPROF's default action kills the process and one may still be in flight after a stop
+	if (!s_isSampleHandlerInstalled)
+	{
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_sigaction = SampleSignalHandler;
+		action.sa_flags = SA_SIGINFO | SA_RESTART;
+		sigemptyset(&action.sa_mask);
+		if (sigaction(SIGPROF, &action, nullptr) != 0)
+		{
+			return false;
+		}
+		s_isSampleHandlerInstalled = true;
+	}
+
+	s_numDroppedSamples.store(0, std::memory_order_relaxed);
+	s_isSamplerRunning.store(true, std::memory_order_release);
+
+	// Process CPU time, so busy threads get sampled and idle ones don't
+	long intervalMicroseconds = 1000000L / (long)samplesPerSecond;
+	intervalMicroseconds = (intervalMicroseconds > 0) ? intervalMicroseconds : 1;
+
+	struct itimerval timer;
+	timer.it_interval.tv_sec = intervalMicroseconds / 1000000L;
+	timer.it_interval.tv_usec = intervalMicroseconds % 1000000L;
+	timer.it_value = timer.it_interval;
+	if (setitimer(ITIMER_PROF, &timer, nullptr) != 0)
+	{
+		s_isSamplerRunning.store(false, std::memory_order_release);
+		return false;
+	}
+
+	return true;
+#else
+	UNUSED(samplesPerSecond);
+	return false;
+#endif
+}
+
+
+
+void ProfilerSampling_Stop()
+{
+#ifdef PROFILER_SAMPLING_HAS_SIGPROF
+	struct itimerval timer;
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, nullptr);
+#endif
+
+	s_isSamplerRunning.store(false, std::memory_order_release);
+}
+
+
+
+bool ProfilerSampling_IsAvailable()
+{
+#ifdef PROFILER_SAMPLING_HAS_SIGPROF
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+
+unsigned int ProfilerSampling_GetNumDropped()
+{
+	return s_numDroppedSamples.load(std::memory_order_relaxed);
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Symbols --------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+// Functions the dynamic symbol table doesn't have (static ones, or everything without -rdynamic) come out as their module
+const char* Profiler_GetSampleFrameName(void* address)
+{
+	std::lock_guard<std::mutex> namesLock(s_sampleFrameNamesMutex);
+
+	auto found = s_sampleFrameNames.find(address);
+	if (found != s_sampleFrameNames.end())
+	{
+		return found->second.c_str();
+	}
+
+	std::string name;
+
+#ifdef PROFILER_SAMPLING_HAS_SIGPROF
+	Dl_info info;
+	if (dladdr(address, &info) != 0 && info.dli_sname != nullptr)
+	{
+		int status = 0;
+		char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+		name = (demangled != nullptr) ? demangled : info.dli_sname;
+		free(demangled);
+	}
+	else if (dladdr(address, &info) != 0 && info.dli_fname != nullptr)
+	{
+		// Every address in the module would be its own function otherwise, the module at least adds up
+		const char* moduleName = strrchr(info.dli_fname, '/');
+		moduleName = (moduleName != nullptr) ? moduleName + 1 : info.dli_fname;
+		name = Stringf("[%s]", moduleName);
+	}
+#endif
+
+	if (name.empty())
+	{
+		char addressName[32];
+		snprintf(addressName, sizeof(addressName), "0x%llx", (unsigned long long)(uintptr_t)address);
+		name = addressName;
+	}
+
+	return s_sampleFrameNames.emplace(address, name).first->second.c_str();
+}
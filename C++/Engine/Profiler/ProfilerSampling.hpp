@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "Engine/Profiler/Profiler.hpp"
+
+#if defined(__linux__)
+	#define PROFILER_SAMPLING_HAS_SIGPROF
+#endif
+
+
+
+// Call stacks caught by a SIGPROF timer, see Profiler_StartSampling for the public side
+//	The signal lands on whichever thread is burning CPU at the time, it writes into that thread's own ring
+//	so nothing in the handler takes a lock or allocates
+
+
+
+// One thread's samples waiting for the frame to close
+//	Only the signal handler on the owning thread writes, Profiler_BeginFrame drains it from the main thread
+constexpr int		PROFILER_SAMPLE_BUFFER_CAPACITY = 256;	// Power of two, a frame rarely sees more than a few dozen per thread
+struct ProfilerSampleSlot
+{
+	uint64_t		m_ticks;
+	int				m_numFrames;
+	void*			m_frames[PROFILER_MAX_SAMPLE_DEPTH];
+};
+struct ProfilerSampleBuffer
+{
+	ProfilerSampleSlot		m_slots[PROFILER_SAMPLE_BUFFER_CAPACITY];
+	std::atomic<uint32_t>	m_writeIndex{0};
+	std::atomic<uint32_t>	m_readIndex{0};
+};
+
+
+
+// Points the calling thread's handler at its state's buffer slot, the buffer itself can show up later
+void			ProfilerSampling_RegisterThread(std::atomic<ProfilerSampleBuffer*>* bufferSlot);
+void			ProfilerSampling_UnregisterThread();
+
+// Turns the timer on or off, the profiler hands every thread a buffer before it starts
+bool			ProfilerSampling_Start(int samplesPerSecond);
+void			ProfilerSampling_Stop();
+bool			ProfilerSampling_IsAvailable();
+
+// Samples lost to a full ring since sampling started
+unsigned int	ProfilerSampling_GetNumDropped();
@@ -0,0 +1,385 @@
+#include "Engine/Profiler/ProfilerStatistics.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+
+#include "Engine/Core/EngineCommon.h"
+#include "Engine/Core/ErrorWarningAssert.hpp"
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Quantile Sketch ------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+ProfilerQuantileSketch::ProfilerQuantileSketch()
+{
+	double gamma = (1.0 + RELATIVE_ACCURACY) / (1.0 - RELATIVE_ACCURACY);
+	m_logGamma = log(gamma);
+}
+
+
+
+void ProfilerQuantileSketch::Add(uint64_t value)
+{
+	if (m_count == 0)
+	{
+		m_min = value;
+		m_max = value;
+	}
+	else
+	{
+		m_min = std::min(m_min, value);
+		m_max = std::max(m_max, value);
+	}
+	++m_count;
+	m_sum += (double)value;
+
+	if (value == 0)
+	{
+		++m_zeroCount;
+	}
+	else
+	{
+		AddToBucket(GetBucketIndex(value), 1);
+	}
+}
+
+
+
+void ProfilerQuantileSketch::Merge(const ProfilerQuantileSketch& other)
+{
+	if (other.m_count == 0)
+	{
+		return;
+	}
+
+	if (m_count == 0)
+	{
+		m_min = other.m_min;
+		m_max = other.m_max;
+	}
+	else
+	{
+		m_min = std::min(m_min, other.m_min);
+		m_max = std::max(m_max, other.m_max);
+	}
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+	m_zeroCount += other.m_zeroCount;
+
+	for (int i = 0; i < (int)other.m_buckets.size(); ++i)
+	{
+		if (other.m_buckets[i] != 0)
+		{
+			AddToBucket(other.m_firstBucketIndex + i, other.m_buckets[i]);
+		}
+	}
+}
+
+
+
+void ProfilerQuantileSketch::Clear()
+{
+	m_buckets.clear();
+	m_firstBucketIndex = 0;
+	m_zeroCount = 0;
+
+	m_count = 0;
+	m_min = 0;
+	m_max = 0;
+	m_sum = 0.0;
+}
+
+
+
+double ProfilerQuantileSketch::GetMean() const
+{
+	double mean = 0.0;
+
+	if (m_count != 0)
+	{
+		mean = m_sum / (double)m_count;
+	}
+
+	return mean;
+}
+
+
+
+double ProfilerQuantileSketch::GetQuantile(double quantile) const
+{
+	if (m_count == 0)
+	{
+		return 0.0;
+	}
+
+	// The ends are known exactly
+	if (quantile <= 0.0)
+	{
+		return (double)m_min;
+	}
+	if (quantile >= 1.0)
+	{
+		return (double)m_max;
+	}
+
+	uint64_t rank = (uint64_t)(quantile * (double)(m_count - 1));
+	if (rank < m_zeroCount)
+	{
+		return 0.0;
+	}
+
+	uint64_t seen = m_zeroCount;
+	for (int i = 0; i < (int)m_buckets.size(); ++i)
+	{
+		seen += m_buckets[i];
+		if (seen > rank)
+		{
+			double value = GetBucketValue(m_firstBucketIndex + i);
+			return std::min(std::max(value, (double)m_min), (double)m_max);
+		}
+	}
+
+	return (double)m_max;
+}
+
+
+
+int ProfilerQuantileSketch::GetBucketIndex(uint64_t value) const
+{
+	return (int)ceil(log((double)value) / m_logGamma);
+}
+
+
+
+double ProfilerQuantileSketch::GetBucketValue(int index) const
+{
+	// Bucket i holds (gamma^(i-1), gamma^i], this point is within RELATIVE_ACCURACY of both ends
+	double gamma = exp(m_logGamma);
+	return 2.0 * pow(gamma, (double)index) / (gamma + 1.0);
+}
+
+
+
+void ProfilerQuantileSketch::AddToBucket(int index, uint64_t count)
+{
+	if (m_buckets.empty())
+	{
+		m_firstBucketIndex = index;
+		m_buckets.push_back(0);
+	}
+
+
+	// Grow to cover the index
+	if (index < m_firstBucketIndex)
+	{
+		int numToAdd = m_firstBucketIndex - index;
+		m_buckets.insert(m_buckets.begin(), (size_t)numToAdd, 0);
+		m_firstBucketIndex = index;
+	}
+	else if (index >= m_firstBucketIndex + (int)m_buckets.size())
+	{
+		m_buckets.resize((size_t)(index - m_firstBucketIndex + 1), 0);
+	}
+
+	m_buckets[index - m_firstBucketIndex] += count;
+
+
+	// Keep memory bounded, fold the lowest buckets into the first one we keep
+	if ((int)m_buckets.size() > MAX_NUM_BUCKETS)
+	{
+		int numToCollapse = (int)m_buckets.size() - MAX_NUM_BUCKETS;
+
+		uint64_t collapsedCount = 0;
+		for (int i = 0; i < numToCollapse; ++i)
+		{
+			collapsedCount += m_buckets[i];
+		}
+
+		m_buckets.erase(m_buckets.begin(), m_buckets.begin() + numToCollapse);
+		m_buckets[0] += collapsedCount;
+		m_firstBucketIndex += numToCollapse;
+	}
+}
+
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Statistics Report ----------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------
+struct StatisticsScope
+{
+	const char*				m_name;
+
+	// This frame
+	int						m_lastFrameSeen = -1;
+	int						m_frameCallCount = 0;
+	uint64_t				m_frameSelfTimeHPC = 0;
+	uint64_t				m_frameTotalTimeHPC = 0;
+
+	// All frames
+	ProfilerQuantileSketch	m_selfTime;
+	ProfilerQuantileSketch	m_totalTime;
+	int						m_numFramesPresent = 0;
+	int						m_minCallCount = 0;
+	int						m_maxCallCount = 0;
+	int64_t					m_totalCallCount = 0;
+	int						m_callCountHistogram[ProfilerStatisticsLine::CALL_COUNT_HISTOGRAM_SIZE] = {};
+};
+
+
+
+int GetCallCountHistogramBucket(int callCount)
+{
+	int bucket = 0;
+	while (callCount > 0 && bucket < ProfilerStatisticsLine::CALL_COUNT_HISTOGRAM_SIZE - 1)
+	{
+		callCount >>= 1;
+		++bucket;
+	}
+
+	return bucket;
+}
+
+
+
+void FillTimeStatistics(ProfilerTimeStatistics& statistics, const ProfilerQuantileSketch& sketch)
+{
+	statistics.m_min	= Profiler_ConvertTicksToSeconds(sketch.GetMin());
+	statistics.m_mean	= Profiler_ConvertTicksToSeconds((uint64_t)sketch.GetMean());
+	statistics.m_p50	= Profiler_ConvertTicksToSeconds((uint64_t)sketch.GetQuantile(0.50));
+	statistics.m_p95	= Profiler_ConvertTicksToSeconds((uint64_t)sketch.GetQuantile(0.95));
+	statistics.m_p99	= Profiler_ConvertTicksToSeconds((uint64_t)sketch.GetQuantile(0.99));
+	statistics.m_max	= Profiler_ConvertTicksToSeconds(sketch.GetMax());
+}
+
+
+
+std::vector<ProfilerStatisticsLine> Profiler_GenerateStatisticsReport(unsigned int firstTreeAgo, unsigned int numTrees, eFlatReportSortMode sortMode)
+{
+	GUARANTEE_OR_DIE(sortMode == FLAT_REPORT_SORT_MODE_SELF_TIME || sortMode == FLAT_REPORT_SORT_MODE_TOTAL_TIME, "Please use flat report sort mode self or total time");
+
+	// Every main thread root has its own "Frame N" name, they are all the same scope as far as statistics go
+	static const char* FRAME_SCOPE_NAME = "Frame";
+
+	std::vector<StatisticsScope> scopes;
+	std::unordered_map<const char*, int> scopeIndices;		// Names are interned so the pointer is the identity
+	std::vector<int> scopesThisFrame;
+	std::vector<const ProfilerNode*> nodeStack;
+
+	int numFrames = 0;
+	for (unsigned int xTreesAgo = firstTreeAgo; xTreesAgo < firstTreeAgo + numTrees; ++xTreesAgo)
+	{
+		const ProfilerNode* root = Profiler_GetPreviousTree(xTreesAgo);
+		if (root == nullptr)
+		{
+			break;
+		}
+
+		int frameIndex = numFrames;
+		++numFrames;
+
+
+		// Flatten this frame
+		scopesThisFrame.clear();
+		nodeStack.clear();
+		nodeStack.push_back(root);
+		while (!nodeStack.empty())
+		{
+			const ProfilerNode* node = nodeStack.back();
+			nodeStack.pop_back();
+
+			const char* name = (node == root) ? FRAME_SCOPE_NAME : node->m_name;
+			auto found = scopeIndices.find(name);
+			if (found == scopeIndices.end())
+			{
+				found = scopeIndices.emplace(name, (int)scopes.size()).first;
+				scopes.emplace_back();
+				scopes.back().m_name = name;
+			}
+
+			StatisticsScope& scope = scopes[found->second];
+			if (scope.m_lastFrameSeen != frameIndex)
+			{
+				scope.m_lastFrameSeen = frameIndex;
+				scope.m_frameCallCount = 0;
+				scope.m_frameSelfTimeHPC = 0;
+				scope.m_frameTotalTimeHPC = 0;
+				scopesThisFrame.push_back(found->second);
+			}
+			scope.m_frameCallCount += 1;
+			scope.m_frameSelfTimeHPC += node->GetSelfTimeHPC();
+			scope.m_frameTotalTimeHPC += node->GetElapsedTimeHPC();
+
+			for (const ProfilerNode* child = node->m_firstChild; child != nullptr; child = child->m_nextSibling)
+			{
+				nodeStack.push_back(child);
+			}
+		}
+
+
+		// Feed the frame's totals to the sketches
+		for (int i = 0; i < (int)scopesThisFrame.size(); ++i)
+		{
+			StatisticsScope& scope = scopes[scopesThisFrame[i]];
+
+			scope.m_selfTime.Add(scope.m_frameSelfTimeHPC);
+			scope.m_totalTime.Add(scope.m_frameTotalTimeHPC);
+
+			if (scope.m_numFramesPresent == 0)
+			{
+				scope.m_minCallCount = scope.m_frameCallCount;
+				scope.m_maxCallCount = scope.m_frameCallCount;
+			}
+			else
+			{
+				scope.m_minCallCount = std::min(scope.m_minCallCount, scope.m_frameCallCount);
+				scope.m_maxCallCount = std::max(scope.m_maxCallCount, scope.m_frameCallCount);
+			}
+			scope.m_totalCallCount += scope.m_frameCallCount;
+			scope.m_callCountHistogram[GetCallCountHistogramBucket(scope.m_frameCallCount)] += 1;
+			++scope.m_numFramesPresent;
+		}
+	}
+
+
+	// Build the lines
+	std::vector<ProfilerStatisticsLine> report;
+	report.reserve(scopes.size());
+	for (int i = 0; i < (int)scopes.size(); ++i)
+	{
+		const StatisticsScope& scope = scopes[i];
+
+		ProfilerStatisticsLine line;
+		line.m_name = scope.m_name;
+		line.m_numFramesPresent = scope.m_numFramesPresent;
+		FillTimeStatistics(line.m_selfTime, scope.m_selfTime);
+		FillTimeStatistics(line.m_totalTime, scope.m_totalTime);
+
+		// Frames the scope didn't show up in count as zero calls
+		line.m_minCallCount = (scope.m_numFramesPresent < numFrames) ? 0 : scope.m_minCallCount;
+		line.m_maxCallCount = scope.m_maxCallCount;
+		line.m_meanCallCount = (double)scope.m_totalCallCount / (double)numFrames;
+		for (int bucket = 0; bucket < ProfilerStatisticsLine::CALL_COUNT_HISTOGRAM_SIZE; ++bucket)
+		{
+			line.m_callCountHistogram[bucket] = scope.m_callCountHistogram[bucket];
+		}
+		line.m_callCountHistogram[0] += numFrames - scope.m_numFramesPresent;
+
+		report.push_back(line);
+	}
+
+
+	// Worst tail first
+	if (sortMode == FLAT_REPORT_SORT_MODE_SELF_TIME)
+	{
+		std::sort(report.begin(), report.end(), [](const ProfilerStatisticsLine& lhs, const ProfilerStatisticsLine& rhs) { return lhs.m_selfTime.m_p99 > rhs.m_selfTime.m_p99; });
+	}
+	else
+	{
+		std::sort(report.begin(), report.end(), [](const ProfilerStatisticsLine& lhs, const ProfilerStatisticsLine& rhs) { return lhs.m_totalTime.m_p99 > rhs.m_totalTime.m_p99; });
+	}
+
+	return report;
+}
\ No newline at end of file
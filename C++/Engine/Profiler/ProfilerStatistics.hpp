@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Engine/Profiler/Profiler.hpp"
+
+
+
+// Streaming quantile estimate with bounded memory (a DDSketch)
+//	Values land in logarithmic buckets so every quantile is within RELATIVE_ACCURACY of the true value
+//	If the spread of values ever needs more than MAX_NUM_BUCKETS the lowest buckets are collapsed together,
+//	which only costs accuracy on the smallest values
+class ProfilerQuantileSketch
+{
+public:
+	ProfilerQuantileSketch();
+
+	void		Add(uint64_t value);
+	void		Merge(const ProfilerQuantileSketch& other);
+	void		Clear();
+
+	uint64_t	GetCount() const	{ return m_count; }
+	uint64_t	GetMin() const		{ return m_min; }
+	uint64_t	GetMax() const		{ return m_max; }
+	double		GetMean() const;
+	double		GetQuantile(double quantile) const; // quantile in [0,1]
+
+	static constexpr double RELATIVE_ACCURACY	= 0.01;
+	static constexpr int	MAX_NUM_BUCKETS		= 2048;
+
+private:
+	int			GetBucketIndex(uint64_t value) const;
+	double		GetBucketValue(int index) const;
+	void		AddToBucket(int index, uint64_t count);
+
+	double					m_logGamma;
+	std::vector<uint64_t>	m_buckets;
+	int						m_firstBucketIndex = 0;
+	uint64_t				m_zeroCount = 0;
+
+	uint64_t				m_count = 0;
+	uint64_t				m_min = 0;
+	uint64_t				m_max = 0;
+	double					m_sum = 0.0;
+};
+
+
+
+class ProfilerTimeStatistics
+{
+public:
+	// Seconds
+	double	m_min	= 0.0;
+	double	m_mean	= 0.0;
+	double	m_p50	= 0.0;
+	double	m_p95	= 0.0;
+	double	m_p99	= 0.0;
+	double	m_max	= 0.0;
+};
+
+
+
+class ProfilerStatisticsLine
+{
+public:
+	std::string				m_name;
+	int						m_numFramesPresent = 0;		// Frames the scope was called in, time statistics only cover these
+
+	ProfilerTimeStatistics	m_selfTime;					// Per frame sum of the scope's self time
+	ProfilerTimeStatistics	m_totalTime;				// Per frame sum of the scope's total time
+
+	// Calls per frame, bucket 0 counts the frames the scope was missing from
+	//	Bucket i > 0 counts frames with [2^(i-1), 2^i) calls, the last bucket is open ended
+	static constexpr int	CALL_COUNT_HISTOGRAM_SIZE = 16;
+	int						m_minCallCount = 0;
+	int						m_maxCallCount = 0;
+	double					m_meanCallCount = 0.0;
+	int						m_callCountHistogram[CALL_COUNT_HISTOGRAM_SIZE] = {};
+};
+
+
+
+// Aggregates the main thread's trees from firstTreeAgo back through firstTreeAgo + numTrees - 1
+//	Scopes are merged by name like the flat report, sorted by p99 of self or total time
+std::vector<ProfilerStatisticsLine> Profiler_GenerateStatisticsReport(unsigned int firstTreeAgo, unsigned int numTrees, eFlatReportSortMode sortMode);
\ No newline at end of file
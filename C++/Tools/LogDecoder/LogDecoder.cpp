@@ -0,0 +1,141 @@
+// Turns a binary log (see Log_OpenBinaryFile) back into text
+//	Builds on its own, from the C++ folder:
+//		g++ -std=c++14 -O2 -I. Tools/LogDecoder/LogDecoder.cpp Engine/Logger/LogBinary.cpp Engine/Logger/LogFormat.cpp -o LogDecoder
+//		cl /O2 /EHsc /I. Tools\LogDecoder\LogDecoder.cpp Engine\Logger\LogBinary.cpp Engine\Logger\LogFormat.cpp
+//
+//	LogDecoder <log.binlog> [-tag TAG]... [-from SECONDS] [-to SECONDS] [-plain] [-o OUTPUT]
+//		-tag	Only lines with this tag, can be given more than once
+//		-from	Only lines logged at least this many seconds after the file was opened
+//		-to		Only lines logged at most this many seconds after the file was opened
+//		-plain	"TAG: text" like log.txt, otherwise each line starts with its time and thread
+//		-o		Write here instead of stdout
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Engine/Logger/LogBinary.hpp"
+
+
+
+//-------------------------------------------------------------------------------------------------------
+int PrintUsage()
+{
+	fprintf(stderr, "Usage: LogDecoder <log.binlog> [-tag TAG]... [-from SECONDS] [-to SECONDS] [-plain] [-o OUTPUT]\n");
+	return 1;
+}
+
+
+//-------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	std::string inputFilepath;
+	std::string outputFilepath;
+	std::vector<std::string> tags;
+	double fromSeconds = -1.0e300;
+	double toSeconds = 1.0e300;
+	bool isPlain = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool hasValue = (i + 1 < argc);
+
+		if (strcmp(argv[i], "-tag") == 0 && hasValue)
+		{
+			tags.push_back(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-from") == 0 && hasValue)
+		{
+			fromSeconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-to") == 0 && hasValue)
+		{
+			toSeconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-o") == 0 && hasValue)
+		{
+			outputFilepath = argv[++i];
+		}
+		else if (strcmp(argv[i], "-plain") == 0)
+		{
+			isPlain = true;
+		}
+		else if (argv[i][0] != '-' && inputFilepath.empty())
+		{
+			inputFilepath = argv[i];
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+
+	if (inputFilepath.empty())
+	{
+		return PrintUsage();
+	}
+
+	LogBinaryReader reader;
+	if (!reader.Open(inputFilepath))
+	{
+		fprintf(stderr, "%s isn't a binary log\n", inputFilepath.c_str());
+		return 1;
+	}
+
+	FILE* output = stdout;
+	if (!outputFilepath.empty())
+	{
+		output = fopen(outputFilepath.c_str(), "w");
+		if (output == nullptr)
+		{
+			fprintf(stderr, "Couldn't open %s\n", outputFilepath.c_str());
+			return 1;
+		}
+	}
+
+
+	// Decode
+	Log_LogEntry entry;
+	unsigned long long numLines = 0;
+	unsigned long long numWritten = 0;
+	while (reader.ReadNext(entry))
+	{
+		++numLines;
+
+		double seconds = reader.GetSecondsSinceOpen(entry.m_timeHPC);
+		if (seconds < fromSeconds || seconds > toSeconds)
+		{
+			continue;
+		}
+
+		bool hasTag = tags.empty();
+		for (int i = 0; i < (int)tags.size() && !hasTag; ++i)
+		{
+			hasTag = (tags[i] == entry.m_tag);
+		}
+		if (!hasTag)
+		{
+			continue;
+		}
+
+		if (isPlain)
+		{
+			fprintf(output, "%s: %s\n", entry.m_tag.c_str(), entry.m_text.c_str());
+		}
+		else
+		{
+			fprintf(output, "[%12.6f] [%3u] %s: %s\n", seconds, entry.m_threadID, entry.m_tag.c_str(), entry.m_text.c_str());
+		}
+		++numWritten;
+	}
+
+	if (output != stdout)
+	{
+		fclose(output);
+	}
+
+	fprintf(stderr, "%llu lines read, %llu written\n", numLines, numWritten);
+	return 0;
+}